@@ -11,16 +11,30 @@ namespace fs = std::filesystem;
 
 // B-Tree non-leaf Node (members stored contiguously)
 typedef struct alignas(constants::KEYS_PER_NODE * constants::PAIR_SIZE) BTreeNonLeafNode {
-    int64_t keys[constants::KEYS_PER_NODE] = {0}; // Keys in each node
-    int32_t ptrs[constants::KEYS_PER_NODE + 1] = {0}; // File offsets to children
+    int64_t keys[constants::NON_LEAF_KEYS] = {0}; // Keys in each node
+    int64_t ptrs[constants::NON_LEAF_KEYS + 1] = {0}; // File offsets to children, 64-bit so that an SST can exceed 2GB
     int32_t size = 0;
 } BTreeNonLeafNode;
+static_assert(sizeof(BTreeNonLeafNode) == constants::PAGE_SIZE, "A B-Tree non-leaf node must fit in a page");
 
 // B-Tree leaf Node
 typedef struct alignas(constants::KEYS_PER_NODE * constants::PAIR_SIZE) BTreeLeafNode {
     pair<int64_t, int64_t> data[constants::KEYS_PER_NODE]; // KV pairs
 } BTreeLeafNode;
 
+// Last page of an SST, after the leaves and the B-Tree non-leaf nodes: what lookups need to know about the SST,
+// so that its file name is only an identifier
+typedef struct alignas(constants::PAGE_SIZE) SSTFooter {
+    uint64_t magic = constants::SST_FOOTER_MAGIC;
+    uint64_t num_entries = 0;  // KV-pairs on the leaves, without the padding of the last page
+    int64_t min_key = 0;
+    int64_t max_key = 0;
+    int64_t leaf_end = 0;      // File offset of the end of the leaves, where the non-leaf nodes start
+    int64_t index_end = 0;     // File offset of the end of the non-leaf nodes, where this footer starts
+    uint64_t filter_num_cache_lines = 0; // The Bloom Filter of the SST, as in its header
+    uint64_t filter_num_of_hashes = 0;
+} SSTFooter;
+
 class BloomFilter;
 class LSMTree;
 
@@ -31,17 +45,25 @@ class BTree {
          * 2. During Compaction: they are stored in an output buffer and flushed to storage page-by-page
          */
         vector<vector<BTreeNonLeafNode>> non_leaf_nodes; // Stores the B-Tree non-leaf nodes
-        vector<int32_t> counters; // Counts the cumulative number of total elements among all the nodes in each level
+        vector<int64_t> counters; // Counts the cumulative number of total elements among all the nodes in each level
 
     public:
-        static const int32_t search_BTree_non_leaf_nodes(LSMTree& lsmtree, const int& fd, const fs::path& file_path
-                                                        , const int64_t& key, const size_t& file_end, const size_t& non_leaf_start);
+        static int64_t find_leaf_page(const int& fd, const int64_t& key, const size_t& file_end, const size_t& non_leaf_start);
+        // Fence pointers: the last key of every leaf page but the last, which are the keys of all the non-leaf nodes.
+        // The leaf page that may hold a key is the first one whose fence is >= key (see leaf_page)
+        static vector<int64_t> read_fences(const fs::path& file_path, const SSTFooter& footer);
+        static inline int64_t leaf_page(const vector<int64_t>& fences, const int64_t& key) {
+            return (lower_bound(fences.begin(), fences.end(), key) - fences.begin()) * constants::PAGE_SIZE;
+        }
+        // The footer goes right after the non-leaf nodes, at footer.index_end; it is read back from the end of the file
+        static void write_footer(const int& fd, const SSTFooter& footer);
+        static SSTFooter read_footer(const fs::path& file_path);
         void write_non_leaf_nodes_to_storage(const int& fd, int64_t& offset);
-        int32_t convertToBTree(aligned_KV_vector& sorted_KV, BloomFilter& bloom_filter);
-        void convertToBtree(const vector<int64_t>& non_leaf_keys, const int32_t& total_count);
+        int64_t convertToBTree(aligned_KV_vector& sorted_KV, BloomFilter& bloom_filter);
+        void convertToBtree(const vector<int64_t>& non_leaf_keys, const int64_t& total_count);
 
     private:
-        void insertHelper(const int64_t& key, const int32_t current_level, const int32_t& max_size);
-        void insertFixUp(const int32_t& leaf_end);
+        void insertHelper(const int64_t& key, const int32_t current_level, const int64_t& max_size);
+        void insertFixUp(const int64_t& leaf_end);
         void print_B_Tree(aligned_KV_vector& sorted_KV);
 };
\ No newline at end of file
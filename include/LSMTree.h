@@ -5,39 +5,93 @@
 #include <set>
 #include <algorithm>
 #include <queue>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <limits>
+#include <map>
+#include <memory>
 #include "constants.h"
 #include "bufferpool.h"
 #include "aligned_KV_vector.h"
 #include "bloomFilter.h"
 #include "util.h"
+#include "options.h"
+#include "filterReader.h"
+#include "rangeTombstones.h"
+#include "manifest.h"
+#include "BTree.h"
+#include "learnedIndex.h"
 using namespace std;
 namespace fs = std::filesystem;
 
-// Node for MinHeap
-struct HeapNode {
-    pair<int64_t, int64_t> data;
-    int arrayIndex; // this index corresponds the index of sorted_dir, the greater the index, newer the file
-};
-
-// Custom comparator for creating a min-heap with priority for newer file in duplicates
-static auto comp = [](const HeapNode &a, const HeapNode &b) {
-    if (a.data.first == b.data.first)
-        return a.arrayIndex < b.arrayIndex; // Prioritize newer file
-    return a.data.first > b.data.first;
-};
-
 class Level {
     public:
-        size_t cur_size;
+        size_t cur_size;           // Units on the level (SSTs on a partitioned level)
         size_t level;
         bool last_level;
         vector<fs::path> sorted_dir;
+        vector<size_t> run_units;  // Units of each run of sorted_dir, a unit being a full run of the level above
+
+        // Partitioned levels only: sorted_dir is ordered by key, and key_ranges holds the min and max key of each SST,
+        // so that a key has at most one candidate SST on the level. Maintained by LSMTree::index_level()
+        vector<pair<int64_t, int64_t>> key_ranges;
+        size_t num_pairs;       // Pairs on the leaves of the level
+        int64_t compact_cursor; // Max key of the SST compacted last, compactions go round the key space
 
-        Level(size_t level) : cur_size(0), level(level) {
+        Level(size_t level) : cur_size(0), level(level), num_pairs(0), compact_cursor(numeric_limits<int64_t>::min()) {
             last_level = false;
         };
 
         ~Level() {};
+
+        // Index of the first SST whose max key is at least key, or sorted_dir.size()
+        inline size_t find_SST(const int64_t& key) const {
+            return lower_bound(key_ranges.begin(), key_ranges.end(), key,
+                               [](const pair<int64_t, int64_t>& range, const int64_t& key) { return range.second < key; })
+                   - key_ranges.begin();
+        }
+};
+
+// What lookups need to know about an SST: its footer, the indexes of its leaves, and its tombstones as recorded
+// in the header of its Bloom Filter (and after its bitmap) when it was built
+struct SSTMeta {
+    size_t num_entries;
+    int64_t min_key;
+    int64_t max_key;
+    size_t leaf_end;  // End of the leaves and start of the B-Tree non-leaf nodes
+    size_t index_end; // End of the non-leaf nodes, the same as leaf_end if the SST is a single page
+    size_t filter_num_cache_lines;
+    size_t filter_num_of_hashes;
+    size_t num_tombstones;
+    RangeTombstones range_tombstones;
+    vector<int64_t> fences; // Fence pointers (see BTree::read_fences), with search_btree: get() and scan() read one leaf page, no non-leaf node
+    LearnedIndex learned_index; // With search_learned, fitted on the fences (which are not kept)
+
+    inline size_t fence_bytes() const { return fences.capacity() * sizeof(int64_t); }
+};
+
+// An SST as lookups see it: its files and its metadata, read once by the first thread that needs it (lookups do so
+// without lsmt_mutex). A lookup holds on to the handles of the SSTs it reads, so an SST that a compaction replaced
+// is only removed from storage once the last of them is done with it
+class SSTHandle {
+    public:
+        const fs::path sst_file;
+        const fs::path filter_file;
+        bool obsolete; // Compacted away (set under lsmt_mutex): the files go along with the last reference
+
+        SSTHandle(const fs::path& sst_file, const fs::path& filter_file, const SearchMode& index) :
+            sst_file(sst_file), filter_file(filter_file), obsolete(false), index(index) {}
+        ~SSTHandle();
+
+        const SSTMeta& meta();
+
+    private:
+        SearchMode index; // The index of the leaf pages the metadata keeps (see Options::sst_index)
+        SSTMeta loaded_meta;
+        once_flag loaded;
 };
 
 class LSMTree {
@@ -45,12 +99,32 @@ class LSMTree {
         string db_name;
         Bufferpool* buffer;
         vector<Level> levels;
-        size_t num_levels;
+        atomic<size_t> num_levels;
         size_t max_levels;
         fs::path sst_path;
         fs::path filter_path;
+        size_t l0_stall_limit; // Flushes block while the compaction debt of level 0 exceeds this
+        atomic<size_t> memtable_capacity; // Entries of a full memtable, the unit the size of the levels is counted in
+        size_t subcompaction_size;         // Compactions of more input pairs are split into key ranges merged in parallel
+        size_t readahead_size;             // Bytes of each compaction input read at once, ahead of the merge
+        atomic<size_t> num_subcompactions; // Key ranges merged in parallel so far, lets tests check that compactions were split
+        size_t partition_size;             // Pairs of the SSTs of partitioned levels, 0 if levels are compacted as a whole
+        size_t size_ratio;
+        MergePolicy merge_policy;
+        size_t runs_per_level;             // Runs a tiered level may hold
+        double bloom_fpr;                  // Sum of the false positive rates of the Bloom Filters of all levels
+        double tombstone_ratio;            // SSTs with a larger share of tombstones are compacted before their level is full
+        SearchMode sst_index;              // The index of the leaf pages kept for every SST (see Options::sst_index)
+        atomic<uint64_t> next_file_number; // SSTs are named <number>.bytes, by new_SST_name()
 
-        LSMTree(string db_name, Bufferpool* buffer = nullptr) : db_name(db_name), buffer(buffer), num_levels(1), max_levels(constants::LSMT_DEPTH) {
+        LSMTree(string db_name, Bufferpool* buffer = nullptr, size_t l0_stall_limit = constants::L0_STALL_LIMIT,
+                size_t memtable_capacity = constants::MEMTABLE_SIZE) :
+            db_name(db_name), buffer(buffer), num_levels(1), max_levels(constants::LSMT_DEPTH), l0_stall_limit(l0_stall_limit),
+            memtable_capacity(memtable_capacity), subcompaction_size(constants::SUBCOMPACTION_SIZE),
+            readahead_size(constants::COMPACTION_READAHEAD_SIZE), num_subcompactions(0), partition_size(0),
+            size_ratio(constants::LSMT_SIZE_RATIO), merge_policy(lazy_leveling), runs_per_level(constants::LSMT_SIZE_RATIO - 1),
+            bloom_fpr(constants::BLOOM_FPR), tombstone_ratio(constants::TOMBSTONE_COMPACTION_RATIO), sst_index(search_btree), next_file_number(1),
+            stop_compaction_flag(false), compacting(false), compacting_level(0) {
             size_t i = 0;
             while (i < constants::LSMT_DEPTH) {
                 levels.emplace_back(Level(i));
@@ -61,43 +135,111 @@ class LSMTree {
             filter_path = constants::DATA_FOLDER + db_name + "/filter/";
         }
 
-        const int64_t* get(const int64_t& key, const bool& use_btree);
-        void scan(vector<pair<int64_t, int64_t>>*& sorted_KV, const int64_t& key1, const int64_t& key2, const bool& use_btree);
+        ~LSMTree() {
+            stop_compaction();
+        }
+
+        const int64_t* get(const int64_t& key, const SearchMode& mode);
+        void scan(vector<pair<int64_t, int64_t>>*& sorted_KV, vector<size_t>& run_ends, vector<RangeTombstones>& run_ranges,
+                  const int64_t& key1, const int64_t& key2, const SearchMode& mode);
         
         // LSMTree functions
         void add_SST(const string& file_name);
-        // Check if the FIRST level of LSMTree is full
-        inline bool check_LSMTree_compaction() {
-            return levels[0].cur_size + 1 < constants::LSMT_SIZE_RATIO;
+        // Background compaction: started once the levels are restored, stopped (after draining all jobs) on close
+        void start_compaction();
+        void stop_compaction();
+        size_t level_debt(const size_t& level);
+        size_t max_runs(const size_t& level, const size_t& total_levels);
+        float bits_per_entry(const size_t& level, const size_t& total_levels);
+        // Bulk ingestion: the level an SST of count pairs naturally belongs to, and placing an SST built outside the tree
+        size_t ingest_level(const size_t& count);
+        size_t ingest_SST(const string& file_name, const size_t& count);
+        size_t ingest_placement(const int64_t& min_key, const int64_t& max_key, const size_t& count, bool& new_last_level);
+        bool keys_below(const int64_t& key);
+        // Partitioned levels: every level but level 0, when partition_size is set
+        inline bool partitioned(const size_t& level) {
+            return partition_size > 0 && level > 0;
+        }
+        void index_level(const size_t& level);
+        size_t num_tombstones(const fs::path& file_name);
+        SSTMeta SST_meta(const fs::path& file_name);
+        // Memory of the fence pointers and of the learned indexes of the SSTs searched so far
+        size_t fence_pointer_bytes();
+        size_t learned_index_bytes();
+        // The search a lookup that asks for mode does, given the index the SSTs keep
+        inline SearchMode lookup_mode(const SearchMode& mode) const {
+            return (mode == search_binary) ? search_binary : sst_index;
         }
+        // The MANIFEST: restore the levels of its last version when the DB is opened (false for a new DB),
+        // and remove what a crash left behind in the SST directories
+        bool restore_levels();
+        void remove_orphans();
+        // A file of the SST directories whose name this format does not create (such as an SST named after its level and
+        // key range by an older format), or an empty path. openDB refuses such a DB rather than take its SSTs for orphans
+        static fs::path unrecognised_file(const fs::path& sst_path, const fs::path& filter_path);
 
-        string generate_filename(const size_t& level, const int64_t& min_key, const int64_t& max_key, const int32_t& leaf_ends);
+        string new_SST_name();
+        void sync_SST_dirs();
         void print_lsmt();
-        void parse_SST_level(const string& file_name, size_t& level);
-        size_t calculate_sst_size(Level& cur_level);
-        bool read(const string& file_path, const int& fd, char*& data, const off_t& offset, const size_t& scanPageCount, const bool& isLeaf);
+        size_t calculate_sst_size(const size_t& level, const size_t& units = 1);
+        bool read(const string& file_path, const int& fd, char* page, const off_t& offset, const size_t& scanPageCount, const bool& isLeaf);
+        void merge_scan_results(vector<pair<int64_t, int64_t>>*& sorted_KV, const vector<size_t>& run_ends,
+                                const vector<RangeTombstones>& run_ranges);
 
 
     private:
-        const int64_t* search_SST(const fs::path& file_path, const int64_t& key, const size_t& file_end, const size_t& non_leaf_start, const bool& use_btree);
-        const int64_t* search_SST_BTree(int& fd, const fs::path& file_path, const int64_t& key, const size_t& file_end, const size_t& non_leaf_start);
+        // Protects the levels and SST_handles. Compactions only hold it to pick inputs and to install outputs, and lookups
+        // to take the handles of the SSTs they search, so that disk reads never block the levels. Neither is the MANIFEST
+        // synced under it (it orders its writes itself)
+        mutex lsmt_mutex;
+        mutex buffer_mutex; // Protects the buffer pool. Pages are copied out of it, so eviction never frees one in use
+        condition_variable compaction_cv; // Wakes the compaction thread up when a job is queued
+        condition_variable stall_cv;      // Wakes stalled flushes up when a compaction finished
+        deque<size_t> compaction_queue;   // Levels waiting to be compacted
+        thread compaction_thread;
+        bool stop_compaction_flag;
+        bool compacting;                  // A compaction job is running (possibly with the lock released)
+        size_t compacting_level;          // The level it compacts, its outputs go on that level or the next one
+        map<string, shared_ptr<SSTHandle>> SST_handles; // Of the SSTs read so far, by name
+        unique_ptr<Manifest> manifest;    // Opened by restore_levels()
+
+        shared_ptr<SSTHandle> handle(const fs::path& file_name);
+        const SSTMeta& meta(const fs::path& file_name);
+        void write_manifest(unique_lock<mutex>& lock);
+        const int64_t* get_from_SST(SSTHandle& sst_handle, const int64_t& key, const SearchMode& mode, bool& found);
+        const int64_t* search_SST(const fs::path& file_path, const int64_t& key, const SSTMeta& sst, const SearchMode& mode);
+        int64_t find_leaf(const int& fd, const fs::path& file_path, const SSTMeta& sst, const int64_t& key, const SearchMode& mode);
+        const int64_t* search_SST_leaf(int& fd, const fs::path& file_path, const int64_t& key, const int64_t& offset);
         const int64_t* search_SST_Binary(int& fd, const fs::path& file_path, const int64_t& key, const size_t& file_end, const size_t& non_leaf_start);
-        void parse_SST_name(const string& file_name, int64_t& min_key, int64_t& max_key, size_t& leaf_end);
-        void parse_SST_offset(const string& file_name, size_t& leaf_end);
-        void scan_SST(vector<pair<int64_t, int64_t>>& sorted_KV, const string& file_path, const int64_t& key1, const int64_t& key2, const size_t& file_end, 
-                      const size_t& non_leaf_start, size_t& scanPageCount, const bool& use_btree);
-        void merge_scan_results(vector<pair<int64_t, int64_t>>*& sorted_KV, const size_t& first_end);
-        const int32_t scan_helper_BTree(const int& fd, const fs::path& file_path, const int64_t& key1, const size_t& file_end, const size_t& non_leaf_start);
-        const int32_t scan_helper_Binary(const int& fd, const fs::path& file_path, const int64_t& key1, const int32_t& num_elements, const size_t& file_end, 
+        void scan_SST(vector<pair<int64_t, int64_t>>& sorted_KV, const string& file_path, const int64_t& key1, const int64_t& key2,
+                      const SSTMeta& sst, size_t& scanPageCount, const SearchMode& mode);
+        const int64_t scan_helper_leaf(const int& fd, const fs::path& file_path, const int64_t& key1, const int64_t& offset);
+        const int64_t scan_helper_Binary(const int& fd, const fs::path& file_path, const int64_t& key1, const int64_t& num_elements, const size_t& file_end, 
                                          const size_t& non_leaf_start);
-        const string parse_pid(const string& file_name, const int32_t&);
+        const string parse_pid(const string& file_name, const int64_t&);
+        static bool parse_SST_name(const string& file_name, uint64_t& file_number);
+        static bool temp_SST_name(const string& file_name);
 
-        // LSMTree functions
-        void merge_down(const vector<Level>::iterator& current);
-        void merge_down_helper(const vector<Level>::iterator& cur_level, const vector<Level>::iterator& next_level, const int& num_sst, const bool& last_compaction, 
-                               const bool& largest_level);
-        void largest_level_move_down(const vector<Level>::iterator& cur_level);
+        // Compaction functions
+        void compaction_worker();
+        void schedule_compactions();
+        void compact_level(const size_t& level, unique_lock<mutex>& lock);
+        void compact_partition(const size_t& level, unique_lock<mutex>& lock, const size_t& dense = numeric_limits<size_t>::max());
+        void compact_tombstones(const size_t& level, const size_t& dense, unique_lock<mutex>& lock);
+        size_t dense_SST(const size_t& level);
+        vector<fs::path> older_SSTs(const size_t& level, const size_t& num_runs, const int64_t& min_key, const int64_t& max_key);
+        void key_range(const vector<fs::path>& file_names, int64_t& min_key, int64_t& max_key);
+        vector<string> merge_SSTs(const vector<fs::path>& all_inputs, const size_t& output_level, const size_t& total_levels,
+                                  const vector<fs::path>& older_SSTs, const size_t& max_output_size = 0);
+        vector<int64_t> subcompaction_splits(const vector<fs::path>& inputs, const vector<SSTFooter>& footers, const size_t& total_count);
+        void merge_range(const vector<fs::path>& inputs, const vector<SSTFooter>& footers, const int64_t& min_key, const int64_t& max_key,
+                         const vector<unique_ptr<FilterReader>>& older_filters, const vector<RangeTombstones>& newer_ranges,
+                         const RangeTombstones& output_ranges, vector<pair<int64_t, int64_t>>& output);
+        void remove_SSTs(const vector<fs::path>& file_names, unique_lock<mutex>& lock);
+        void move_run_down(const size_t& level, unique_lock<mutex>& lock);
+        bool overlaps(const Level& level, const int64_t& min_key, const int64_t& max_key);
+        void check_levels();
 
         // BloomFilter functions
-        bool check_bloomFilter(const fs::path& filter_path, const int64_t& key, Level& cur_level);
+        bool check_bloomFilter(const fs::path& filter_path, const SSTMeta& meta, const int64_t& key);
 };
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <filesystem>
+#include <atomic>
+#include "constants.h"
+#include "aligned_KV_vector.h"
+#include "bloomFilter.h"
+using namespace std;
+namespace fs = std::filesystem;
+
+class LSMTree;
+
+/*
+ * Streams KV-pairs, given in strictly increasing key order, into a new SST:
+ * the leaves are staged and written SST_WRITE_SIZE bytes at a time, and the B-Tree non-leaf nodes and the
+ * Bloom Filter (and the footer) are written by finish(), which syncs the SST once. Used by compactions and by bulk ingestion.
+ */
+class SSTBuilder {
+    public:
+        size_t total_count; // KV-pairs added so far
+        int64_t min_key;
+        int64_t max_key;    // Also the last key added
+
+        // expected_size: number of KV-pairs the Bloom Filter is sized for
+        SSTBuilder(LSMTree& lsmtree, const size_t& level, const size_t& expected_size, const size_t& total_levels);
+        ~SSTBuilder();
+
+        void add(const pair<int64_t, int64_t>& KV);
+        // A range tombstone of the SST, within the keys added (its ends are point tombstones of the SST)
+        void add_range(const pair<int64_t, int64_t>& range);
+        // Return: the name of the new SST, or an empty string if nothing was added
+        string finish();
+
+        // A unique file name for an SST under construction, openDB removes the leftovers of a crash
+        static fs::path new_temp_path(const fs::path& sst_path);
+
+    private:
+        LSMTree& lsmtree;
+        aligned_KV_vector output_buffer; // Leaf pages staged for the next write
+        BloomFilter bloom_filter;
+        vector<int64_t> non_leaf_keys;   // Last key of every leaf page, they make up the B-Tree non-leaf nodes
+        fs::path temp_path;
+        int fd;
+        int64_t SST_offset;
+
+        static atomic<size_t> num_builders; // Gives every SST being built its own temporary file
+
+        static size_t staging_size(const size_t& expected_size);
+};
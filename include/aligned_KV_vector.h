@@ -23,7 +23,7 @@ class aligned_KV_vector {
             data = nullptr;
         }
 
-        int32_t size() {
+        size_t size() {
             return len;
         }
 
@@ -78,27 +78,28 @@ class aligned_KV_vector {
             return len == max_len;
         }
 
-        // When the buffer is full, flush data into a file
+        // Flush the data into a file with a single write, it must be made of whole pages
         // Return: the last key flushed
         pair<int64_t, int64_t> flush_to_file(const int& fd, off_t& offset) {
             #ifdef ASSERT
-                assert(isFull());
+                assert(len > 0 && len % constants::KEYS_PER_NODE == 0);
             #endif
-            int nbytes = pwrite(fd, (char*)data, max_len * constants::PAIR_SIZE, offset);
+            int nbytes = pwrite(fd, (char*)data, len * constants::PAIR_SIZE, offset);
             #ifdef ASSERT
-                assert(nbytes == (int)(max_len * constants::PAIR_SIZE));
+                assert(nbytes == (int)(len * constants::PAIR_SIZE));
             #endif
-            offset += max_len * constants::PAIR_SIZE;
+            offset += len * constants::PAIR_SIZE;
+            pair<int64_t, int64_t> last = data[len - 1];
 
             // Clear the data
             len = 0;
 
-            return data[max_len - 1];
+            return last;
         }
 
         // Pad the data to become a mulitple of pages large
         inline int32_t add_padding() {
-            int32_t padding = constants::KEYS_PER_NODE - ((int32_t)this->size() % constants::KEYS_PER_NODE);
+            int32_t padding = constants::KEYS_PER_NODE - (int32_t)(len % constants::KEYS_PER_NODE);
             for (int32_t i = 0; i < padding; ++i) {
                 this->emplace_back(this->back());
             }
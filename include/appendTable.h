@@ -0,0 +1,36 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include "constants.h"
+#include "memtable.h"
+#include "aligned_KV_vector.h"
+using namespace std;
+
+/*
+ * Memtable of the append mode, for keys put in strictly increasing order (e.g. timestamps).
+ * The pairs are appended to an array laid out like the leaves of an SST: there is no tree to balance and no
+ * duplicate to look for, and the array is flushed as it is. The database only puts keys that accepts() allows,
+ * and goes back to a regular memtable on the first key that comes out of order.
+ */
+class AppendTable : public Memtable {
+    public:
+        aligned_KV_vector sorted_KV; // Whole pages, so the last page can be padded in place when flushing
+
+        AppendTable(size_t capacity);
+        ~AppendTable() {}
+
+        Result put(const int64_t& key, const int64_t& value) override;
+        void put_sorted(const pair<int64_t, int64_t>* sorted_KV, const size_t& count) override;
+        Result get(int64_t*& result, const int64_t& key) override;
+        void scan(vector<pair<int64_t, int64_t>>& sorted_KV, const int64_t& key1, const int64_t& key2) override;
+        void scan_all(aligned_KV_vector& sorted_KV, const function<void(const size_t&)>& on_chunk) override;
+        bool has_key_from(const int64_t& key) override { return sorted_KV.len > 0 && sorted_KV.back().first >= key; }
+        void clear() override;
+        bool concurrent() override { return false; }
+
+        // Whether count sorted pairs, starting with key, can be appended: key comes after the last key and they fit
+        inline bool accepts(const int64_t& key, const size_t& count = 1) {
+            return (sorted_KV.len == 0 || key > sorted_KV.back().first) && sorted_KV.len + count <= sorted_KV.max_len;
+        }
+};
@@ -0,0 +1,92 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <cassert>
+#include <cstddef>
+#include <atomic>
+#include "constants.h"
+using namespace std;
+
+/*
+ * Bump allocator for memtable nodes.
+ * Memory is carved out of large blocks and is never freed one object at a time;
+ * instead, reset() rewinds the arena in one shot when the memtable is flushed.
+ * The blocks are kept and reused by the next memtable, so a steady write workload
+ * stops calling malloc after the first memtable has been filled.
+ */
+class Arena {
+    public:
+        size_t block_size;
+        size_t num_allocations; // Counts the number of blocks ever requested from the heap
+
+        Arena(size_t block_size = constants::ARENA_BLOCK_SIZE) :
+            block_size(block_size), num_allocations(0), cur_block(0), alloc_ptr(nullptr), alloc_remaining(0) {}
+
+        ~Arena() {
+            for (char* block : blocks) {
+                delete[] block;
+            }
+            blocks.clear();
+        }
+
+        // Return a chunk of `bytes` bytes aligned for any fundamental type
+        inline char* allocate(size_t bytes) {
+            // Round up so that every chunk handed out stays aligned
+            bytes = (bytes + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+            if (bytes > alloc_remaining) {
+                next_block(bytes);
+            }
+            char* result = alloc_ptr;
+            alloc_ptr += bytes;
+            alloc_remaining -= bytes;
+            return result;
+        }
+
+        // Same as allocate(), but safe to call from several threads at the same time
+        // The critical section is only a pointer bump, so a spinlock is cheaper than a mutex here
+        inline char* allocate_concurrent(size_t bytes) {
+            while (lock.test_and_set(memory_order_acquire)) {}
+            char* result = allocate(bytes);
+            lock.clear(memory_order_release);
+            return result;
+        }
+
+        // Rewind the arena; all previously allocated chunks become invalid
+        void reset() {
+            cur_block = 0;
+            if (blocks.empty()) {
+                alloc_ptr = nullptr;
+                alloc_remaining = 0;
+            } else {
+                alloc_ptr = blocks[0];
+                alloc_remaining = block_size;
+            }
+        }
+
+        // Total bytes held by the arena
+        inline size_t memory_usage() {
+            return blocks.size() * block_size;
+        }
+
+    private:
+        vector<char*> blocks;
+        size_t cur_block; // Index of the block we are currently carving from
+        char* alloc_ptr;
+        size_t alloc_remaining;
+        atomic_flag lock = ATOMIC_FLAG_INIT;
+
+        // Move to the next block, allocating one from the heap if all blocks are used up
+        void next_block(size_t bytes) {
+            #ifdef ASSERT
+                assert(bytes <= block_size);
+            #endif
+            if (!blocks.empty() && alloc_ptr != nullptr) ++cur_block;
+            if (cur_block >= blocks.size()) {
+                blocks.emplace_back(new char[block_size]);
+                ++num_allocations;
+                cur_block = blocks.size() - 1;
+            }
+            alloc_ptr = blocks[cur_block];
+            alloc_remaining = block_size;
+        }
+};
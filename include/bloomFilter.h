@@ -8,11 +8,21 @@
 #include "constants.h"
 #include "MurmurHash3.h"
 #include "LSMTree.h"
+#include "rangeTombstones.h"
 #include <cmath>
 #include <bitset>
 using namespace std;
 namespace fs = std::filesystem;
 
+// First page of a Bloom Filter file. Filters are probed with the parameters they were built with,
+// since the shape of the LSM-Tree (and thus Monkey's allocation) may have changed since then.
+typedef struct alignas(constants::PAGE_SIZE) BloomFilterHeader {
+    uint64_t num_cache_lines = 0; // Cachelines addressed by the hash (excluding padding)
+    uint64_t num_of_hashes = 0;
+    uint64_t num_tombstones = 0;  // Tombstones of the SST, tells when it is worth compacting early
+    uint64_t num_range_tombstones = 0; // Range tombstones of the SST, stored as pairs in the pages after the bitmap
+} BloomFilterHeader;
+
 class BloomFilter {
     public:
         bitset<constants::CACHE_LINE_SIZE_BITS>* bitmap;
@@ -21,16 +31,18 @@ class BloomFilter {
         size_t total_num_bits; // bits_per_entry * num_of_entries
         size_t total_num_cache_lines; // total_num_bits / cacheline_size
         size_t padded_num_cache_line; // total num cachelines after padding
+        size_t num_tombstones; // Counted by whoever builds the SST, recorded in the header
+        RangeTombstones range_tombstones; // Of the SST, stored in the filter file too
 
-        // size: num of kv entries
-        BloomFilter(const size_t& size, const size_t& current_level, const size_t& total_level) {
-            bits_per_entry = calculate_num_bits_per_entry(current_level, total_level);
+        // size: num of kv entries, bits_per_entry: given by Monkey for the level of the SST
+        BloomFilter(const size_t& size, const float& bits_per_entry) : bits_per_entry(bits_per_entry), num_tombstones(0) {
             total_num_bits = (size_t)(size * bits_per_entry);
-            total_num_cache_lines = (total_num_bits >> constants::CACHE_LINE_SIZE_BITS_SHIFT);
+            // Filters are sized by the actual number of entries, so round up: a small SST still needs a cacheline
+            total_num_cache_lines = max((total_num_bits + constants::CACHE_LINE_SIZE_BITS - 1) >> constants::CACHE_LINE_SIZE_BITS_SHIFT, (size_t)1);
             num_of_hashes = calculate_num_of_hashes(bits_per_entry);
 
             // If the array is not a multiple of pages, we need to pad it to become multiple of pages
-            padded_num_cache_line = (total_num_bits >> constants::CACHE_LINE_SIZE_BITS_SHIFT) + constants::NUM_CACHELINE_PER_PAGE - 1;
+            padded_num_cache_line = total_num_cache_lines + constants::NUM_CACHELINE_PER_PAGE - 1;
             padded_num_cache_line -= (padded_num_cache_line % constants::NUM_CACHELINE_PER_PAGE);
 
             // Allocate a memory aligned cacheline arrays
@@ -47,13 +59,17 @@ class BloomFilter {
 
         void set(const int64_t& key);
         void writeToStorage(const string& filter_path);
-        // Calculate the adjusted number of bits based on the formula on Monkey paper
-        static inline float calculate_num_bits_per_entry(const size_t& current_level, const size_t& total_level) {
-            if (current_level == total_level - 1) {
-                return constants::LAST_LEVEL_M; // (logT - logR - log(T-1)) / ln2
-            } else {
-                return constants::LOGT_LN2 * (total_level - current_level) + constants::LOGR_LN2; // ((L+1-i)logT - logR) / ln2
-            }
+        // Read the header of a filter file, and its range tombstones if asked to
+        static BloomFilterHeader read_header(const fs::path& filter_path, RangeTombstones* range_tombstones = nullptr);
+        /* Calculate the adjusted number of bits based on the formula on Monkey paper: the false positive rate of a run is
+         * proportional to its size, and they add up to fpr. With a size ratio T, a full run holds about (T - 1) / T of the
+         * entries of the tree on the last level, and T times less on every level above; each of the runs of a level
+         * that holds several gets its share. Bits per entry = -ln(FPR) / ln(2)^2 */
+        static inline float calculate_num_bits_per_entry(const size_t& current_level, const size_t& total_level, const size_t& size_ratio,
+                                                         const size_t& runs, const double& fpr) {
+            double run_fpr = fpr * (size_ratio - 1) / size_ratio / runs / pow(size_ratio, total_level - 1 - current_level);
+            if (run_fpr >= 1) return 0;
+            return -log(run_fpr) / (M_LN2 * M_LN2);
         }
         // # hashes = M*ln2
         static inline size_t calculate_num_of_hashes(const float& bits_per_entry) {
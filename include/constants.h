@@ -15,20 +15,47 @@ namespace constants {
     const int KEYS_PER_NODE = (1 << 12) / PAIR_SIZE; //4kb node
     const int MEMTABLE_SIZE = (1 << 20) / PAIR_SIZE; //1mb memtable
     const size_t PAGE_SIZE = KEYS_PER_NODE * PAIR_SIZE; // 4kb page
+    const int NON_LEAF_KEYS = KEYS_PER_NODE - 1; // Keys of a B-Tree non-leaf node, so that its 64-bit child offsets fit in a page too
+
+    // Memtable constants
+    const size_t ARENA_BLOCK_SIZE = 1 << 20; // 1mb arena blocks for memtable nodes
+    const int32_t SKIPLIST_MAX_HEIGHT = 12; // Enough for 4^12 = 16M entries
+    const uint32_t SKIPLIST_BRANCHING = 4; // A node reaches the next level with probability 1/4
+    const size_t MAX_IMMUTABLE_MEMTABLES = 2; // Full memtables waiting for the flush thread before puts stall
+    const size_t FLUSH_CHUNK_SIZE = 64 * KEYS_PER_NODE; // A flush writes and indexes the scanned leaves 256kb at a time
+
+    // Write-ahead log constants
+    const size_t WAL_SYNC_INTERVAL_MS = 10; // How often the log is synced with the sync_interval policy
+    const size_t WAL_BUFFER_SIZE = 1 << 16; // 64kb of records buffered before they are written, when not syncing every write
+    const uint64_t WAL_RANGE_DELETE = 1ull << 63; // Flag in the count of a log record that deletes the range [first, second] of its pair
 
     // Bufferpool constants
     const int BUFFER_POOL_CAPACITY = 10 * MEMTABLE_SIZE / KEYS_PER_NODE; // 10MB
     const bool USE_BUFFER_POOL = true;
 
-    // LSM-Tree constants
+    // LSM-Tree constants (size ratio, merge policy and Bloom Filter FPR are defaults of Options)
     const size_t LSMT_SIZE_RATIO = 4;
-    const size_t LSMT_DEPTH = 10;
+    const size_t LSMT_DEPTH = 10; // Levels allocated up front, the tree grows past them when needed
+    const size_t L0_STALL_LIMIT = LSMT_SIZE_RATIO; // Level-0 runs beyond a full level before flushes stall
+    const size_t INGEST_READ_SIZE = 1 << 20; // Bulk ingestion reads the sorted input file 1mb at a time
+    const size_t SUBCOMPACTION_SIZE = 4 * MEMTABLE_SIZE; // Compactions are split into key ranges of about this many input pairs
+    const size_t MAX_SUBCOMPACTIONS = 4; // Key ranges of one compaction merged at the same time
+    const size_t COMPACTION_READAHEAD_SIZE = 1 << 20; // Compactions read each input 1mb at a time, while merging the previous 1mb
+    const size_t SST_WRITE_SIZE = 1 << 22; // Compactions and bulk ingestion write the leaves of their output 4mb at a time
+    const size_t SST_PARTITION_SIZE = 1 << 26; // With partitioned levels, compactions cut their output into SSTs of 64mb of leaves
+    const uint64_t SST_FOOTER_MAGIC = 0x31544f4f46545353; // "SSTFOOT1", the format version of the footer that ends every SST
+    const uint64_t MANIFEST_MAGIC = 0x3146494e414d564b; // "KVMANIF1", starts every record of the MANIFEST
+    const size_t MANIFEST_MAX_SIZE = 1 << 20; // Past 1mb of records, the MANIFEST is rewritten with only the current version
+
+    // Learned index constants
+    const size_t LEARNED_INDEX_ERROR = 1; // Pages the learned index of an SST may be off by on the last key of a page
 
     // Sequential Flooding Prevention constants
     const size_t SEQUENTIAL_FLOODING_LIMIT = 1000;
 
     // Deletion constants
     const int64_t TOMBSTONE = std::numeric_limits<int64_t>::min();
+    const double TOMBSTONE_COMPACTION_RATIO = 0.5; // SSTs with a larger share of tombstones are compacted before their level is full
 
     // Bloom Filter constants
     const uint32_t CACHE_LINE_SIZE_BYTES = 64; // bytes
@@ -41,8 +68,5 @@ namespace constants {
     const uint32_t BYTE_BIT_SHIFT = 3; // 1Byte=8bits=2^3
 
     // Monkey
-    // If you change the LSM-Tree RATIO, remember to change the following numbers
-    const float LAST_LEVEL_M = 5.3913; // (logT - logR - log(T-1)) / ln2, T=4, R=0.1
-    const float LOGT_LN2 = 2.885; // logT/ln2, T=4
-    const float LOGR_LN2 = 4.7925; // logR/ln2, R=0.1
+    const double BLOOM_FPR = 0.1; // Sum of the false positive rates of the Bloom Filters of all levels (R)
 }
\ No newline at end of file
@@ -4,12 +4,25 @@
 #include <filesystem>
 #include <set>
 #include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <functional>
+#include "options.h"
+#include "memtable.h"
 #include "rbtree.h"
+#include "skiplist.h"
+#include "appendTable.h"
 #include "LSMTree.h"
 #include "bufferpool.h"
 #include "aligned_KV_vector.h"
 #include "bloomFilter.h"
 #include "constants.h"
+#include "wal.h"
+#include "writeBatch.h"
+#include "SSTBuilder.h"
 
 using namespace std;
 namespace fs = std::filesystem;
@@ -17,10 +30,13 @@ namespace fs = std::filesystem;
 class Database {
     public:
         string db_name;
-        RBTree* memtable;
+        Options options;
+        Memtable* memtable;                   // Active memtable that receives the puts
+        deque<Memtable*> immutable_memtables; // Full memtables waiting to be flushed, oldest first
         LSMTree* lsmtree;
         Bufferpool* bufferpool;
-        size_t memtable_capacity;
+        WAL* wal;
+        atomic<size_t> memtable_capacity; // Entries a new memtable holds, follows the memtable budget
         Node* memtable_root;
 
         Database(size_t memtable_capacity, Node* memtable_root=nullptr) :
@@ -30,18 +46,48 @@ class Database {
             memtable = nullptr;
             lsmtree = nullptr;
             bufferpool = nullptr;
+            wal = nullptr;
         }
 
-        void openDB(const string db_name);
+        void openDB(const string db_name, const Options& options = Options());
         void closeDB();
         void put(const int64_t& key, const int64_t& value);
+        // use_btree: search_btree if true, search_binary otherwise
         const int64_t* get(const int64_t& key, const bool use_btree);
+        const int64_t* get(const int64_t& key, const SearchMode mode);
         const vector<pair<int64_t, int64_t>>* scan(const int64_t& key1, const int64_t& key2, const bool use_btree);
+        const vector<pair<int64_t, int64_t>>* scan(const int64_t& key1, const int64_t& key2, const SearchMode mode);
         void del(const int64_t& key);
+        void delete_range(const int64_t& key1, const int64_t& key2);
+        void write(WriteBatch& batch);
+        void ingest_sorted(const fs::path& file_path);
+        void ingest_sorted(const function<bool(pair<int64_t, int64_t>&)>& next, const size_t& expected_count);
+        void set_memtable_budget(const size_t& bytes);
 
     private:
         void removeTombstones(std::vector<std::pair<int64_t, int64_t>>*& sorted_KV, int64_t tombstone);
-        string writeToSST();
-        void scan_memtable(aligned_KV_vector& sorted_KV, Node* root);
-        void clear_tree();
+        // Writers of a concurrent memtable share this lock, writers of a single-writer memtable and memtable swaps
+        // take it exclusively. Readers share it, so that a flushed memtable cannot be freed under them.
+        shared_mutex memtable_mutex;
+
+        // Background flush of the immutable memtables
+        thread flush_thread;
+        condition_variable_any flush_cv;   // Signals the flush thread that there is work (or that it should stop)
+        condition_variable_any stall_cv;   // Signals stalled writers that an immutable memtable has been flushed
+        bool stop_flush;
+        Memtable* spare_memtable;          // A flushed memtable kept around, so its arena can be reused
+        AppendTable* append_table;         // The active memtable while in append mode, nullptr otherwise
+
+        uint64_t log_and_insert(const int64_t& key, const int64_t& value);
+        uint64_t log_and_insert(const pair<int64_t, int64_t>* sorted_KV, const size_t& count);
+        uint64_t log_and_delete_range(const int64_t& key1, const int64_t& key2);
+        void replay_wal(const vector<fs::path>& segments);
+        Memtable* new_memtable();
+        Memtable* take_memtable();
+        void swap_memtable(unique_lock<shared_mutex>& lock);
+        void switch_append_mode(const int64_t& key, const size_t& count, unique_lock<shared_mutex>& lock);
+        void leave_append_mode(unique_lock<shared_mutex>& lock);
+        void flush_worker();
+        string writeToSST(Memtable* table);
+        string writeAppendedToSST(AppendTable* table);
 };
\ No newline at end of file
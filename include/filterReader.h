@@ -0,0 +1,26 @@
+#pragma once
+#include <iostream>
+#include <filesystem>
+#include <bitset>
+#include "constants.h"
+using namespace std;
+namespace fs = std::filesystem;
+
+/*
+ * Probes the Bloom Filter of an SST straight from its file, for compactions: they run without lsmt_mutex, so they
+ * cannot go through the buffer pool. The header is read once, and every probe only reads the cacheline of its key
+ * (through the page cache, filters of the SSTs below a compaction are probed over and over).
+ */
+class FilterReader {
+    public:
+        FilterReader(const fs::path& filter_path);
+        ~FilterReader();
+
+        // False if the SST surely does not hold the key
+        bool may_contain(const int64_t& key);
+
+    private:
+        int fd;
+        size_t num_cache_lines;
+        size_t num_of_hashes;
+};
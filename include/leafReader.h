@@ -0,0 +1,49 @@
+#pragma once
+#include <iostream>
+#include <filesystem>
+#include <aio.h>
+#include "constants.h"
+using namespace std;
+namespace fs = std::filesystem;
+
+/*
+ * Reads the leaves of an SST in key order, for compactions.
+ * The leaves are read in chunks of chunk_size bytes with double buffering: while the merge consumes one chunk,
+ * the next one is read asynchronously (POSIX AIO) into the other buffer, so the merge only waits for the device
+ * when it outruns it, never on a single page.
+ */
+class LeafReader {
+    public:
+        // Read the leaves in [start, end), both page-aligned file offsets
+        LeafReader(const fs::path& file_path, const size_t& start, const size_t& end, const size_t& chunk_size);
+        ~LeafReader();
+
+        inline bool valid() {
+            return index < len;
+        }
+
+        inline const pair<int64_t, int64_t>& current() {
+            return data[index];
+        }
+
+        inline void next() {
+            if (++index == len) advance();
+        }
+
+    private:
+        int fd;
+        size_t chunk_size;
+        size_t end;
+        size_t next_offset;                 // File offset of the next chunk to read
+        pair<int64_t, int64_t>* buffers[2];
+        size_t reading_buffer;              // Buffer the read ahead goes to
+        pair<int64_t, int64_t>* data;       // Chunk being consumed
+        size_t index;
+        size_t len;
+        struct aiocb request;
+        bool reading;                       // A read ahead is in flight
+
+        void start_read();
+        void wait_read();
+        void advance();
+};
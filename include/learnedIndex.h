@@ -0,0 +1,31 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include "constants.h"
+using namespace std;
+
+/*
+ * A learned index of the leaf pages of an SST: a piecewise linear model of key -> leaf page, fitted on the fence
+ * pointers (the last key of each leaf page but the last) so that it predicts the page of every fence within
+ * LEARNED_INDEX_ERROR pages. Keys that are evenly spread take a few segments for thousands of pages, a small fraction
+ * of the memory of the fence pointers or of the B-Tree non-leaf nodes. A predicted page is then checked against
+ * the keys it holds, see LSMTree::find_leaf.
+ */
+class LearnedIndex {
+    public:
+        struct Segment {
+            int64_t first_key;  // Fence the segment starts at
+            int64_t first_page; // The page of that fence
+            double slope;       // Pages per key
+        };
+        vector<Segment> segments; // By first_key
+        int64_t last_page;
+
+        LearnedIndex() : last_page(0) {}
+
+        void build(const vector<int64_t>& fences);
+        // A page within LEARNED_INDEX_ERROR + 1 pages of the first page whose last key is >= key (or of the last page)
+        int64_t predict(const int64_t& key) const;
+        inline size_t bytes() const { return segments.capacity() * sizeof(Segment); }
+};
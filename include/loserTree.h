@@ -0,0 +1,88 @@
+#pragma once
+#include <iostream>
+#include <vector>
+using namespace std;
+
+/*
+ * Tournament tree of losers for k-way merges of sorted sources, used by compactions and scans.
+ * Leaf k + i is source i, each internal node keeps the loser of the match played there, and tree[0] the overall
+ * winner: the source with the smallest current key, the one with the greater index on equal keys (the newer one).
+ * Replacing the winner only replays the matches on the path from its leaf to the root, about log k comparisons,
+ * where a binary heap needs about 2 log k for the pop and push.
+ */
+class LoserTree {
+    public:
+        LoserTree(const size_t& num_sources) : num_sources(num_sources), tree(num_sources, 0),
+                                               heads(num_sources), exhausted(num_sources, true) {};
+
+        // Give a source its first pair, before build(). A source that is never given one is empty
+        inline void set(const size_t& source, const pair<int64_t, int64_t>& KV) {
+            heads[source] = KV;
+            exhausted[source] = false;
+        }
+
+        /* Play all the matches, bottom-up */
+        void build() {
+            vector<size_t> winners(2 * num_sources);
+            for (size_t i = 0; i < num_sources; ++i) {
+                winners[num_sources + i] = i;
+            }
+            for (size_t node = num_sources - 1; node > 0; --node) {
+                size_t left = winners[2 * node];
+                size_t right = winners[2 * node + 1];
+                if (beats(left, right)) {
+                    winners[node] = left;
+                    tree[node] = right;
+                } else {
+                    winners[node] = right;
+                    tree[node] = left;
+                }
+            }
+            tree[0] = (num_sources == 1) ? 0 : winners[1];
+        }
+
+        inline bool empty() {
+            return exhausted[tree[0]];
+        }
+
+        inline size_t top_source() {
+            return tree[0];
+        }
+
+        inline const pair<int64_t, int64_t>& top() {
+            return heads[tree[0]];
+        }
+
+        // The winner is consumed: KV is the next pair of its source
+        inline void replace_top(const pair<int64_t, int64_t>& KV) {
+            heads[tree[0]] = KV;
+            replay(tree[0]);
+        }
+
+        // The winner is consumed and its source has no pair left
+        inline void pop_top() {
+            exhausted[tree[0]] = true;
+            replay(tree[0]);
+        }
+
+    private:
+        size_t num_sources;
+        vector<size_t> tree;                  // tree[0]: winner, tree[1..k-1]: loser of the match at each internal node
+        vector<pair<int64_t, int64_t>> heads; // Current pair of each source
+        vector<char> exhausted;               // Not vector<bool>: no bit unpacking on every match
+
+        inline bool beats(const size_t& a, const size_t& b) {
+            if (exhausted[a]) return false;
+            if (exhausted[b]) return true;
+            if (heads[a].first != heads[b].first) return heads[a].first < heads[b].first;
+            return a > b;
+        }
+
+        /* The head of source changed: play its matches again up to the root */
+        inline void replay(size_t source) {
+            for (size_t node = (num_sources + source) / 2; node > 0; node /= 2) {
+                if (beats(tree[node], source)) swap(tree[node], source);
+            }
+            tree[0] = source;
+        }
+};
@@ -0,0 +1,62 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <filesystem>
+#include <mutex>
+#include "constants.h"
+using namespace std;
+namespace fs = std::filesystem;
+
+// One live SST of a version of the LSM-Tree
+struct ManifestFile {
+    uint64_t level;
+    uint64_t units;       // Units of its run (see Level::run_units), 1 on a partitioned level
+    uint64_t file_number; // The SST is <file_number>.bytes
+};
+
+// Header of a MANIFEST record, followed by the num_files live SSTs of the version, level by level,
+// in the order of Level::sorted_dir
+struct ManifestRecordHeader {
+    uint64_t magic;
+    uint64_t version;          // Of the LSM-Tree, one more with every record
+    uint64_t next_file_number; // SSTs numbers from this one on are free
+    uint64_t num_levels;
+    uint64_t num_files;
+    uint64_t checksum;         // Of the whole record with this field zeroed, detects a record torn by a crash
+};
+
+/*
+ * The MANIFEST of a database: a log of the versions of the LSM-Tree, every record listing the live SSTs of each level.
+ * A record is appended and synced whenever the levels change (a flush, a compaction, an ingestion), before the SSTs
+ * it drops are removed, and openDB restores the last valid one instead of listing the SST directory.
+ * The first record of every opening, and the first one past MANIFEST_MAX_SIZE, rewrite the file with just the current
+ * version (through a temporary file), so that the log stays small and never goes on after a torn record.
+ * A record is built while the levels are locked, and written without that lock: writes are serialized on their own,
+ * and a record older than the last one written is skipped, since every record lists the whole version.
+ */
+class Manifest {
+    public:
+        fs::path path;
+        uint64_t version; // Of the last record read or written
+
+        Manifest(const fs::path& path) : path(path), version(0), fd(-1), size(0), written_version(0) {}
+        ~Manifest();
+
+        // Read the last valid record. Return: false if there is none, that is a new database
+        bool load(ManifestRecordHeader& header, vector<ManifestFile>& files);
+        // The record of a new version. Callers serialize it with the changes it records
+        vector<char> record(const uint64_t& next_file_number, const uint64_t& num_levels, const vector<ManifestFile>& files);
+        // Append a record and sync it, unless a newer one already is
+        void write(const vector<char>& record);
+        // Record a new version and sync it
+        void append(const uint64_t& next_file_number, const uint64_t& num_levels, const vector<ManifestFile>& files);
+
+    private:
+        mutex write_mutex;        // Protects the file and the fields below
+        int fd;                   // Open for appends once the file has been rewritten, -1 before
+        size_t size;              // Bytes of the file
+        uint64_t written_version; // Of the last record synced
+
+        static uint64_t checksum(const char* record, const size_t& length);
+        void rewrite(const vector<char>& record);
+};
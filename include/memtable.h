@@ -0,0 +1,57 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include "constants.h"
+#include "aligned_KV_vector.h"
+#include "rangeTombstones.h"
+using namespace std;
+
+enum Result {allGood, notInMemtable, memtableFull};
+
+/*
+ * Common contract of all memtable implementations (RBTree, SkipList).
+ * Keys are unique: putting an existing key updates its value in-place.
+ */
+class Memtable {
+    public:
+        size_t max_size;              // Maximum capacity
+        atomic<size_t> curr_size;     // Current size
+        // Ranges deleted while this memtable was active. They only delete older data: the keys the memtable held in
+        // them were turned into tombstones, so a pair of the memtable is always newer than the ranges that cover it
+        RangeTombstones range_tombstones;
+
+        Memtable(size_t capacity) : max_size(capacity), curr_size(0) {}
+        virtual ~Memtable() {}
+
+        virtual Result put(const int64_t& key, const int64_t& value) = 0;
+        // Insert count KV-pairs sorted by unique key. The caller checked the capacity once for all of them,
+        // and holds exclusive access to the memtable
+        virtual void put_sorted(const pair<int64_t, int64_t>* sorted_KV, const size_t& count) = 0;
+        virtual Result get(int64_t*& result, const int64_t& key) = 0;
+        // Append all KV-pairs in [key1, key2] to sorted_KV, in key order
+        virtual void scan(vector<pair<int64_t, int64_t>>& sorted_KV, const int64_t& key1, const int64_t& key2) = 0;
+        // Whether the memtable holds a key greater than or equal to key
+        virtual bool has_key_from(const int64_t& key) = 0;
+        // Append every KV-pair to sorted_KV in key order, used when flushing to an SST.
+        // on_chunk(n) is called every FLUSH_CHUNK_SIZE pairs (n: pairs appended so far), so the flush can start on them
+        virtual void scan_all(aligned_KV_vector& sorted_KV, const function<void(const size_t&)>& on_chunk) = 0;
+        // Delete every key in [key1, key2]: the keys held in the range and its two ends become tombstones (the caller
+        // made room for two pairs), and the range is recorded for the older data. Caller holds exclusive access
+        virtual void delete_range(const int64_t& key1, const int64_t& key2) {
+            vector<pair<int64_t, int64_t>> in_range;
+            scan(in_range, key1, key2);
+            for (const pair<int64_t, int64_t>& KV : in_range) {
+                put(KV.first, constants::TOMBSTONE);
+            }
+            put(key1, constants::TOMBSTONE);
+            put(key2, constants::TOMBSTONE);
+            range_tombstones.add(key1, key2);
+        }
+        // Drop all the entries, range tombstones included. Must not run concurrently with any other operation
+        virtual void clear() = 0;
+        // Whether put() can be called by several threads at the same time
+        virtual bool concurrent() = 0;
+};
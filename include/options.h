@@ -0,0 +1,71 @@
+#pragma once
+#include <iostream>
+#include "constants.h"
+using namespace std;
+
+// Data structures that can back the memtable
+enum MemtableType {rbtree_memtable, skiplist_memtable};
+
+// How the runs of a level are merged (with whole-level compaction). A level is full once it holds size_ratio units,
+// a unit being a full run of the level above; it then goes down as one run of the next level
+// tiering: every level holds up to runs_per_level runs
+// leveling: every level is one run, that runs coming from above are merged into
+// lazy_leveling: the last level is one run, the other levels hold up to runs_per_level runs (Dostoevsky)
+enum MergePolicy {tiering, leveling, lazy_leveling};
+
+// When the write-ahead log is forced to storage
+// sync_always: put() returns once its record is synced (concurrent writers share one fdatasync)
+// sync_interval: the log is synced in the background every wal_sync_interval_ms, a crash loses at most that much
+// sync_none: the log is left to the OS, it survives a process crash only once its buffer has been written
+enum SyncPolicy {sync_always, sync_interval, sync_none};
+
+// How get() and scan() find the leaf page of a key in an SST
+// search_binary: a binary search of the leaf pages
+// search_btree: the fence pointers, the keys of the B-Tree non-leaf nodes kept in memory (see BTree::read_fences)
+// search_learned: the page a learned index predicts (see LearnedIndex), checked against the keys of the pages around it
+enum SearchMode {search_binary, search_btree, search_learned};
+
+// Options chosen when opening a database
+struct Options {
+    // RBTree is single-writer; the skiplist lets several threads put() at the same time
+    MemtableType memtable_type = rbtree_memtable;
+    // The index of the leaf pages of each SST kept in memory, read the first time the SST is searched: search_btree
+    // keeps its fence pointers, search_learned only a learned index, fitted on them and then dropped, search_binary none.
+    // A lookup that asks for another index uses this one (or a binary search, rather than keep a second index)
+    SearchMode sst_index = search_btree;
+    // Memtable budget in bytes: the size of the KV-pairs a memtable holds before it is flushed, that is of the
+    // leaves of its SST. 0 keeps the capacity given to the Database constructor. Can be changed with set_memtable_budget()
+    size_t memtable_budget = 0;
+    // Number of full memtables that can wait to be flushed in the background before put() blocks
+    size_t max_immutable_memtables = constants::MAX_IMMUTABLE_MEMTABLES;
+    // Compaction debt of level 0 (runs beyond a full level) above which flushes, and therefore puts, stall
+    size_t l0_stall_limit = constants::L0_STALL_LIMIT;
+    // Bytes of each compaction input read at once (and double-buffered), e.g. 1-8mb
+    size_t compaction_readahead_size = constants::COMPACTION_READAHEAD_SIZE;
+    // Shape of the LSM-Tree, see MergePolicy. runs_per_level is clamped to [1, size_ratio - 1], 0 means size_ratio - 1.
+    // The size ratio and the merge policy can change between two openings of a database
+    size_t size_ratio = constants::LSMT_SIZE_RATIO;
+    MergePolicy merge_policy = lazy_leveling;
+    size_t runs_per_level = 0;
+    // Target sum of the false positive rates of the Bloom Filters of all levels, divided between them with Monkey.
+    // It must be greater than 0, and a level whose share reaches 1 gets no Bloom Filter
+    double bloom_fpr = constants::BLOOM_FPR;
+    // Partitioned levels: every level below level 0 is one sorted run cut into non-overlapping SSTs of sst_partition_size
+    // bytes of leaves, and a compaction merges one SST (all of level 0) with the SSTs it overlaps on the next level.
+    // The levels below level 0 are then leveled whatever the merge policy. Otherwise every level is compacted as a whole.
+    // A database must always be opened with the same setting
+    bool partitioned_levels = false;
+    size_t sst_partition_size = constants::SST_PARTITION_SIZE;
+    // Append mode, for keys put in increasing order (e.g. timestamps), with the RBTree memtable: while every put key is
+    // greater than all the keys of the database, the pairs are appended to an array rather than inserted into a tree,
+    // and the array is written as it is into an SST that is chained in key order on the last level, and never merged.
+    // Requires partitioned_levels (openDB throws otherwise): without partitions, the last level is one SST, so these
+    // SSTs would be merged into it all over again. put() detects the order by itself, and goes back to the memtable
+    // on the first key out of order
+    bool append_mode = false;
+    // An SST whose share of tombstones exceeds this is compacted (towards the last level, where tombstones are dropped)
+    // even if its level is not full, so that deleted entries do not linger above. 1 or more turns it off
+    double tombstone_compaction_ratio = constants::TOMBSTONE_COMPACTION_RATIO;
+    SyncPolicy wal_sync_policy = sync_interval;
+    size_t wal_sync_interval_ms = constants::WAL_SYNC_INTERVAL_MS;
+};
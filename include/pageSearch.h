@@ -0,0 +1,30 @@
+#pragma once
+#include <iostream>
+#include "constants.h"
+#include "BTree.h"
+using namespace std;
+
+// Instruction sets the searches inside a page can use
+enum SearchKernel {scalar_kernel, avx2_kernel, avx512_kernel};
+
+/*
+ * Search of a key inside a B-Tree page: the lower bound of the key among the sorted keys of a leaf (KEYS_PER_NODE pairs)
+ * or of a non-leaf node (its size keys). The kernels do not branch on the keys: the scalar one is a binary search by
+ * conditional moves, the AVX2 and AVX-512 ones compare the key with the last key of every block of 16 keys at once,
+ * then with the 16 keys of the block it falls in, and count the smaller ones.
+ * The best kernel the CPU supports is picked when the program starts.
+ */
+class PageSearch {
+    public:
+        static const SearchKernel kernel;
+
+        static bool supported(const SearchKernel& kernel);
+        // Index of the first pair of the leaf whose key is >= key, KEYS_PER_NODE if there is none
+        static size_t leaf_lower_bound(const BTreeLeafNode& leaf, const int64_t& key, const SearchKernel& kernel = PageSearch::kernel);
+        // Index of the first key of the node that is >= key, node.size if there is none
+        static size_t non_leaf_lower_bound(const BTreeNonLeafNode& node, const int64_t& key,
+                                           const SearchKernel& kernel = PageSearch::kernel);
+
+    private:
+        static SearchKernel best_kernel();
+};
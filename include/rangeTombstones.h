@@ -0,0 +1,64 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <algorithm>
+using namespace std;
+
+/*
+ * Key ranges deleted by delete_range(), sorted and disjoint: overlapping ranges are merged, since the
+ * holder (a memtable, an SST, or the merge of a scan or a compaction) only asks whether a key is covered.
+ * Whatever holds range tombstones also holds point tombstones on their two ends, so that the key range of an SST
+ * always spans its range tombstones.
+ */
+class RangeTombstones {
+    public:
+        vector<pair<int64_t, int64_t>> ranges; // [first, second], both included
+
+        inline bool empty() const { return ranges.empty(); }
+        inline void clear() { ranges.clear(); }
+
+        /* Delete [key1, key2] too, merging it with the ranges it overlaps */
+        void add(const int64_t& key1, const int64_t& key2) {
+            // First range that ends at key1 or later, it is the first one the new range may overlap
+            auto first = lower_bound(ranges.begin(), ranges.end(), key1,
+                                     [](const pair<int64_t, int64_t>& range, const int64_t& key) { return range.second < key; });
+            auto last = first;
+            int64_t min_key = key1, max_key = key2;
+            for (; last != ranges.end() && last->first <= key2; ++last) {
+                min_key = min(min_key, last->first);
+                max_key = max(max_key, last->second);
+            }
+            first = ranges.erase(first, last);
+            ranges.emplace(first, min_key, max_key);
+        }
+
+        void add(const RangeTombstones& other) {
+            for (const pair<int64_t, int64_t>& range : other.ranges) {
+                add(range.first, range.second);
+            }
+        }
+
+        /* The range holding key, or ranges.end() */
+        inline vector<pair<int64_t, int64_t>>::const_iterator find(const int64_t& key) const {
+            auto range = lower_bound(ranges.begin(), ranges.end(), key,
+                                     [](const pair<int64_t, int64_t>& range, const int64_t& key) { return range.second < key; });
+            return (range != ranges.end() && range->first <= key) ? range : ranges.end();
+        }
+
+        inline bool covers(const int64_t& key) const {
+            return !ranges.empty() && find(key) != ranges.end();
+        }
+
+        /* Whether every key in [key1, key2] is deleted */
+        inline bool covers(const int64_t& key1, const int64_t& key2) const {
+            auto range = find(key1);
+            return range != ranges.end() && range->second >= key2;
+        }
+
+        /* Whether some key in [key1, key2] is deleted */
+        inline bool overlaps(const int64_t& key1, const int64_t& key2) const {
+            auto range = lower_bound(ranges.begin(), ranges.end(), key1,
+                                     [](const pair<int64_t, int64_t>& range, const int64_t& key) { return range.second < key; });
+            return range != ranges.end() && range->first <= key2;
+        }
+};
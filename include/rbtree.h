@@ -5,11 +5,12 @@
 #include <set>
 #include <algorithm>
 #include "constants.h"
+#include "arena.h"
+#include "memtable.h"
 using namespace std;
 namespace fs = std::filesystem;
 
 enum Color {black, red};
-enum Result {allGood, notInMemtable, memtableFull};
 
 class Node {
     public:
@@ -20,41 +21,51 @@ class Node {
         Node* left;
         Node* right;
 
+        // Nodes live in the RBTree's arena, so they do not own (or free) their children
         Node(int64_t key, int64_t value, Color color=black, Node* parent=nullptr, Node* left=nullptr, Node* right=nullptr):
             key(key), value(value), color(color), parent(parent), left(left), right(right) {}
-
-        ~Node() {
-            delete left;
-            left = nullptr;
-            delete right;
-            right = nullptr;
-            #ifdef DEBUG
-                cout << "Deleted node with key: " << key << endl;
-            #endif
-        }
-
 };
 
-class RBTree {
+class RBTree : public Memtable {
     public:
+        /*
+         * In-order iterator over the tree, following the parent pointers: seek() finds the first key of a range
+         * in O(log n), and next() costs O(1) amortized, so a range scan only visits the nodes it returns
+         */
+        class Iterator {
+            public:
+                Node* node; // nullptr once past the last key
+
+                Iterator(Node* node) : node(node) {}
+                inline bool valid() { return node != nullptr; }
+                void next();
+        };
+
         Node* root;
-        size_t max_size;     // Maximum capacity
-        size_t curr_size;         // Current size
         int64_t min_key;          // Minimum key stored in the tree
         int64_t max_key;          // Maximum key stored in the tree
+        Arena arena;              // Backing memory of all the nodes in the tree
 
         RBTree(size_t capacity, Node* root=nullptr);
         ~RBTree();
 
-        Result put(const int64_t& key, const int64_t& value);
-        Result get(int64_t*& result, const int64_t& key);
-        void scan(vector<pair<int64_t, int64_t>>& sorted_KV, const Node* root, const int64_t& key1, const int64_t& key2);
+        Result put(const int64_t& key, const int64_t& value) override;
+        void put_sorted(const pair<int64_t, int64_t>* sorted_KV, const size_t& count) override;
+        Result get(int64_t*& result, const int64_t& key) override;
+        void scan(vector<pair<int64_t, int64_t>>& sorted_KV, const int64_t& key1, const int64_t& key2) override;
+        void scan_all(aligned_KV_vector& sorted_KV, const function<void(const size_t&)>& on_chunk) override;
+        bool has_key_from(const int64_t& key) override { return curr_size > 0 && max_key >= key; }
+        // Iterator at the first key >= key
+        Iterator seek(const int64_t& key);
+        void clear() override;
+        // RBTree rotations make it single-writer
+        bool concurrent() override { return false; }
 
     private:
         Node* search(Node* root, const int64_t& key);
         void rotateLeft(Node* x);
         void rotateRight(Node* x);
         void insertFixup(Node* node);
-        void insertNode(Node* node);
+        void insertNode(const int64_t& key, const int64_t& value);
         void deleteNode(Node* node);
 };
\ No newline at end of file
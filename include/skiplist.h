@@ -0,0 +1,52 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include "constants.h"
+#include "arena.h"
+#include "memtable.h"
+using namespace std;
+
+// Skiplist node, allocated from the arena with `height` next pointers
+struct SkipNode {
+    int64_t key;
+    atomic<int64_t> value;
+    int32_t height;
+    atomic<SkipNode*> next[1]; // Over-allocated to `height` entries
+
+    SkipNode(int64_t key, int64_t value, int32_t height) : key(key), value(value), height(height) {}
+
+    static inline size_t size_of(const int32_t& height) {
+        return sizeof(SkipNode) + (height - 1) * sizeof(atomic<SkipNode*>);
+    }
+};
+
+/*
+ * Lock-free skiplist memtable.
+ * Writers link new nodes bottom-up with compare-and-swap, so any number of threads can put() at the same time.
+ * Nodes are never unlinked (deletes are TOMBSTONE updates), so readers traverse the list without any lock.
+ */
+class SkipList : public Memtable {
+    public:
+        SkipNode* head;
+
+        SkipList(size_t capacity);
+        ~SkipList();
+
+        Result put(const int64_t& key, const int64_t& value) override;
+        void put_sorted(const pair<int64_t, int64_t>* sorted_KV, const size_t& count) override;
+        Result get(int64_t*& result, const int64_t& key) override;
+        void scan(vector<pair<int64_t, int64_t>>& sorted_KV, const int64_t& key1, const int64_t& key2) override;
+        void scan_all(aligned_KV_vector& sorted_KV, const function<void(const size_t&)>& on_chunk) override;
+        bool has_key_from(const int64_t& key) override { return seek(key) != nullptr; }
+        void clear() override;
+        bool concurrent() override { return true; }
+
+    private:
+        Arena arena;
+
+        int32_t random_height();
+        bool find(const int64_t& key, SkipNode** preds, SkipNode** succs);
+        SkipNode* seek(const int64_t& key);
+};
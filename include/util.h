@@ -15,4 +15,6 @@ namespace fs = std::filesystem;
  * These are functions that are used across multiple classes
  */
 size_t murmur_hash(const string& key);
-size_t murmur_hash(const int64_t& key, const uint32_t& seed);
\ No newline at end of file
+size_t murmur_hash(const int64_t& key, const uint32_t& seed);
+// Make the entries of a directory (files created or renamed in it) durable
+void sync_directory(const fs::path& dir);
@@ -0,0 +1,87 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "options.h"
+#include "constants.h"
+using namespace std;
+namespace fs = std::filesystem;
+
+// Header of a log record, followed by `count` KV-pairs: one for a put (or a delete, when the value
+// is the tombstone), several for a WriteBatch. A range delete is one pair, with WAL_RANGE_DELETE set in count
+struct WALRecordHeader {
+    uint64_t count;
+    uint64_t checksum; // Detects a record torn by a crash in the middle of a write
+};
+
+/*
+ * Write-ahead log of the memtables.
+ * The log is split into segments, one per memtable: a segment is started when the memtable is
+ * swapped out, and deleted once that memtable is safely in an SST. Segments are named <number>.log.
+ *
+ * Writers append() their record to an in-memory buffer (under the memtable lock, so the record lands
+ * in the segment of the memtable it goes to), then commit() it. With sync_always, commit() uses group
+ * commit: the first waiting writer becomes the leader and writes + fdatasyncs the buffered records of
+ * every writer that arrived in the meantime, the others just wait for it.
+ */
+class WAL {
+    public:
+        fs::path wal_path;
+        SyncPolicy sync_policy;
+        size_t sync_interval_ms;
+        size_t num_syncs; // Number of fdatasync calls so far, lets tests check that commits were grouped
+
+        WAL(const fs::path& wal_path, const SyncPolicy& sync_policy, const size_t& sync_interval_ms);
+        ~WAL();
+
+        // Buffer a record and return its sequence number
+        uint64_t append(const int64_t& key, const int64_t& value);
+        uint64_t append(const pair<int64_t, int64_t>* KVs, const size_t& count);
+        uint64_t append_range_delete(const int64_t& key1, const int64_t& key2);
+        // Block until the record is as durable as the sync policy promises
+        void commit(const uint64_t& seq);
+        // Write and fdatasync everything appended so far
+        void sync();
+        // Start a new segment for a new memtable. The caller must prevent concurrent appends
+        void roll();
+        // The oldest memtable is in an SST now, delete its segment
+        void release_oldest();
+        // All memtables are in SSTs (on closeDB), delete every segment
+        void release_all();
+
+        // Segments left over by a previous run of the database, oldest first
+        static vector<fs::path> find_segments(const fs::path& wal_path);
+        // Call apply on the KV-pairs of every valid record of a segment in log order; stops at the first torn record.
+        // The last argument tells a range delete, whose pair is the range
+        static size_t replay(const fs::path& segment_path,
+                             const function<void(const pair<int64_t, int64_t>*, const size_t&, const bool&)>& apply);
+
+    private:
+        deque<uint64_t> segments; // Numbers of the live segments, oldest first. The last one is being written
+        int fd;
+
+        mutex wal_mutex;
+        condition_variable written_cv; // Signals the writers waiting for a leader to write their records
+        vector<char> pending;          // Records appended but not written to the file yet
+        uint64_t appended_seq;         // Sequence number of the last appended record
+        uint64_t written_seq;          // Records up to this one are written (and synced, if the policy says so)
+        bool writing;                  // A leader is writing, with the lock released
+        bool unsynced;                 // Some written records have not been fdatasync'ed yet
+
+        // Background sync for sync_interval
+        thread sync_thread;
+        condition_variable sync_cv;
+        bool stop_sync;
+
+        static uint64_t checksum(const pair<int64_t, int64_t>* KVs, const size_t& count);
+        uint64_t append(const WALRecordHeader& header, const pair<int64_t, int64_t>* KVs, const size_t& count);
+        fs::path segment_path(const uint64_t& number);
+        void open_segment(const uint64_t& number);
+        void write_pending(unique_lock<mutex>& lock, const bool& sync);
+        void sync_worker();
+};
@@ -0,0 +1,46 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include "constants.h"
+using namespace std;
+
+/*
+ * A group of puts and deletes applied together by Database::write().
+ * The batch is logged as one WAL record and inserted into a single memtable, so readers and
+ * crash recovery see either all of it or none of it (as long as it fits in a memtable).
+ */
+class WriteBatch {
+    public:
+        vector<pair<int64_t, int64_t>> entries;
+
+        inline void put(const int64_t& key, const int64_t& value) {
+            entries.emplace_back(key, value);
+        }
+
+        inline void del(const int64_t& key) {
+            entries.emplace_back(key, constants::TOMBSTONE);
+        }
+
+        inline size_t size() {
+            return entries.size();
+        }
+
+        inline void clear() {
+            entries.clear();
+        }
+
+        // Sort the entries by key. When a key was written several times, only its last write is kept
+        void sort() {
+            stable_sort(entries.begin(), entries.end(), [](const pair<int64_t, int64_t>& a, const pair<int64_t, int64_t>& b) {
+                return a.first < b.first;
+            });
+            // Keep the last entry of each run of equal keys
+            size_t len = 0;
+            for (size_t i = 0; i < entries.size(); ++i) {
+                if (i + 1 < entries.size() && entries[i + 1].first == entries[i].first) continue;
+                entries[len++] = entries[i];
+            }
+            entries.resize(len);
+        }
+};
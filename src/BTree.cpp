@@ -1,11 +1,15 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include "BTree.h"
 #include "bloomFilter.h"
 #include "LSMTree.h"
+#include "pageSearch.h"
 
 /* Insert non-leaf elements into their node in the corresponding level
  * Non-leaf Node Structure: |...keys...|...offsets....|# of keys|
  */
-void BTree::insertHelper(const int64_t& key, const int32_t current_level, const int32_t& max_size) {
+void BTree::insertHelper(const int64_t& key, const int32_t current_level, const int64_t& max_size) {
     // If first time access the level, create it
     if (current_level >= (int32_t)non_leaf_nodes.size()) {
         non_leaf_nodes.emplace_back(vector<BTreeNonLeafNode>());
@@ -14,9 +18,9 @@ void BTree::insertHelper(const int64_t& key, const int32_t current_level, const
     }
 
     // Get the offset in the node
-    int offset = counters[current_level] % constants::KEYS_PER_NODE;
+    int offset = counters[current_level] % constants::NON_LEAF_KEYS;
     // During a B-Tree split, we split the big node into half-and-half
-    const int split_offset = (constants::KEYS_PER_NODE + 1) / 2;
+    const int split_offset = (constants::NON_LEAF_KEYS + 1) / 2;
 
     if (offset == split_offset && counters[current_level] < max_size - 1) {
         // Push the middle point to the next level
@@ -49,7 +53,7 @@ void BTree::print_B_Tree(aligned_KV_vector& sorted_KV) {
         cout << endl;
     }
 
-    for (int i = 0; i < sorted_KV.size(); ++i) {
+    for (size_t i = 0; i < sorted_KV.size(); ++i) {
         auto kv = sorted_KV.data[i];
         cout << "{" << kv.first << "} ";
         if ((i+1) % constants::KEYS_PER_NODE == 0) cout << "     ";
@@ -58,24 +62,24 @@ void BTree::print_B_Tree(aligned_KV_vector& sorted_KV) {
 }
 
 // Since we leave the ptrs empty in insertHelper(), we now need to fill up all the pointers(offsets) in the B-Tree
-void BTree::insertFixUp(const int32_t& sorted_KV_size) {
+void BTree::insertFixUp(const int64_t& sorted_KV_size) {
     // Change ptrs to independent file offsets
-    int32_t off = sorted_KV_size * constants::PAIR_SIZE;
+    int64_t off = sorted_KV_size * constants::PAIR_SIZE;
     for (int32_t level_index = (int32_t)non_leaf_nodes.size() - 1; level_index >= 0; --level_index) {
         vector<BTreeNonLeafNode>& level = non_leaf_nodes[level_index];
-        int32_t next_size;
+        int64_t next_size;
         // Calculate # of nodes in next level
         if (level_index >= 1) {
-            next_size = (int32_t)non_leaf_nodes[level_index - 1].size();
+            next_size = (int64_t)non_leaf_nodes[level_index - 1].size();
         } else {
-            next_size = (int32_t)sorted_KV_size / constants::KEYS_PER_NODE;
+            next_size = sorted_KV_size / constants::KEYS_PER_NODE;
         }
 
-        off += (int32_t)level.size() * (int32_t)sizeof(BTreeNonLeafNode);
-        int32_t per_level_counter = 0;
+        off += (int64_t)level.size() * (int64_t)sizeof(BTreeNonLeafNode);
+        int64_t per_level_counter = 0;
         for (BTreeNonLeafNode& node : level) {
             for (int32_t ptr_index = 0; ptr_index <= node.size; ++ptr_index) {
-                int32_t& offset = node.ptrs[ptr_index];
+                int64_t& offset = node.ptrs[ptr_index];
                 // If offset exceeds bound, set to -1
                 if (per_level_counter >= next_size) {
                     offset = -1;
@@ -85,7 +89,7 @@ void BTree::insertFixUp(const int32_t& sorted_KV_size) {
                         offset = per_level_counter * constants::KEYS_PER_NODE * constants::PAIR_SIZE;
                     } else {
                         // Otherwise, just use BTreeNonLeafNode size
-                        offset = per_level_counter * (int32_t)sizeof(BTreeNonLeafNode) + off;
+                        offset = per_level_counter * (int64_t)sizeof(BTreeNonLeafNode) + off;
                     }
                 }
                 ++per_level_counter;
@@ -94,55 +98,27 @@ void BTree::insertFixUp(const int32_t& sorted_KV_size) {
     }
 }
 
-// Given a SST file and a key, search in B-Tree non-leaf nodes to find the offset of the leaf
-// The search is performed page-by-page from Buffer Pool
-const int32_t BTree::search_BTree_non_leaf_nodes(LSMTree& lsmtree, const int& fd, const fs::path& file_path, const int64_t& key
-                                                                        , const size_t& file_end, const size_t& non_leaf_start) {
-    int64_t offset = non_leaf_start;
-    BTreeNonLeafNode* curNode;
-    char* tmp;
-
-    // If by any chance the SST only has one page, then it will just be a sorted array without any root
-    #ifdef ASSERT
-        assert(file_end >= non_leaf_start);
-    #endif
+/* Descend the B-Tree non-leaf nodes with plain reads: compactions run without the LSM-Tree lock,
+ * so they can use neither the buffer pool nor the fence pointers the LSM-Tree caches.
+ * Return: the offset of the leaf page holding the first key >= key (the last page if every key is smaller)
+ */
+int64_t BTree::find_leaf_page(const int& fd, const int64_t& key, const size_t& file_end, const size_t& non_leaf_start) {
+    // An SST of a single page has no root
     if (file_end == non_leaf_start) {
         return 0;
     }
 
-    // Traverse B-Tree non-leaf nodes
+    BTreeNonLeafNode curNode;
+    int64_t offset = non_leaf_start;
     while (offset >= (int64_t)non_leaf_start) {
-        // Read corresponding node from storage/buffer pool
-        lsmtree.read(file_path.c_str(), fd, tmp, offset, false, false);
-        curNode = (BTreeNonLeafNode*)tmp;
-        #ifdef ASSERT
-            assert(curNode->size != 0);
-        #endif
-
-        // Binary search
-        int low = 0;
-        int high = curNode->size - 1;
-        int mid;
-        while (low < high) {
-            mid = (low + high) / 2;
-            if (curNode->keys[mid] < key) {
-                low = mid + 1;
-            } else {
-                high = mid;
-            }
-        }
-
-        if (curNode->keys[low] < key) {
-            offset = curNode->ptrs[curNode->size];
-        } else {
-            offset = curNode->ptrs[low];
-        }
+        int nbytes = pread(fd, (char*)&curNode, sizeof(BTreeNonLeafNode), offset);
         #ifdef ASSERT
-            assert(offset < (int64_t)file_end);
+            assert(nbytes == (int)sizeof(BTreeNonLeafNode) && curNode.size != 0);
         #endif
 
+        // The first child whose last key is >= key, or the last child
+        offset = curNode.ptrs[PageSearch::non_leaf_lower_bound(curNode, key)];
     }
-
     return offset;
 }
 
@@ -161,28 +137,83 @@ void BTree::write_non_leaf_nodes_to_storage(const int& fd, int64_t& offset) {
     }
 }
 
+/* Gather the keys of all the non-leaf nodes of an SST, read at once: every leaf page but the last sends its last key
+ * to exactly one of them. Return: the fences of the SST in key order, none if it is a single page
+ */
+vector<int64_t> BTree::read_fences(const fs::path& file_path, const SSTFooter& footer) {
+    vector<int64_t> fences;
+    if (footer.index_end == footer.leaf_end) return fences;
+    vector<BTreeNonLeafNode> nodes((footer.index_end - footer.leaf_end) / sizeof(BTreeNonLeafNode));
+    int fd = open(file_path.c_str(), O_RDONLY);
+    #ifdef ASSERT
+        assert(fd != -1);
+    #endif
+    ssize_t nbytes = pread(fd, (char*)nodes.data(), nodes.size() * sizeof(BTreeNonLeafNode), footer.leaf_end);
+    #ifdef ASSERT
+        assert(nbytes == (ssize_t)(nodes.size() * sizeof(BTreeNonLeafNode)));
+    #endif
+    close(fd);
+
+    fences.reserve(footer.leaf_end / constants::PAGE_SIZE - 1);
+    for (const BTreeNonLeafNode& node : nodes) {
+        fences.insert(fences.end(), node.keys, node.keys + node.size);
+    }
+    // Each level of the B-Tree is in key order, but a key went up to the level its node split at
+    sort(fences.begin(), fences.end());
+    #ifdef ASSERT
+        assert(fences.size() == (size_t)(footer.leaf_end / constants::PAGE_SIZE - 1));
+    #endif
+    return fences;
+}
+
+// Write the footer of an SST, which ends the file: |....leaves....|root|...non-leaf nodes...|footer|
+void BTree::write_footer(const int& fd, const SSTFooter& footer) {
+    int nbytes = pwrite(fd, (char*)&footer, sizeof(SSTFooter), footer.index_end);
+    #ifdef ASSERT
+        assert(nbytes == (int)sizeof(SSTFooter));
+    #endif
+}
+
+// Read the footer of an SST, the last page of its file
+SSTFooter BTree::read_footer(const fs::path& file_path) {
+    SSTFooter footer;
+    int fd = open(file_path.c_str(), O_RDONLY);
+    #ifdef ASSERT
+        assert(fd != -1);
+    #endif
+    struct stat file_stat;
+    fstat(fd, &file_stat);
+    int nbytes = pread(fd, (char*)&footer, sizeof(SSTFooter), file_stat.st_size - sizeof(SSTFooter));
+    #ifdef ASSERT
+        assert(nbytes == (int)sizeof(SSTFooter) && footer.magic == constants::SST_FOOTER_MAGIC);
+        assert(footer.index_end + (int64_t)sizeof(SSTFooter) == file_stat.st_size);
+    #endif
+    close(fd);
+    return footer;
+}
+
 /* Convert a sorted KV array into a B-Tree
  * The sorted KV array itself is served as the leaf level
  * While iterating the KV array, we also set the Bloom Filter at the same time
  * B-Tree structure: |....sorted_KV (as leaf)....|root|..next level..|...next level...|
  * Return: offset to the end of leaf level
  */
-int32_t BTree::convertToBTree(aligned_KV_vector& sorted_KV, BloomFilter& bloom_filter) {
-    int32_t padding = 0;
+int64_t BTree::convertToBTree(aligned_KV_vector& sorted_KV, BloomFilter& bloom_filter) {
+    int64_t padding = 0;
     int32_t current_level = 0;
 
     // We pad repeated last element to form a complete leaf node
-    if ((int32_t)sorted_KV.size() % constants::KEYS_PER_NODE != 0) {
+    if (sorted_KV.size() % constants::KEYS_PER_NODE != 0) {
         padding = sorted_KV.add_padding();
     }
 
     // We need to send the last element in each leaf node into higher levels, except the last one
-    int32_t bound = (int32_t)sorted_KV.size() - 1;
+    int64_t bound = (int64_t)sorted_KV.size() - 1;
     // This stores the total number of keys in all non-leaf nodes
-    int32_t max_non_leaf = sorted_KV.size() / constants::KEYS_PER_NODE - 1;
+    int64_t max_non_leaf = sorted_KV.size() / constants::KEYS_PER_NODE - 1;
 
     // Iterate each leaf element to find all non-leaf elements
-    for (int32_t count = 0; count < bound - padding; ++count) {
+    for (int64_t count = 0; count < bound - padding; ++count) {
         // Insert bits in Bloom Filter
         bloom_filter.set(sorted_KV.data[count].first);
         // These are all elements in non-leaf nodes
@@ -192,7 +223,7 @@ int32_t BTree::convertToBTree(aligned_KV_vector& sorted_KV, BloomFilter& bloom_f
     }
     // Iterating padded elements
     // We iterate paddings separately because we do not need to set the Bloom Filter for them
-    for (int32_t count = bound - padding; count < bound; ++count) {
+    for (int64_t count = bound - padding; count < bound; ++count) {
         // These are all elements in non-leaf nodes
         if (count % constants::KEYS_PER_NODE == constants::KEYS_PER_NODE - 1) {
             insertHelper(sorted_KV.data[count].first, current_level, max_non_leaf);
@@ -212,14 +243,14 @@ int32_t BTree::convertToBTree(aligned_KV_vector& sorted_KV, BloomFilter& bloom_f
     #endif
 
     // file offset to the end of the leaf nodes
-    return sorted_KV.size() * constants::PAIR_SIZE;
+    return (int64_t)sorted_KV.size() * constants::PAIR_SIZE;
 }
 
 /* If we do not have a complete sorted KV array but we only know which keys are in the non-leaf nodes,
  * such as during LSM-Tree compaction, we can use these non-leaf keys to build up our BTree.
  * total_count: total number of entries on the leaves
  */
-void BTree::convertToBtree(const vector<int64_t>& non_leaf_keys, const int32_t& total_count) {
+void BTree::convertToBtree(const vector<int64_t>& non_leaf_keys, const int64_t& total_count) {
     int32_t current_level = 0;
     for (size_t i = 0; i < non_leaf_keys.size() - 1; ++i) {
         // Fill the non_leaf_keys into one of the non-leaf levels
@@ -2,7 +2,13 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include "LSMTree.h"
+#include "pageSearch.h"
 #include "BTree.h"
+#include "SSTBuilder.h"
+#include "leafReader.h"
+#include "loserTree.h"
+#include "filterReader.h"
+#include <memory>
 #include <map>
 #include <list>
 #include <fstream>
@@ -13,398 +19,1162 @@
 #include <sstream>
 #include <cerrno>
 #include <cstring>
+#include <numeric>
 using namespace std;
 
-/* Search matching key in SSTs in the order of youngest to oldest */
-const int64_t* LSMTree::get(const int64_t& key, const bool& use_btree) {
-    // Iterate to read each file in descending order (new->old)
-    for (int i = 0; i < (int)num_levels; ++i) {
-        #ifdef ASSERT
-            assert(levels[i].sorted_dir.size() < constants::LSMT_SIZE_RATIO);
-        #endif
-        for (auto file_path_itr = levels[i].sorted_dir.rbegin(); file_path_itr != levels[i].sorted_dir.rend(); ++file_path_itr) {
-            #ifdef DEBUG
-                cout << "Searching in file: " << *file_path_itr << "..." << endl;
-            #endif
-
-            // Skip if Bloom Filter returns negative
-            if (!check_bloomFilter(filter_path / (*file_path_itr), key, levels[i])) {
-                #ifdef DEBUG
-                    cout << "Bloom Filter returned false from: " << *file_path_itr << endl;
-                #endif
+/*  Search matching key in SSTs in the order of youngest to oldest.
+    On a partitioned level, only the SST whose key range holds the key is searched.
+    The SSTs are taken from the levels at once, under lsmt_mutex, and searched without it */
+const int64_t* LSMTree::get(const int64_t& key, const SearchMode& mode) {
+    vector<shared_ptr<SSTHandle>> candidates; // Newest first
+    {
+        lock_guard<mutex> lock(lsmt_mutex);
+        for (int i = 0; i < (int)num_levels; ++i) {
+            Level& level = levels[i];
+            if (partitioned(i)) {
+                size_t candidate = level.find_SST(key);
+                if (candidate < level.sorted_dir.size() && level.key_ranges[candidate].first <= key) {
+                    candidates.emplace_back(handle(level.sorted_dir[candidate]));
+                }
                 continue;
             }
-
-            #ifdef DEBUG
-                cout << "Bloom Filter returned true from: " << *file_path_itr << endl;
-            #endif
-
-            // Get end of leaf offset
-            size_t file_end = fs::file_size(sst_path / *file_path_itr);
-            size_t non_leaf_start;
-            parse_SST_offset(*file_path_itr, non_leaf_start);
-            const int64_t* value = search_SST(sst_path / (*file_path_itr), key, file_end, non_leaf_start, use_btree);
-            if (value != nullptr && *value == constants::TOMBSTONE){
-                delete value;
-                return nullptr;
+            for (auto file_path_itr = level.sorted_dir.rbegin(); file_path_itr != level.sorted_dir.rend(); ++file_path_itr) {
+                candidates.emplace_back(handle(*file_path_itr));
             }
-            if (value != nullptr) return value;
-            #ifdef DEBUG
-                cout << "Not found key: " << key << " in file: " << *file_path_itr << endl;
-            #endif
         }
     }
+    bool found = false;
+    // Iterate to read each file in descending order (new->old)
+    for (const shared_ptr<SSTHandle>& sst_handle : candidates) {
+        const int64_t* value = get_from_SST(*sst_handle, key, lookup_mode(mode), found);
+        if (found) return value;
+    }
     return nullptr;
 }
 
-/*  Function to add new SST to the lsmtree */
-void LSMTree::add_SST(const string& file_name) {
-    levels[0].sorted_dir.emplace_back(file_name);
+/*  Search the key in one SST, behind its Bloom Filter. found tells whether the SST holds the key (or deletes it with
+    a range tombstone), in which case the search is over: the value is returned, or nullptr if the key was deleted */
+const int64_t* LSMTree::get_from_SST(SSTHandle& sst_handle, const int64_t& key, const SearchMode& mode, bool& found) {
+    #ifdef DEBUG
+        const fs::path& file_name = sst_handle.sst_file;
+        cout << "Searching in file: " << file_name << "..." << endl;
+    #endif
 
-    // At this point, the largest level is the first level and we compact it into one-large SST
-    // when the size is less than or equal to SIZE_RATIO
-    if (levels[0].last_level && levels[0].cur_size > 1 && levels[0].cur_size <= constants::LSMT_SIZE_RATIO) {
-        merge_down_helper(levels.begin(), levels.begin(), levels[0].sorted_dir.size(), true, true);
+    // Skip if Bloom Filter returns negative. A key the SST does not hold may still be deleted by one of its ranges
+    const SSTMeta& sst = sst_handle.meta();
+    if (!check_bloomFilter(sst_handle.filter_file, sst, key)) {
+        #ifdef DEBUG
+            cout << "Bloom Filter returned false from: " << file_name << endl;
+        #endif
+        found = sst.range_tombstones.covers(key);
+        return nullptr;
     }
 
-    // If the size of first level reaches the size ratio, we need to compact it
-    if (levels[0].cur_size == constants::LSMT_SIZE_RATIO) {
-        merge_down(levels.begin());
+    #ifdef DEBUG
+        cout << "Bloom Filter returned true from: " << file_name << endl;
+    #endif
 
-        #ifdef ASSERT
-            // At this stage, the compaction is finished, so all intermediate SSTs have been deleted.
-            // Thus, all SSTs now are BTrees and they all have Bloom Filters
-            for (size_t i = 0; i < num_levels; ++i) {
-                Level level = levels[i];
-                for (fs::path& file_name : level.sorted_dir) {
-                    assert(fs::exists(sst_path / file_name));
-                    assert(fs::exists(filter_path / file_name));
-                    size_t which_level;
-                    parse_SST_level(file_name, which_level);
-                    assert(which_level == level.level);
-                }
-                if (!level.last_level) assert(level.cur_size == level.sorted_dir.size());
-            }
-            // Check Dostoevsky, where the last level needs to have only one big SST
-            assert(levels[num_levels-1].last_level);
-            assert(levels[num_levels-1].sorted_dir.size() == 1);
-        #endif
+    const int64_t* value = search_SST(sst_handle.sst_file, key, sst, mode);
+    // The pairs of an SST are newer than its ranges
+    found = (value != nullptr) || sst.range_tombstones.covers(key);
+    if (value != nullptr && *value == constants::TOMBSTONE){
+        delete value;
+        return nullptr;
     }
+    #ifdef DEBUG
+        if (value == nullptr) cout << "Not found key: " << key << " in file: " << file_name << endl;
+    #endif
+    return value;
+}
+
+/*  Function to add new SST to the lsmtree.
+    The SST is visible to readers right away; compactions it triggers run in the background.
+    If level 0 has accumulated too much compaction debt, block until the compaction thread catches up */
+void LSMTree::add_SST(const string& file_name) {
+    unique_lock<mutex> lock(lsmt_mutex);
+    levels[0].sorted_dir.emplace_back(file_name);
+    levels[0].run_units.emplace_back(1);
+    ++levels[0].cur_size;
+    schedule_compactions();
+    write_manifest(lock);
+
     #ifdef DEBUG
         print_lsmt();
     #endif
 
-    // If the lsmtree reaches the maximum level, we allocate one more level for it
-    if (num_levels == max_levels) {
-        levels.emplace_back(Level(num_levels));
-        ++max_levels;
+    // Write stall: this blocks the flush thread, which in turn makes puts stall once the immutable memtables pile up
+    stall_cv.wait(lock, [this] { return level_debt(0) <= l0_stall_limit || stop_compaction_flag; });
+}
+
+/*  Compaction debt of a level: how many compactions it owes before it is back in shape.
+    A level is full once it holds size_ratio units, and then owes the compaction that moves it down; it may also
+    hold up to max_runs runs, and owes one merge for every run beyond that.
+    A partitioned level owes one compaction per SST it holds beyond its capacity, the size of one of its runs
+    without partitions */
+size_t LSMTree::level_debt(const size_t& level) {
+    Level& cur_level = levels[level];
+    if (partitioned(level)) {
+        size_t capacity = calculate_sst_size(level);
+        if (cur_level.num_pairs <= capacity) return 0;
+        return (cur_level.num_pairs - capacity + partition_size - 1) / partition_size;
     }
+    size_t num_runs = cur_level.sorted_dir.size();
+    size_t allowed_runs = max_runs(level, num_levels);
+    size_t debt = (num_runs > allowed_runs) ? num_runs - allowed_runs : 0;
+    if (cur_level.cur_size >= size_ratio) debt = max(debt, (size_t)1);
+    return debt;
 }
 
-/* Function to compact the current level of LSMTree */
-void LSMTree::merge_down(const vector<Level>::iterator& cur_level) {
-    vector<Level>::iterator next_level;
-    next_level = cur_level + 1;
+/*  Runs a level may hold under the merge policy, when the tree has total_levels levels.
+    With partitioned levels, level 0 is tiered and the levels below are one run each */
+size_t LSMTree::max_runs(const size_t& level, const size_t& total_levels) {
+    if (partition_size > 0) return (level == 0) ? runs_per_level : 1;
+    if (merge_policy == leveling) return 1;
+    if (merge_policy == lazy_leveling && level + 1 == total_levels) return 1;
+    return runs_per_level;
+}
 
-    // If cur level is the largest level of LSMTree, and the size reachse the size ratio
-    // We can simple create a new level, and move the SSTs from cur level to the new level
-    if (cur_level->last_level && cur_level->cur_size == constants::LSMT_SIZE_RATIO) {
-        largest_level_move_down(cur_level);
-        return;
-    }
-    
-    // We build up the BTree only after the last compaction
-    bool last_compaction = false;
-    if (next_level->cur_size + 1 < constants::LSMT_SIZE_RATIO) {
-        last_compaction = true;
+/* Bits per entry of the Bloom Filter of an SST on the level, when the tree has total_levels levels (Monkey) */
+float LSMTree::bits_per_entry(const size_t& level, const size_t& total_levels) {
+    return BloomFilter::calculate_num_bits_per_entry(level, total_levels, size_ratio, max_runs(level, total_levels), bloom_fpr);
+}
+
+/*  Queue a compaction job for every level that owes one (and is not already queued).
+    Caller must hold lsmt_mutex */
+void LSMTree::schedule_compactions() {
+    for (size_t i = 0; i < num_levels; ++i) {
+        if ((level_debt(i) > 0 || dense_SST(i) < levels[i].sorted_dir.size())
+            && find(compaction_queue.begin(), compaction_queue.end(), i) == compaction_queue.end()) {
+            compaction_queue.push_back(i);
+        }
     }
+    if (!compaction_queue.empty()) compaction_cv.notify_one();
+}
 
-    // Call helper function to perform the actual compaction
-    merge_down_helper(cur_level, next_level, cur_level->cur_size, last_compaction, cur_level->last_level);
+/* Start the background compaction thread, and catch up on any debt found when the DB was opened */
+void LSMTree::start_compaction() {
+    lock_guard<mutex> lock(lsmt_mutex);
+    stop_compaction_flag = false;
+    compaction_thread = thread(&LSMTree::compaction_worker, this);
+    schedule_compactions();
+}
 
-    // check if the next_level is largest level, if so compact into one large SST if the cur_size <= LSMT_SIZE_RATIO
-    if (next_level->last_level && next_level->cur_size > 1 && next_level->cur_size <= constants::LSMT_SIZE_RATIO) {
-        merge_down_helper(next_level, next_level, next_level->sorted_dir.size(), true, true);
+/* Stop the background compaction thread once all queued (and follow-up) jobs are done */
+void LSMTree::stop_compaction() {
+    {
+        lock_guard<mutex> lock(lsmt_mutex);
+        stop_compaction_flag = true;
     }
+    compaction_cv.notify_all();
+    stall_cv.notify_all();
+    if (compaction_thread.joinable()) compaction_thread.join();
+}
 
-    // If the next level also need compaction, we can recursively call this function
-    if (next_level->cur_size == constants::LSMT_SIZE_RATIO) {
-        merge_down(next_level);
+/* Background thread that runs the queued compaction jobs one at a time */
+void LSMTree::compaction_worker() {
+    unique_lock<mutex> lock(lsmt_mutex);
+    while (true) {
+        compaction_cv.wait(lock, [this] { return stop_compaction_flag || !compaction_queue.empty(); });
+        // When asked to stop, we still drain the queue so the DB is closed in a compacted state
+        if (compaction_queue.empty()) return;
+        size_t level = compaction_queue.front();
+        compaction_queue.pop_front();
+
+        compacting = true;
+        compacting_level = level;
+        compact_level(level, lock);
+        compacting = false;
+
+        // A compaction may push the next level over its limit
+        schedule_compactions();
+        stall_cv.notify_all();
+        #ifdef ASSERT
+            check_levels();
+        #endif
+        #ifdef DEBUG
+            print_lsmt();
+        #endif
     }
 }
 
-/*  Helper function to create a new level as largest level, then move SSTs from cur level to the new level. 
-    At this point, cur_level is the last_level and cur_size is full */
-void LSMTree::largest_level_move_down(const vector<Level>::iterator& cur_level) {
-    string new_filename = cur_level->sorted_dir[0].c_str();
-    vector<Level>::iterator next_level = cur_level + 1;
+/*  Pay off the debt of one level. The merge itself runs without holding lsmt_mutex: the inputs are immutable
+    and only this thread removes SSTs, so readers keep using them until the output is installed.
+    A full level sends its oldest runs that add up to a full run down to the next level: a single run is just moved,
+    several runs are merged into one. Otherwise, the newest runs beyond max_runs - 1 are merged into one run.
+    A level that owes nothing may still hold an SST with too many tombstones */
+void LSMTree::compact_level(const size_t& level, unique_lock<mutex>& lock) {
+    if (level_debt(level) == 0) {
+        size_t dense = dense_SST(level);
+        if (dense < levels[level].sorted_dir.size()) compact_tombstones(level, dense, lock);
+        return;
+    }
+    if (partition_size > 0) {
+        compact_partition(level, lock);
+        return;
+    }
+    size_t total_levels = num_levels;
+    size_t num_runs = levels[level].sorted_dir.size();
+    if (num_runs == 0) return;
+
+    size_t num_full = 0; // Oldest runs that make up a full run of the next level
+    size_t full_units = 0;
+    while (num_full < num_runs && full_units < size_ratio) {
+        full_units += levels[level].run_units[num_full++];
+    }
 
-    // Rename the prefix of the file to indicate the new level
-    new_filename[0] = '0' + next_level->level;
-    next_level->sorted_dir.emplace_back(new_filename);
-    rename((sst_path / cur_level->sorted_dir[0]).c_str(), (sst_path / new_filename).c_str());
-    rename((filter_path / cur_level->sorted_dir[0]).c_str(), (filter_path / new_filename).c_str());
+    if (full_units >= size_ratio) {
+        if (num_full == 1) {
+            move_run_down(level, lock);
+            return;
+        }
+        // A new last level has nothing older below it
+        bool new_level = (level + 1 == total_levels);
+        if (level + 1 >= levels.size()) {
+            levels.emplace_back(Level(levels.size()));
+            ++max_levels;
+        }
+        vector<fs::path> inputs(levels[level].sorted_dir.begin(), levels[level].sorted_dir.begin() + num_full);
+        int64_t min_key, max_key;
+        key_range(inputs, min_key, max_key);
+        vector<fs::path> older = older_SSTs(level + 1, levels[level + 1].sorted_dir.size(), min_key, max_key);
+
+        lock.unlock();
+        vector<string> outputs = merge_SSTs(inputs, level + 1, max(total_levels, level + 2), older);
+        lock.lock();
+
+        // New runs may have been appended meanwhile, they are newer and stay on the level
+        Level& cur_level = levels[level];
+        cur_level.sorted_dir.erase(cur_level.sorted_dir.begin(), cur_level.sorted_dir.begin() + num_full);
+        cur_level.run_units.erase(cur_level.run_units.begin(), cur_level.run_units.begin() + num_full);
+        cur_level.cur_size -= full_units;
+        if (!outputs.empty()) {
+            Level& next_level = levels[level + 1];
+            next_level.sorted_dir.emplace_back(outputs[0]);
+            next_level.run_units.emplace_back(1);
+            ++next_level.cur_size;
+            if (new_level) {
+                cur_level.last_level = false;
+                next_level.last_level = true;
+                ++num_levels;
+            }
+        }
+        remove_SSTs(inputs, lock);
+        return;
+    }
 
-    ++next_level->cur_size;
-    next_level->last_level = true;
-    cur_level->cur_size = 0;
-    cur_level->sorted_dir.clear();
-    cur_level->last_level = false;
-    ++num_levels;
+    size_t allowed_runs = max_runs(level, total_levels);
+    if (num_runs <= allowed_runs) return;
+    // The level is not full, so neither is the merged run. The runs left behind are older
+    size_t first = allowed_runs - 1;
+    vector<fs::path> inputs(levels[level].sorted_dir.begin() + first, levels[level].sorted_dir.end());
+    size_t merged_units = 0;
+    for (size_t i = first; i < num_runs; ++i) {
+        merged_units += levels[level].run_units[i];
+    }
+    int64_t min_key, max_key;
+    key_range(inputs, min_key, max_key);
+    vector<fs::path> older = older_SSTs(level, first, min_key, max_key);
+
+    lock.unlock();
+    vector<string> outputs = merge_SSTs(inputs, level, total_levels, older);
+    lock.lock();
+
+    Level& cur_level = levels[level];
+    cur_level.sorted_dir.erase(cur_level.sorted_dir.begin() + first, cur_level.sorted_dir.begin() + first + inputs.size());
+    cur_level.run_units.erase(cur_level.run_units.begin() + first, cur_level.run_units.begin() + first + inputs.size());
+    if (!outputs.empty()) {
+        cur_level.sorted_dir.insert(cur_level.sorted_dir.begin() + first, outputs[0]);
+        cur_level.run_units.insert(cur_level.run_units.begin() + first, merged_units);
+    } else { // If by any chance the merged runs are empty
+        cur_level.cur_size -= merged_units;
+    }
+    remove_SSTs(inputs, lock);
 }
 
-/* Helper function to perform the actual compaction algorithm, compact SSTs in current level and move to next level */
-void LSMTree::merge_down_helper(const vector<Level>::iterator& cur_level, const vector<Level>::iterator& next_level, const int& num_sst, 
-                                const bool& last_compaction, const bool& largest_level) {
-    vector<size_t> leaf_ends(num_sst, -1);
-    vector<BTreeLeafNode> leafNodes(num_sst);
-    vector<pair<int, int>> fds(num_sst); // pair<fd, ret> from open and pread
+/*  Partitioned levels: merge part of a level with the SSTs it overlaps on the next level, which are replaced by
+    the output, cut into SSTs of partition_size pairs. The runs of level 0 overlap each other, so level 0 goes down
+    as a whole; any other level gives the SST that follows the last one it gave, which bounds the work of one
+    compaction by about SIZE_RATIO + 1 SSTs. If the next level is the last one, tombstones are dropped.
+    When the next level has nothing in the key range of the inputs, and they do not overlap each other (as with
+    time-ordered keys), they are moved down as they are (trivial move), without reading or writing any page.
+    A tombstone compaction gives the dense SST instead, which is always merged so as to drop what it can */
+void LSMTree::compact_partition(const size_t& level, unique_lock<mutex>& lock, const size_t& dense) {
+    bool tombstone_compaction = (dense != numeric_limits<size_t>::max());
+    if (!tombstone_compaction && level_debt(level) == 0) return;
+    // The level below the last one only appears when the first SSTs are installed on it
+    if (level + 1 >= levels.size()) {
+        levels.emplace_back(Level(levels.size()));
+        ++max_levels;
+    }
+    Level& cur_level = levels[level];
+    Level& next_level = levels[level + 1];
+
+    vector<fs::path> upper; // Inputs from this level, oldest first
+    int64_t min_key, max_key;
+    bool disjoint = true;   // The inputs from this level do not overlap each other
+    if (level == 0) {
+        upper = cur_level.sorted_dir;
+        vector<pair<int64_t, int64_t>> ranges;
+        for (const fs::path& file_name : upper) {
+            ranges.emplace_back(meta(file_name).min_key, meta(file_name).max_key);
+        }
+        sort(ranges.begin(), ranges.end());
+        min_key = ranges.front().first;
+        max_key = ranges.front().second;
+        for (size_t i = 1; i < ranges.size(); ++i) {
+            if (ranges[i].first <= max_key) disjoint = false;
+            max_key = max(max_key, ranges[i].second);
+        }
+    } else if (tombstone_compaction) {
+        upper.emplace_back(cur_level.sorted_dir[dense]);
+        min_key = cur_level.key_ranges[dense].first;
+        max_key = cur_level.key_ranges[dense].second;
+    } else {
+        size_t pick = upper_bound(cur_level.key_ranges.begin(), cur_level.key_ranges.end(), cur_level.compact_cursor,
+                                  [](const int64_t& key, const pair<int64_t, int64_t>& range) { return key < range.first; })
+                      - cur_level.key_ranges.begin();
+        if (pick == cur_level.sorted_dir.size()) pick = 0;
+        upper.emplace_back(cur_level.sorted_dir[pick]);
+        min_key = cur_level.key_ranges[pick].first;
+        max_key = cur_level.key_ranges[pick].second;
+        cur_level.compact_cursor = max_key;
+    }
+    // The SSTs of the next level are older, they come first
+    size_t first_overlap = next_level.find_SST(min_key);
+    size_t end_overlap = first_overlap;
+    while (end_overlap < next_level.sorted_dir.size() && next_level.key_ranges[end_overlap].first <= max_key) {
+        ++end_overlap;
+    }
+    vector<fs::path> inputs;
+    vector<string> outputs; // Replace the overlapped SSTs of the next level
+    if (disjoint && first_overlap == end_overlap && !tombstone_compaction) {
+        // Only the levels change, the MANIFEST records the move
+        outputs.assign(upper.begin(), upper.end());
+    } else {
+        inputs.assign(next_level.sorted_dir.begin() + first_overlap, next_level.sorted_dir.begin() + end_overlap);
+        inputs.insert(inputs.end(), upper.begin(), upper.end());
+        vector<fs::path> older = older_SSTs(level + 2, 0, min_key, max_key);
+        size_t total_levels = max((size_t)num_levels, level + 2);
+
+        lock.unlock();
+        outputs = merge_SSTs(inputs, level + 1, total_levels, older, partition_size);
+        lock.lock();
+    }
 
-    for (int i = 0; i < num_sst; ++i) {
-        parse_SST_offset(cur_level->sorted_dir[i], leaf_ends[i]);
-        fds[i].first = open((sst_path / cur_level->sorted_dir[i]).c_str(), O_RDONLY | O_SYNC | O_DIRECT, 0777);
-        #ifdef ASSERT
-            assert(fds[i].first != -1);
-        #endif
-        fds[i].second = pread(fds[i].first, (char*)&leafNodes[i], constants::PAGE_SIZE, 0);
-        #ifdef ASSERT
-            assert(fds[i].second == (int)(constants::PAGE_SIZE));
-        #endif
+    // Only this thread changes the levels below level 0, and flushes only append newer runs to level 0
+    if (level == 0) {
+        cur_level.sorted_dir.erase(cur_level.sorted_dir.begin(), cur_level.sorted_dir.begin() + upper.size());
+        cur_level.run_units.erase(cur_level.run_units.begin(), cur_level.run_units.begin() + upper.size());
+        cur_level.cur_size -= upper.size();
+    } else {
+        cur_level.sorted_dir.erase(find(cur_level.sorted_dir.begin(), cur_level.sorted_dir.end(), upper[0]));
+        index_level(level);
     }
+    next_level.sorted_dir.erase(next_level.sorted_dir.begin() + first_overlap, next_level.sorted_dir.begin() + end_overlap);
+    next_level.sorted_dir.insert(next_level.sorted_dir.end(), outputs.begin(), outputs.end());
+    index_level(level + 1);
+    if (level + 1 == num_levels && !next_level.sorted_dir.empty()) {
+        cur_level.last_level = false;
+        next_level.last_level = true;
+        ++num_levels;
+    }
+    remove_SSTs(inputs, lock);
+}
 
-    // loop over kv pairs, if encounters two same key, only the more recent version is kept
-    // Output buffer that stores the KV-pairs
-    aligned_KV_vector output_buffer(constants::KEYS_PER_NODE);
-    // Bloom Filter for the SST
-    BloomFilter bloom_filter(calculate_sst_size(*next_level), next_level->level, num_levels);
-    size_t total_count = 0; // Couts the total num of elements inserted so far
-    int64_t SST_offset = 0;
-    // Whenever the buffer is full, write to this file
-    #ifdef ASSERT
-        assert(!fs::exists(sst_path / "temp.bytes"));
-    #endif
-    string temp_name = sst_path / "temp.bytes";
-    int fd = open(temp_name.c_str(), O_WRONLY | O_CREAT | O_SYNC | O_DIRECT, 0777);
-    #ifdef ASSERT
-        assert(fd != -1);
-    #endif
+/*  Compact a level that owes nothing, but holds an SST (the dense one) with too many tombstones, so that they reach
+    the last level, where they go with the pairs they delete, without waiting for the level to fill up:
+    - With partitioned levels, the SST (all of level 0) is merged into the next level, or rewritten without its
+      tombstones if it is on the last level.
+    - Otherwise, all the runs of the level are merged into one run of the next level, or into one run without
+      tombstones if it is the last level.
+    On the way, the merges drop the tombstones that the Bloom Filters below prove to delete nothing */
+void LSMTree::compact_tombstones(const size_t& level, const size_t& dense, unique_lock<mutex>& lock) {
+    size_t total_levels = num_levels;
+    bool last = (level + 1 == total_levels);
+    if (partition_size > 0 && !(last && partitioned(level))) {
+        compact_partition(level, lock, dense);
+        return;
+    }
+    vector<fs::path> inputs;
+    if (partition_size > 0) {
+        inputs.emplace_back(levels[level].sorted_dir[dense]);
+    } else {
+        inputs = levels[level].sorted_dir;
+    }
+    size_t output_level = last ? level : level + 1;
+    if (output_level >= levels.size()) {
+        levels.emplace_back(Level(levels.size()));
+        ++max_levels;
+    }
+    int64_t min_key, max_key;
+    key_range(inputs, min_key, max_key);
+    vector<fs::path> older = older_SSTs(level + 1, levels[output_level].sorted_dir.size(), min_key, max_key);
+
+    lock.unlock();
+    vector<string> outputs = merge_SSTs(inputs, output_level, total_levels, older, partition_size);
+    lock.lock();
+
+    Level& cur_level = levels[level];
+    if (partition_size > 0) {
+        cur_level.sorted_dir.erase(find(cur_level.sorted_dir.begin(), cur_level.sorted_dir.end(), inputs[0]));
+        cur_level.sorted_dir.insert(cur_level.sorted_dir.end(), outputs.begin(), outputs.end());
+        index_level(level);
+        remove_SSTs(inputs, lock);
+        return;
+    }
+    // New runs may have been appended to level 0 meanwhile, they are newer and stay on the level
+    size_t merged_units = accumulate(cur_level.run_units.begin(), cur_level.run_units.begin() + inputs.size(), (size_t)0);
+    cur_level.sorted_dir.erase(cur_level.sorted_dir.begin(), cur_level.sorted_dir.begin() + inputs.size());
+    cur_level.run_units.erase(cur_level.run_units.begin(), cur_level.run_units.begin() + inputs.size());
+    cur_level.cur_size -= merged_units;
+    if (!outputs.empty()) {
+        // The runs of the level above the last one go down as one unit, like a full run would
+        size_t units = last ? merged_units : 1;
+        Level& output = levels[output_level];
+        if (last) {
+            output.sorted_dir.insert(output.sorted_dir.begin(), outputs[0]);
+            output.run_units.insert(output.run_units.begin(), units);
+        } else {
+            output.sorted_dir.emplace_back(outputs[0]);
+            output.run_units.emplace_back(units);
+        }
+        output.cur_size += units;
+    }
+    remove_SSTs(inputs, lock);
+}
+
+/*  Index of the SST of the level with the largest share of tombstones, if that share exceeds tombstone_ratio,
+    otherwise the number of SSTs of the level. Caller must hold lsmt_mutex */
+size_t LSMTree::dense_SST(const size_t& level) {
+    Level& cur_level = levels[level];
+    size_t dense = cur_level.sorted_dir.size();
+    if (tombstone_ratio >= 1) return dense;
+    double max_ratio = tombstone_ratio;
+    for (size_t i = 0; i < cur_level.sorted_dir.size(); ++i) {
+        const SSTMeta& sst = meta(cur_level.sorted_dir[i]);
+        double ratio = (double)sst.num_tombstones / (sst.leaf_end / constants::PAIR_SIZE);
+        if (ratio > max_ratio) {
+            max_ratio = ratio;
+            dense = i;
+        }
+    }
+    return dense;
+}
 
-    // Initializes a priority queue (min-heap) of size 0, that stores HeapNode
-    priority_queue<HeapNode, vector<HeapNode>, decltype(comp)> minHeap(comp);
-    vector<int> pages_read(num_sst, 1);
-    vector<int> indices(num_sst, 0);
+/*  The handle of an SST of the levels, created the first time the SST is read. Caller must hold lsmt_mutex */
+shared_ptr<SSTHandle> LSMTree::handle(const fs::path& file_name) {
+    shared_ptr<SSTHandle>& entry = SST_handles[file_name.string()];
+    if (!entry) entry = make_shared<SSTHandle>(sst_path / file_name, filter_path / file_name, sst_index);
+    return entry;
+}
 
-    // B-tree variables
-    vector<int64_t> non_leaf_keys; // Stores all the keys in all B-Tree non-leaf nodes
-    // Try to predict required memory using fan-out = KEYS_PER_NODE
-    if (last_compaction) non_leaf_keys.reserve(calculate_sst_size(*next_level) / constants::KEYS_PER_NODE);
-    pair<int64_t, int64_t> last_kv = {-1, -1}; // This records the last key in the leaf
+/* Metadata of an SST of the levels, kept until the SST is removed. Caller must hold lsmt_mutex */
+const SSTMeta& LSMTree::meta(const fs::path& file_name) {
+    return handle(file_name)->meta();
+}
 
-    // Initialize the heap with the first element of each SSTs
-    for (int i = 0; i < num_sst; ++i) {
-        if (indices[i] < constants::KEYS_PER_NODE) {
-            minHeap.push({leafNodes[i].data[indices[i]], i});
-            ++indices[i];
+/*  Metadata of the SST, read once from its footer, its non-leaf nodes (for its fence pointers or its learned index) and
+    the header of its Bloom Filter (with the range tombstones that follow the bitmap). Threads that need it meanwhile
+    wait for it */
+const SSTMeta& SSTHandle::meta() {
+    call_once(loaded, [this] {
+        SSTFooter footer = BTree::read_footer(sst_file);
+        loaded_meta.num_entries = footer.num_entries;
+        loaded_meta.min_key = footer.min_key;
+        loaded_meta.max_key = footer.max_key;
+        loaded_meta.leaf_end = footer.leaf_end;
+        loaded_meta.index_end = footer.index_end;
+        loaded_meta.filter_num_cache_lines = footer.filter_num_cache_lines;
+        loaded_meta.filter_num_of_hashes = footer.filter_num_of_hashes;
+        if (index == search_btree) {
+            loaded_meta.fences = BTree::read_fences(sst_file, footer);
+        } else if (index == search_learned) {
+            // The fences are only needed to fit the model
+            loaded_meta.learned_index.build(BTree::read_fences(sst_file, footer));
         }
-    }
+        loaded_meta.num_tombstones = BloomFilter::read_header(filter_file, &loaded_meta.range_tombstones).num_tombstones;
+    });
+    return loaded_meta;
+}
 
+SSTHandle::~SSTHandle() {
+    if (!obsolete) return;
+    bool remove_result = fs::remove(sst_file);
     #ifdef ASSERT
-        assert(!minHeap.empty());
+        assert(remove_result);
     #endif
-    // Get the minimum key in the SST, for generating SST file name
-    int64_t min_key = constants::TOMBSTONE;
-    if (last_compaction) min_key = minHeap.top().data.first;
-
-    pair<bool,int64_t> found_tombstone; // Variables for tombstone check: (is_tombstone, key_tombstone)
-    found_tombstone.first = false;
-
-    while (!minHeap.empty()) {
-        HeapNode node = minHeap.top();
-        minHeap.pop();
-        // If detect TOMBSTONE, reject any pairs with the same key until a new key appears
-        if (largest_level && node.data.second == constants::TOMBSTONE){
-            found_tombstone.first = true;
-            found_tombstone.second = node.data.first;
-        }
-        if (largest_level && found_tombstone.second != node.data.first){
-            found_tombstone.first = false;
-        }
-        if (!found_tombstone.first){
-            // Add to result if it's the first element or a non-duplicate
-            if ((total_count == 0) || // If it is the first element we ever inserted
-                // Compare current node with the last element in the flushed buffer
-                (output_buffer.size() == 0 && last_kv.first != node.data.first) ||
-                // Compare current node with the last element in the current buffer
-                (output_buffer.size() != 0 && output_buffer.back().first != node.data.first)){
-                output_buffer.emplace_back(node.data);
-                ++total_count;
-                if (last_compaction)
-                    bloom_filter.set(node.data.first);
-                if (last_compaction && total_count % constants::KEYS_PER_NODE == 0) {
-                    // This is an element in one of the non-leaf nodes in the B-Tree
-                    non_leaf_keys.emplace_back(output_buffer.back().first);
-                }
-                if (output_buffer.isFull()) {
-                    last_kv = output_buffer.flush_to_file(fd, SST_offset);
-                }
-                #ifdef DEBUG
-                    cout << "insert: key {" << node.data.first << "," << node.data.second << "} to output buffer" << endl;
-                #endif
+    fs::remove(filter_file);
+}
+
+size_t LSMTree::num_tombstones(const fs::path& file_name) {
+    lock_guard<mutex> lock(lsmt_mutex);
+    return meta(file_name).num_tombstones;
+}
+
+SSTMeta LSMTree::SST_meta(const fs::path& file_name) {
+    lock_guard<mutex> lock(lsmt_mutex);
+    return meta(file_name);
+}
+
+/*  The SSTs older than the inputs of a compaction that may hold keys in [min_key, max_key]: the num_runs oldest runs
+    of level (all of it if it is partitioned), and the SSTs of every level below. A tombstone of the inputs whose key
+    none of them holds deletes nothing anymore. Caller must hold lsmt_mutex */
+vector<fs::path> LSMTree::older_SSTs(const size_t& level, const size_t& num_runs, const int64_t& min_key, const int64_t& max_key) {
+    vector<fs::path> older;
+    for (size_t i = level; i < num_levels; ++i) {
+        Level& cur_level = levels[i];
+        if (partitioned(i)) {
+            for (size_t j = cur_level.find_SST(min_key); j < cur_level.sorted_dir.size() && cur_level.key_ranges[j].first <= max_key; ++j) {
+                older.emplace_back(cur_level.sorted_dir[j]);
             }
+            continue;
         }
-        int index = node.arrayIndex;
-        if (indices[index] < constants::KEYS_PER_NODE) {
-            minHeap.push({leafNodes[index].data[indices[index]], index});
-            ++indices[index];
+        size_t end = (i == level) ? num_runs : cur_level.sorted_dir.size();
+        for (size_t j = 0; j < end; ++j) {
+            const SSTMeta& sst = meta(cur_level.sorted_dir[j]);
+            if (sst.min_key <= max_key && min_key <= sst.max_key) older.emplace_back(cur_level.sorted_dir[j]);
         }
+    }
+    return older;
+}
 
-        if ((indices[index] * constants::PAIR_SIZE) >= fds[index].second && 
-            (pages_read[index] * constants::PAGE_SIZE) < leaf_ends[index]) { // read next page
-            fds[index].second = pread(fds[index].first, (char*)&leafNodes[index], constants::PAGE_SIZE, 
-                                      pages_read[index] * constants::PAGE_SIZE);
-            #ifdef ASSERT
-                assert(fds[index].second == (int)(constants::PAGE_SIZE));
-            #endif
-            ++pages_read[index];
-            indices[index] = 0;
-        } else if ((pages_read[index] * constants::PAGE_SIZE) >= leaf_ends[index]) { // End of leaves
-            fds[index].second = 0;
+/* The smallest min key and the largest max key of the SSTs */
+void LSMTree::key_range(const vector<fs::path>& file_names, int64_t& min_key, int64_t& max_key) {
+    min_key = numeric_limits<int64_t>::max();
+    max_key = numeric_limits<int64_t>::min();
+    for (const fs::path& file_name : file_names) {
+        min_key = min(min_key, meta(file_name).min_key);
+        max_key = max(max_key, meta(file_name).max_key);
+    }
+}
+
+/*  Order the SSTs of a partitioned level by key, and index their key ranges and their pairs.
+    Called whenever the SSTs of the level change, with lsmt_mutex held (or while the DB is opened) */
+void LSMTree::index_level(const size_t& level) {
+    if (!partitioned(level)) return;
+    Level& cur_level = levels[level];
+    vector<pair<pair<int64_t, int64_t>, fs::path>> ssts;
+    cur_level.num_pairs = 0;
+    for (const fs::path& file_name : cur_level.sorted_dir) {
+        const SSTMeta& sst = meta(file_name);
+        ssts.push_back({{sst.min_key, sst.max_key}, file_name});
+        cur_level.num_pairs += sst.leaf_end / constants::PAIR_SIZE;
+    }
+    sort(ssts.begin(), ssts.end());
+    cur_level.sorted_dir.clear();
+    cur_level.key_ranges.clear();
+    for (const pair<pair<int64_t, int64_t>, fs::path>& sst : ssts) {
+        cur_level.key_ranges.emplace_back(sst.first);
+        cur_level.sorted_dir.emplace_back(sst.second);
+    }
+    cur_level.cur_size = cur_level.sorted_dir.size();
+}
+
+/*  Move the oldest run of a level, which is full, down as the newest run of the next level (a new last level
+    if the level was the last one). Newer runs stay behind. Caller must hold lsmt_mutex (see write_manifest()) */
+void LSMTree::move_run_down(const size_t& level, unique_lock<mutex>& lock) {
+    // If the lsmtree reaches the maximum level, we allocate one more level for it
+    if (level + 1 >= levels.size()) {
+        levels.emplace_back(Level(levels.size()));
+        ++max_levels;
+    }
+    Level& cur_level = levels[level];
+    Level& next_level = levels[level + 1];
+    next_level.sorted_dir.emplace_back(cur_level.sorted_dir[0]);
+    next_level.run_units.emplace_back(1);
+    ++next_level.cur_size;
+
+    cur_level.cur_size -= cur_level.run_units[0];
+    cur_level.sorted_dir.erase(cur_level.sorted_dir.begin());
+    cur_level.run_units.erase(cur_level.run_units.begin());
+    if (level + 1 == num_levels) {
+        cur_level.last_level = false;
+        next_level.last_level = true;
+        ++num_levels;
+    }
+    write_manifest(lock);
+}
+
+/* Whether the key range of any run on the level intersects [min_key, max_key] */
+bool LSMTree::overlaps(const Level& level, const int64_t& min_key, const int64_t& max_key) {
+    for (const fs::path& file_name : level.sorted_dir) {
+        const SSTMeta& sst = meta(file_name);
+        if (sst.min_key <= max_key && min_key <= sst.max_key) return true;
+    }
+    return false;
+}
+
+/* Whether every key in the tree is smaller than key, so that pairs with greater keys can go below all of it */
+bool LSMTree::keys_below(const int64_t& key) {
+    lock_guard<mutex> lock(lsmt_mutex);
+    for (size_t i = 0; i < num_levels; ++i) {
+        Level& level = levels[i];
+        if (partitioned(i)) {
+            if (!level.key_ranges.empty() && level.key_ranges.back().second >= key) return false;
+            continue;
         }
+        if (overlaps(level, key, numeric_limits<int64_t>::max())) return false;
+    }
+    return true;
+}
+
+/* The smallest level on which count pairs make a run that does not yet have to move down */
+size_t LSMTree::ingest_level(const size_t& count) {
+    size_t level = 0;
+    while (level + 1 < max_levels && count > calculate_sst_size(level, size_ratio - 1)) {
+        ++level;
     }
+    return level;
+}
 
-    // Get the maximum key in the SST, for generating SST file name
-    int64_t max_key = constants::TOMBSTONE;
-    if (last_compaction) {
-        if (output_buffer.size() > 0) max_key = output_buffer.back().first;
-        else max_key = last_kv.first;
+/*  The level an SST with keys in [min_key, max_key] and count pairs is placed on by ingest_SST(), and whether it
+    becomes the new last level. Caller must hold lsmt_mutex */
+size_t LSMTree::ingest_placement(const int64_t& min_key, const int64_t& max_key, const size_t& count, bool& new_last_level) {
+    int overlap_free = -1; // Deepest level such that it and all the levels above do not overlap
+    while (overlap_free + 1 < (int)num_levels && !overlaps(levels[overlap_free + 1], min_key, max_key)) {
+        ++overlap_free;
     }
 
-    // We pad repeated last element to form a complete 4kb node
-    if (total_count % constants::KEYS_PER_NODE != 0) {
-        int padding = output_buffer.add_padding();
-        total_count += padding;
-        #ifdef ASSERT
-            assert(output_buffer.isFull());
-        #endif
-        if (last_compaction) non_leaf_keys.emplace_back(output_buffer.back().first);
-        output_buffer.flush_to_file(fd, SST_offset);
+    size_t level = 0;
+    new_last_level = false;
+    if (partition_size > 0) {
+        // Partitioned levels: the SST becomes one more SST of the deepest level it overlaps nothing down to
+        level = max(overlap_free, 0);
+        if (overlap_free == (int)num_levels - 1 && num_levels == 1) {
+            level = 1;
+            new_last_level = true;
+        }
+    } else if (overlap_free == (int)num_levels - 1) {
+        size_t natural_level = ingest_level(count);
+        if (levels[num_levels - 1].sorted_dir.empty() && natural_level + 1 >= num_levels) { // Empty last level
+            level = natural_level;
+            new_last_level = true;
+        } else if (natural_level >= num_levels || num_levels == 1) {
+            level = max(natural_level, (size_t)num_levels);
+            new_last_level = true;
+        } else {
+            level = num_levels - 2;
+        }
+    } else if (overlap_free >= 0) {
+        level = overlap_free;
     }
+    return level;
+}
 
-    // Build up the B-Tree if it is the last compaction
-    int64_t leaf_end = total_count*constants::PAIR_SIZE;
-    if (last_compaction && non_leaf_keys.size() != 0) {
-        BTree btree;
-        // Build-up the non-leaf nodes
-        btree.convertToBtree(non_leaf_keys, total_count);
+/*  Place an SST built outside the tree (bulk ingestion) as a new run, as deep as possible without rewriting it.
+    Its pairs are newer than everything in the tree, so it may only go below runs it does not overlap:
+    - If nothing overlaps, it becomes the new last level when it is at least as large as the last level could be,
+      (the old last level turns into a regular level); otherwise it joins the deepest non-last level.
+    - Otherwise, it joins the deepest level such that neither that level nor any level above it overlaps,
+      or level 0, as its newest run.
+    - With partitioned levels, it joins that same level, as one more SST of a partitioned level. If nothing overlaps,
+      it is chained onto the last level, which becomes level 1 if it was level 0 (that one is not partitioned).
+    The memtables must not overlap the SST. Return: the level the SST was placed on */
+size_t LSMTree::ingest_SST(const string& file_name, const size_t& count) {
+    unique_lock<mutex> lock(lsmt_mutex);
+    int64_t min_key = meta(file_name).min_key, max_key = meta(file_name).max_key;
+    size_t level;
+    bool new_last_level;
+    // Queued compactions pick their inputs once they run, after the SST is placed. The running one keeps its inputs
+    // until it installs its outputs, which only cover their key ranges, so the placement holds: only wait for it if the
+    // SST goes on one of its levels (where outputs are installed by position), changes the last level while it may
+    // change it too, or needs a new Level (it holds references into levels)
+    while (true) {
+        level = ingest_placement(min_key, max_key, count, new_last_level);
+        size_t first_changed = new_last_level ? min(level, (size_t)num_levels - 1) : level;
+        bool conflict = level >= levels.size() || (compacting_level <= level && first_changed <= compacting_level + 1);
+        if (!compacting || !conflict) break;
+        stall_cv.wait(lock);
+    }
 
-        // Write non-leaf levels to file, starting from root
-        int64_t offset = leaf_end;
-        btree.write_non_leaf_nodes_to_storage(fd, offset);
+    size_t units = 1;
+    if (new_last_level) {
+        while (level >= levels.size()) {
+            levels.emplace_back(Level(levels.size()));
+            ++max_levels;
+        }
+        Level& old_last_level = levels[num_levels - 1];
+        if (old_last_level.level != level) {
+            old_last_level.last_level = false;
+        }
+        levels[level].last_level = true;
+        // The run counts for how many runs of the level above it is worth
+        size_t unit_size = calculate_sst_size(level);
+        units = (count + unit_size - 1) / unit_size;
+        num_levels = level + 1;
     }
+    // Otherwise the run counts as one unit
+    levels[level].sorted_dir.emplace_back(file_name);
+    if (!partitioned(level)) {
+        levels[level].run_units.emplace_back(units);
+        levels[level].cur_size += units;
+    }
+    index_level(level);
+    schedule_compactions();
+    write_manifest(lock);
 
-    int result = close(fd);
     #ifdef ASSERT
-        assert(result != -1);
+        check_levels();
     #endif
-
-    string output_filename = generate_filename(next_level->level, min_key, max_key, leaf_end);
-    result = rename(temp_name.c_str(), (sst_path / output_filename).c_str());
-    #ifdef ASSERT
-        assert(result == 0);
+    #ifdef DEBUG
+        print_lsmt();
     #endif
-    // Write bloom filter to storage
-    if (last_compaction && total_count != 0)
-        bloom_filter.writeToStorage(filter_path / output_filename);
+    return level;
+}
 
-    // Compaction finished. Close and Remove all files on current level
-    for (int i = 0; i < num_sst; ++i) {
-        int result = close(fds[i].first);
-        #ifdef ASSERT
-            assert(result != -1);
-        #endif
-        bool remove_result = remove(sst_path / cur_level->sorted_dir[i]);
+/*  Remove compacted SSTs and their Bloom Filters from storage, once their outputs are installed, or once the lookups
+    still reading them are done (see SSTHandle). The MANIFEST records the new version first, so it never lists a removed
+    SST. Caller must hold lsmt_mutex (see write_manifest()) */
+void LSMTree::remove_SSTs(const vector<fs::path>& file_names, unique_lock<mutex>& lock) {
+    write_manifest(lock);
+    for (const fs::path& file_name : file_names) {
+        auto cached = SST_handles.find(file_name.string());
+        if (cached != SST_handles.end()) {
+            cached->second->obsolete = true;
+            SST_handles.erase(cached);
+            continue;
+        }
+        // Never read, so no lookup holds it
+        bool remove_result = remove(sst_path / file_name);
         #ifdef ASSERT
             assert(remove_result);
         #endif
-        // Note: This may return false, which is by purpose, because we only build 
-        // up the bloom filter for the last compaction
-        remove(filter_path / cur_level->sorted_dir[i]);
-    }
-
-    // Add to the maintained directory list
-    if (largest_level && total_count != 0) {
-        cur_level->sorted_dir.clear();
-        cur_level->sorted_dir.emplace_back(output_filename);
-    } else if (total_count == 0) { // If by any change the compacted level is empty
-        cur_level->cur_size = 0;
-        cur_level->sorted_dir.clear();
-        remove((sst_path / output_filename).c_str());
-    } else {
-        cur_level->cur_size = 0;
-        cur_level->sorted_dir.clear();
-        ++next_level->cur_size;
-        next_level->sorted_dir.emplace_back(output_filename);
+        remove(filter_path / file_name);
     }
 }
 
-/*  To parse SST filename: <LSMTree_level>_<time><clock>_<min_key>_<max_key>_<leaf_end>.bytes
-    Get min_key, max_key and leaf-end offset (end of leaf nodes & start of non-leaf nodes) from a SST file's name */
-void LSMTree::parse_SST_name(const string& file_name, int64_t& min_key, int64_t& max_key, size_t& leaf_end) {
-    size_t first = file_name.find('_');
-    size_t second = file_name.find('_', first + 1);
-    size_t third = file_name.find('_', second + 1);
-    size_t last = file_name.find_last_of('_');
+/*  Record the current version of the levels in the MANIFEST: every SST of every level, with the units of its run.
+    Called whenever the levels change, after their new SSTs are complete. The record is built under lsmt_mutex, which
+    is released while it is synced so that lookups go on meanwhile, and held again on return */
+void LSMTree::write_manifest(unique_lock<mutex>& lock) {
+    if (!manifest) return;
+    vector<ManifestFile> files;
+    for (size_t i = 0; i < num_levels; ++i) {
+        Level& level = levels[i];
+        for (size_t j = 0; j < level.sorted_dir.size(); ++j) {
+            files.push_back({i, partitioned(i) ? 1 : level.run_units[j], stoull(level.sorted_dir[j].stem().string())});
+        }
+    }
+    vector<char> record = manifest->record(next_file_number, num_levels, files);
+    lock.unlock();
+    manifest->write(record);
+    lock.lock();
+}
 
-    min_key = strtoll(file_name.substr(second + 1, third - second - 1).c_str(), nullptr, 10);
-    max_key = strtoll(file_name.substr(third + 1, last - third - 1).c_str(), nullptr, 10);
-    parse_SST_offset(file_name, leaf_end);
+/*  Open the MANIFEST of the database, and restore the levels of its last version: the SSTs of every level in order,
+    and the units of the runs (such as the big contiguous run of the last level in Dostoevsky, without which we
+    could not tell whether a level is full). Nothing else is read until an SST is searched.
+    Return: false if there is no version yet, a new database */
+bool LSMTree::restore_levels() {
+    manifest.reset(new Manifest(constants::DATA_FOLDER + db_name + "/MANIFEST"));
+    ManifestRecordHeader header;
+    vector<ManifestFile> files;
+    if (!manifest->load(header, files)) return false;
+
+    lock_guard<mutex> lock(lsmt_mutex);
+    while (levels.size() < header.num_levels) {
+        levels.emplace_back(Level(levels.size()));
+        ++max_levels;
+    }
+    uint64_t max_file_number = 0;
+    for (const ManifestFile& file : files) {
+        Level& level = levels[file.level];
+        level.sorted_dir.emplace_back(to_string(file.file_number) + ".bytes");
+        level.run_units.push_back(file.units);
+        level.cur_size += file.units;
+        max_file_number = max(max_file_number, file.file_number);
+    }
+    levels[0].last_level = false;
+    levels[header.num_levels - 1].last_level = true;
+    num_levels = header.num_levels;
+    next_file_number = max(header.next_file_number, max_file_number + 1);
+    for (size_t level = 1; level < num_levels; ++level) {
+        if (partitioned(level)) levels[level].run_units.clear();
+        index_level(level);
+    }
+    return true;
+}
 
-    #ifdef ASSERT
-        assert(min_key < max_key);
-    #endif
+/*  Remove the SSTs and the filters that the last version does not list: those a crashed run was still writing
+    (temp<number>.bytes), or had written or compacted away without the MANIFEST listing them (<number>.bytes, at or
+    above next_file_number or missing from the last version). Their pairs are still in the WAL, or in the SSTs that
+    replaced them. Only names this format creates are removed, openDB checks there is nothing else first.
+    Called when the DB is opened after a crash */
+void LSMTree::remove_orphans() {
+    lock_guard<mutex> lock(lsmt_mutex);
+    set<string> live;
+    for (size_t i = 0; i < num_levels; ++i) {
+        for (const fs::path& file_name : levels[i].sorted_dir) {
+            live.insert(file_name.string());
+        }
+    }
+    for (const fs::path& dir : {sst_path, filter_path}) {
+        for (auto& file_path : fs::directory_iterator(dir)) {
+            string file_name = file_path.path().filename().string();
+            uint64_t file_number;
+            bool orphan = (dir == sst_path && temp_SST_name(file_name))
+                          || (parse_SST_name(file_name, file_number) && (file_number >= next_file_number || live.count(file_name) == 0));
+            if (orphan) fs::remove(file_path.path());
+        }
+    }
 }
 
-/* To parse SST filename, get only the leaf offset from a SST file's name */
-void LSMTree::parse_SST_offset(const string& file_name, size_t& leaf_end) {
-    size_t start_pos = file_name.find_last_of("_");
-    size_t end_pos = file_name.find('.', start_pos);
-    leaf_end = stoi(file_name.substr(start_pos + 1, end_pos - start_pos - 1));
+fs::path LSMTree::unrecognised_file(const fs::path& sst_path, const fs::path& filter_path) {
+    for (const fs::path& dir : {sst_path, filter_path}) {
+        for (auto& file_path : fs::directory_iterator(dir)) {
+            string file_name = file_path.path().filename().string();
+            uint64_t file_number;
+            if (!parse_SST_name(file_name, file_number) && !(dir == sst_path && temp_SST_name(file_name))) return file_path.path();
+        }
+    }
+    return fs::path();
 }
 
-/* To parse SST filename, get only the level from a SST file's name */
-void LSMTree::parse_SST_level(const string& file_name, size_t& level) {
-    size_t first = file_name.find('_');
-    level = stoi(file_name.substr(0, first));
+/* Whether the file name is <number>.bytes, the name of an SST and of its Bloom Filter (see new_SST_name()) */
+bool LSMTree::parse_SST_name(const string& file_name, uint64_t& file_number) {
+    const string extension = ".bytes";
+    if (file_name.size() <= extension.size() || file_name.compare(file_name.size() - extension.size(), extension.size(), extension) != 0) {
+        return false;
+    }
+    string number = file_name.substr(0, file_name.size() - extension.size());
+    if (number.size() > 19 || !all_of(number.begin(), number.end(), [](const char& c) { return c >= '0' && c <= '9'; })) {
+        return false;
+    }
+    file_number = stoull(number);
+    return true;
 }
 
-/* Function to perform BTree search on SST */
-const int64_t* LSMTree::search_SST_BTree(int& fd, const fs::path& file_path, const int64_t& key,
-                                         const size_t& file_end, const size_t& non_leaf_start) {
-    // Search BTree non-leaf nodes to find the offset of leaf
-    const int32_t offset = BTree::search_BTree_non_leaf_nodes(*this, fd, file_path, key, file_end, non_leaf_start);
-    if (offset < 0) return nullptr;
-    // Binary search in the leaf node
-    BTreeLeafNode* leafNode;
-    char* tmp;
-    read(file_path.c_str(), fd, tmp, offset, false, true);
-    leafNode = (BTreeLeafNode*)tmp;
+/* Whether the file name is temp<number>.bytes, an SST under construction (see SSTBuilder::new_temp_path()) */
+bool LSMTree::temp_SST_name(const string& file_name) {
+    uint64_t temp_number;
+    return file_name.compare(0, 4, "temp") == 0 && parse_SST_name(file_name.substr(4), temp_number);
+}
 
-    int low = 0;
-    int high = constants::KEYS_PER_NODE - 1;
-    int mid;
+/*  Perform the actual compaction algorithm: k-way merge the input SSTs (oldest first) into one SST on output_level.
+    If two inputs have the same key, only the more recent version is kept.
+    older_SSTs are the SSTs older than the inputs that may hold their keys. A tombstone is dropped when none of their
+    Bloom Filters has its key: with none (merging into the last level) all of them are, since nothing older remains.
+    Large compactions are split into key ranges (subcompactions) merged in parallel by worker threads, while this
+    thread stitches their outputs, in key order, into the output SST with its B-Tree and Bloom Filter.
+    With max_output_size, the output is cut into SSTs of that many pairs (the last one may be smaller, and one that
+    would end inside a range tombstone goes on to its end).
+    The pairs of an input covered by a range tombstone of a newer input are dropped, and an input whose whole key range
+    is covered that way is not read at all. The range tombstones are merged into the output SSTs that span them, unless
+    no older SST overlaps them anymore.
+    Return: the names of the output SSTs in key order, none if everything was deleted */
+vector<string> LSMTree::merge_SSTs(const vector<fs::path>& all_inputs, const size_t& output_level, const size_t& total_levels,
+                                   const vector<fs::path>& older_SSTs, const size_t& max_output_size) {
+    // This runs without lsmt_mutex, so the footers and the range tombstones are read from the files rather than from
+    // SST_handles
+    vector<RangeTombstones> all_newer_ranges(all_inputs.size());
+    RangeTombstones input_ranges;
+    for (size_t i = all_inputs.size(); i-- > 0;) {
+        all_newer_ranges[i] = input_ranges;
+        RangeTombstones ranges;
+        BloomFilter::read_header(filter_path / all_inputs[i], &ranges);
+        input_ranges.add(ranges);
+    }
+    vector<fs::path> inputs;
+    vector<SSTFooter> footers;
+    vector<RangeTombstones> newer_ranges;
+    for (size_t i = 0; i < all_inputs.size(); ++i) {
+        SSTFooter footer = BTree::read_footer(sst_path / all_inputs[i]);
+        if (all_newer_ranges[i].covers(footer.min_key, footer.max_key)) continue;
+        inputs.emplace_back(all_inputs[i]);
+        footers.emplace_back(footer);
+        newer_ranges.emplace_back(move(all_newer_ranges[i]));
+    }
+    RangeTombstones output_ranges;
+    if (!input_ranges.empty()) {
+        vector<pair<int64_t, int64_t>> older_key_ranges;
+        for (const fs::path& file_name : older_SSTs) {
+            SSTFooter footer = BTree::read_footer(sst_path / file_name);
+            older_key_ranges.emplace_back(footer.min_key, footer.max_key);
+        }
+        for (const pair<int64_t, int64_t>& range : input_ranges.ranges) {
+            for (const pair<int64_t, int64_t>& key_range : older_key_ranges) {
+                if (key_range.first <= range.second && range.first <= key_range.second) {
+                    output_ranges.ranges.emplace_back(range);
+                    break;
+                }
+            }
+        }
+    }
 
-    while (low <= high) {
-        mid = (low + high) / 2;
-        pair<int64_t, int64_t> cur = leafNode->data[mid];
-        if (cur.first == key) {
-            return new int64_t(cur.second);
-        } else if (cur.first > key) {
-            high = mid - 1;
+    size_t output_size = 0; // The output holds at most all the input pairs, its Bloom Filters are sized for them
+    for (const SSTFooter& footer : footers) {
+        output_size += footer.leaf_end / constants::PAIR_SIZE;
+    }
+    vector<string> output_files;
+    unique_ptr<SSTBuilder> builder; // Started on the first pair of each output SST
+    size_t added = 0;
+    size_t next_output_range = 0; // First range tombstone not given to an output SST yet
+    auto finish_builder = [&] {
+        for (; next_output_range < output_ranges.ranges.size() && output_ranges.ranges[next_output_range].first <= builder->max_key;
+             ++next_output_range) {
+            builder->add_range(output_ranges.ranges[next_output_range]);
+        }
+        output_files.emplace_back(builder->finish());
+        builder.reset();
+    };
+    // Only this thread removes SSTs, so the older SSTs stay while we probe their filters
+    vector<unique_ptr<FilterReader>> older_filters;
+    for (const fs::path& file_name : older_SSTs) {
+        older_filters.emplace_back(new FilterReader(filter_path / file_name));
+    }
+
+    // Range r holds the keys in (splits[r - 1], splits[r]]
+    vector<int64_t> splits = subcompaction_splits(inputs, footers, output_size);
+    const size_t num_ranges = splits.size() + 1;
+    const size_t num_workers = min(num_ranges, constants::MAX_SUBCOMPACTIONS);
+    vector<vector<pair<int64_t, int64_t>>> outputs(num_ranges);
+    vector<bool> merged(num_ranges, false);
+    mutex ranges_mutex;
+    condition_variable ranges_cv;
+    size_t next_range = 0; // Next range to hand to a worker
+    size_t stitched = 0;   // Ranges already added to the output SST
+
+    auto worker = [&] {
+        unique_lock<mutex> lock(ranges_mutex);
+        while (true) {
+            // At most num_workers merged ranges wait to be stitched, which bounds the memory they take
+            ranges_cv.wait(lock, [&] { return next_range == num_ranges || next_range < stitched + num_workers; });
+            if (next_range == num_ranges) return;
+            size_t range = next_range++;
+            lock.unlock();
+            int64_t min_key = (range == 0) ? numeric_limits<int64_t>::min() : splits[range - 1] + 1;
+            int64_t max_key = (range == splits.size()) ? numeric_limits<int64_t>::max() : splits[range];
+            merge_range(inputs, footers, min_key, max_key, older_filters, newer_ranges, output_ranges, outputs[range]);
+            lock.lock();
+            merged[range] = true;
+            ranges_cv.notify_all();
+        }
+    };
+
+    vector<thread> workers;
+    if (num_workers == 1) {
+        worker();
+    } else {
+        num_subcompactions += num_ranges;
+        for (size_t i = 0; i < num_workers; ++i) {
+            workers.emplace_back(worker);
+        }
+    }
+
+    for (size_t range = 0; range < num_ranges; ++range) {
+        {
+            unique_lock<mutex> lock(ranges_mutex);
+            ranges_cv.wait(lock, [&] { return merged[range]; });
+        }
+        for (const pair<int64_t, int64_t>& KV : outputs[range]) {
+            if (!builder) {
+                size_t expected_size = (max_output_size > 0) ? min(output_size - added, max_output_size) : output_size;
+                builder.reset(new SSTBuilder(*this, output_level, expected_size, total_levels));
+            }
+            builder->add(KV);
+            ++added;
+            if (max_output_size > 0 && builder->total_count >= max_output_size) {
+                // A range tombstone stays within one SST, which spans it
+                auto range = output_ranges.find(KV.first);
+                if (range == output_ranges.ranges.end() || range->second == KV.first) finish_builder();
+            }
+        }
+        vector<pair<int64_t, int64_t>>().swap(outputs[range]);
+        {
+            unique_lock<mutex> lock(ranges_mutex);
+            ++stitched;
+        }
+        ranges_cv.notify_all();
+    }
+    for (thread& worker_thread : workers) {
+        worker_thread.join();
+    }
+
+    // If by any chance everything has been deleted, there is no output SST
+    if (builder) finish_builder();
+    return output_files;
+}
+
+/*  Split keys that cut the merge of the inputs into key ranges of about subcompaction_size input pairs.
+    They are taken from the root nodes of the inputs: the keys of a root cut its SST into pieces of about equal size.
+    Return: the last key of every range but the last one, in increasing order */
+vector<int64_t> LSMTree::subcompaction_splits(const vector<fs::path>& inputs, const vector<SSTFooter>& footers, const size_t& total_count) {
+    vector<int64_t> splits;
+    size_t num_ranges = total_count / subcompaction_size;
+    if (num_ranges <= 1) return splits;
+
+    vector<pair<int64_t, size_t>> candidates; // Root key, and about how many pairs of its SST come since the previous root key
+    BTreeNonLeafNode root;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        // An SST of a single page has no root
+        if (footers[i].index_end == footers[i].leaf_end) continue;
+        int fd = open((sst_path / inputs[i]).c_str(), O_RDONLY | O_SYNC | O_DIRECT, 0777);
+        #ifdef ASSERT
+            assert(fd != -1);
+        #endif
+        // The root is the first node after the leaves
+        int nbytes = pread(fd, (char*)&root, sizeof(BTreeNonLeafNode), footers[i].leaf_end);
+        #ifdef ASSERT
+            assert(nbytes == (int)sizeof(BTreeNonLeafNode));
+        #endif
+        close(fd);
+        size_t piece_size = footers[i].leaf_end / constants::PAIR_SIZE / (root.size + 1);
+        for (int32_t k = 0; k < root.size; ++k) {
+            candidates.emplace_back(root.keys[k], piece_size);
+        }
+    }
+    sort(candidates.begin(), candidates.end());
+
+    size_t range_size = total_count / num_ranges;
+    size_t count = 0;
+    for (const pair<int64_t, size_t>& candidate : candidates) {
+        count += candidate.second;
+        if (splits.size() + 1 == num_ranges) break;
+        if (count >= range_size * (splits.size() + 1) && (splits.empty() || candidate.first > splits.back())
+            && candidate.first != numeric_limits<int64_t>::max()) {
+            splits.emplace_back(candidate.first);
+        }
+    }
+    return splits;
+}
+
+/*  K-way merge the pairs with keys in [min_key, max_key] of the input SSTs (oldest first) into output, in key order.
+    Only the leaf pages that can hold the range are read, found through the B-Tree of each input, and they are
+    read ahead in chunks of readahead_size. This runs without lsmt_mutex, so it does not use the buffer pool.
+    newer_ranges holds the range tombstones of the inputs newer than each input, and output_ranges those the output
+    keeps: the point tombstones on their ends stay, so the output SSTs span them */
+void LSMTree::merge_range(const vector<fs::path>& inputs, const vector<SSTFooter>& footers, const int64_t& min_key,
+                          const int64_t& max_key, const vector<unique_ptr<FilterReader>>& older_filters,
+                          const vector<RangeTombstones>& newer_ranges, const RangeTombstones& output_ranges,
+                          vector<pair<int64_t, int64_t>>& output) {
+    const int num_sst = inputs.size();
+    vector<unique_ptr<LeafReader>> readers;
+
+    // Sources are the inputs, oldest first, so the newest version of a key wins the tournament
+    LoserTree tournament(num_sst);
+
+    // Enter the first pair of the range of each SST
+    for (int i = 0; i < num_sst; ++i) {
+        size_t start = 0;
+        size_t end = footers[i].leaf_end;
+        if (min_key != numeric_limits<int64_t>::min() || max_key != numeric_limits<int64_t>::max()) {
+            int fd = open((sst_path / inputs[i]).c_str(), O_RDONLY | O_SYNC | O_DIRECT, 0777);
+            #ifdef ASSERT
+                assert(fd != -1);
+            #endif
+            if (min_key != numeric_limits<int64_t>::min()) {
+                start = BTree::find_leaf_page(fd, min_key, footers[i].index_end, footers[i].leaf_end);
+            }
+            if (max_key != numeric_limits<int64_t>::max()) {
+                end = BTree::find_leaf_page(fd, max_key, footers[i].index_end, footers[i].leaf_end) + constants::PAGE_SIZE;
+            }
+            close(fd);
+        }
+        readers.emplace_back(new LeafReader(sst_path / inputs[i], start, end, readahead_size));
+        LeafReader& reader = *readers.back();
+        while (reader.valid() && reader.current().first < min_key) {
+            reader.next();
+        }
+        if (reader.valid() && reader.current().first <= max_key) {
+            tournament.set(i, reader.current());
+        }
+    }
+    tournament.build();
+
+    // A tombstone is kept if an older SST may still hold its key, or if it ends a range tombstone of the output
+    auto shadows_older = [&](const int64_t& key) {
+        auto range = output_ranges.find(key);
+        if (range != output_ranges.ranges.end() && (range->first == key || range->second == key)) return true;
+        for (const unique_ptr<FilterReader>& filter : older_filters) {
+            if (filter->may_contain(key)) return true;
+        }
+        return false;
+    };
+
+    bool has_last = false;
+    int64_t last_key = 0; // Older versions of the last key taken out are skipped
+    while (!tournament.empty()) {
+        const pair<int64_t, int64_t> KV = tournament.top();
+        // The newest version of a key comes out first. A tombstone that deletes nothing older goes, and so do the
+        // versions it shadows. So does a key that a newer input deletes with a range tombstone
+        if (!has_last || KV.first != last_key) {
+            has_last = true;
+            last_key = KV.first;
+            bool range_deleted = newer_ranges[tournament.top_source()].covers(KV.first);
+            if (!range_deleted && (KV.second != constants::TOMBSTONE || shadows_older(KV.first))) {
+                output.emplace_back(KV);
+                #ifdef DEBUG
+                    cout << "insert: key {" << KV.first << "," << KV.second << "} to output buffer" << endl;
+                #endif
+            }
+        }
+
+        LeafReader& reader = *readers[tournament.top_source()];
+        reader.next();
+        if (reader.valid() && reader.current().first <= max_key) {
+            tournament.replace_top(reader.current());
         } else {
-            low = mid + 1;
+            tournament.pop_top();
+        }
+    }
+}
+
+/* Check the invariants of the levels after a compaction, for testing purpose. Caller must hold lsmt_mutex */
+void LSMTree::check_levels() {
+    // All SSTs are BTrees and they all have Bloom Filters
+    for (size_t i = 0; i < num_levels; ++i) {
+        Level& level = levels[i];
+        for (fs::path& file_name : level.sorted_dir) {
+            assert(fs::exists(sst_path / file_name));
+            assert(fs::exists(filter_path / file_name));
+        }
+        if (!partitioned(i)) {
+            assert(level.run_units.size() == level.sorted_dir.size());
+            assert(level.cur_size == accumulate(level.run_units.begin(), level.run_units.end(), (size_t)0));
+        } else {
+            assert(level.cur_size == level.sorted_dir.size() && level.key_ranges.size() == level.sorted_dir.size());
+            for (size_t j = 1; j < level.key_ranges.size(); ++j) {
+                assert(level.key_ranges[j - 1].second < level.key_ranges[j].first);
+            }
         }
     }
+    assert(levels[num_levels-1].last_level);
+}
+
+/* Offset of the leaf page of an SST that may hold key: the first page whose last key is >= key, or the last page.
+   The fence pointers give it right away. The page the learned index predicts is off by a few pages at most,
+   the keys of the pages around it tell which way to go */
+int64_t LSMTree::find_leaf(const int& fd, const fs::path& file_path, const SSTMeta& sst, const int64_t& key, const SearchMode& mode) {
+    if (mode == search_btree) return BTree::leaf_page(sst.fences, key);
+
+    int64_t page = sst.learned_index.predict(key);
+    const int64_t last_page = sst.leaf_end / constants::PAGE_SIZE - 1;
+    BTreeLeafNode leafNode;
+    read(file_path.c_str(), fd, (char*)&leafNode, page * constants::PAGE_SIZE, false, true);
+    // Too far left, the key is past the last key of the page
+    while (page < last_page && leafNode.data[constants::KEYS_PER_NODE - 1].first < key) {
+        ++page;
+        read(file_path.c_str(), fd, (char*)&leafNode, page * constants::PAGE_SIZE, false, true);
+    }
+    // Too far right, the key is not past the last key of the page before
+    while (page > 0 && key < leafNode.data[0].first) {
+        read(file_path.c_str(), fd, (char*)&leafNode, (page - 1) * constants::PAGE_SIZE, false, true);
+        if (leafNode.data[constants::KEYS_PER_NODE - 1].first < key) break;
+        --page;
+    }
+    return page * constants::PAGE_SIZE;
+}
+
+/* Function to perform BTree search on SST, once the fence pointers or the learned index gave the leaf */
+const int64_t* LSMTree::search_SST_leaf(int& fd, const fs::path& file_path, const int64_t& key, const int64_t& offset) {
+    // Search in the leaf node
+    BTreeLeafNode leafNode;
+    read(file_path.c_str(), fd, (char*)&leafNode, offset, false, true);
 
+    size_t index = PageSearch::leaf_lower_bound(leafNode, key);
+    if (index < (size_t)constants::KEYS_PER_NODE && leafNode.data[index].first == key) {
+        return new int64_t(leafNode.data[index].second);
+    }
     return nullptr;
 }
 
@@ -415,24 +1185,22 @@ const int64_t* LSMTree::search_SST_Binary(int& fd, const fs::path& file_path, co
 
     // Variables used in binary search
     pair<int64_t, int64_t> cur;
-    BTreeLeafNode* leafNode = nullptr;
-    int prevPage = -1;
-    int low = 0;
-    int high = num_elements - 1;
-    int mid;
+    BTreeLeafNode leafNode;
+    int64_t prevPage = -1;
+    int64_t low = 0;
+    int64_t high = num_elements - 1;
+    int64_t mid;
 
     // Binary search
     while (low <= high) {
         mid = (low + high) / 2;
         // Do one I/O per page if not in bufferpool
-        int curPage = floor((mid*constants::PAIR_SIZE) / constants::PAGE_SIZE);
+        int64_t curPage = mid / constants::KEYS_PER_NODE;
         if (curPage != prevPage) {
-            char* tmp;
-            read(file_path.c_str(), fd, tmp, (curPage * constants::PAGE_SIZE), false, true);
-            leafNode = (BTreeLeafNode*)tmp;
+            read(file_path.c_str(), fd, (char*)&leafNode, (curPage * constants::PAGE_SIZE), false, true);
             prevPage = curPage;
         }
-        cur = leafNode->data[mid - curPage * constants::KEYS_PER_NODE];
+        cur = leafNode.data[mid - curPage * constants::KEYS_PER_NODE];
 
         if (cur.first == key) {
             return new int64_t(cur.second);
@@ -447,8 +1215,7 @@ const int64_t* LSMTree::search_SST_Binary(int& fd, const fs::path& file_path, co
 }
 
 /* Helper function to search the key in a SST file */
-const int64_t* LSMTree::search_SST(const fs::path& file_path, const int64_t& key, const size_t& file_end,
-                                   const size_t& non_leaf_start, const bool& use_btree) {
+const int64_t* LSMTree::search_SST(const fs::path& file_path, const int64_t& key, const SSTMeta& sst, const SearchMode& mode) {
     const int64_t* result = nullptr;
     // Open the SST file
     int fd = open(file_path.c_str(), O_RDONLY | O_SYNC | O_DIRECT, 0777);
@@ -457,10 +1224,10 @@ const int64_t* LSMTree::search_SST(const fs::path& file_path, const int64_t& key
         assert(fd != -1);
     #endif
 
-    if (use_btree) {
-        result = search_SST_BTree(fd, file_path, key, file_end, non_leaf_start);
+    if (mode == search_binary) {
+        result = search_SST_Binary(fd, file_path, key, sst.index_end, sst.leaf_end);
     } else {
-        result = search_SST_Binary(fd, file_path, key, file_end, non_leaf_start);
+        result = search_SST_leaf(fd, file_path, key, find_leaf(fd, file_path, sst, key, mode));
     }
     
     int close_res = close(fd);
@@ -471,136 +1238,153 @@ const int64_t* LSMTree::search_SST(const fs::path& file_path, const int64_t& key
     return result;
 }
 
-/*  Merge the scanned arrays from two SSTs (stored as two consecutive sorted ranges, separated by first_end in sorted_KV)
-    The final sorted array is stored back in sorted_KV */
-void LSMTree::merge_scan_results(vector<pair<int64_t, int64_t>>*& sorted_KV, const size_t& first_end) {
+/*  Merge the sorted runs scanned from the memtables and the SSTs, stored one after the other in sorted_KV, newest first.
+    run_ends holds the end of each run, and run_ranges its range tombstones. On duplicate keys only the version of the
+    newest run is kept, unless the range tombstones of a newer run cover it. The final sorted array is stored back in sorted_KV */
+void LSMTree::merge_scan_results(vector<pair<int64_t, int64_t>>*& sorted_KV, const vector<size_t>& run_ends,
+                                 const vector<RangeTombstones>& run_ranges) {
+    const size_t num_runs = run_ends.size();
+    if (num_runs <= 1) return;
+
+    // Ranges of the runs newer than each source (run r is source num_runs - 1 - r), nothing to do if there are none
+    vector<RangeTombstones> newer_ranges(num_runs);
+    bool has_ranges = false;
+    for (size_t r = 1; r < num_runs; ++r) {
+        RangeTombstones& ranges = newer_ranges[num_runs - 1 - r];
+        ranges = newer_ranges[num_runs - r];
+        ranges.add(run_ranges[r - 1]);
+        has_ranges = has_ranges || !ranges.empty();
+    }
+
+    // Run r is source num_runs - 1 - r of the tournament, so newer runs have greater indices and win ties
+    LoserTree tournament(num_runs);
+    vector<size_t> next(num_runs); // Next pair of each source
+    vector<size_t> ends(num_runs);
+    for (size_t r = 0; r < num_runs; ++r) {
+        size_t source = num_runs - 1 - r;
+        next[source] = (r == 0) ? 0 : run_ends[r - 1];
+        ends[source] = run_ends[r];
+        if (next[source] < ends[source]) {
+            tournament.set(source, (*sorted_KV)[next[source]]);
+        }
+    }
+    tournament.build();
+
     std::vector<std::pair<int64_t, int64_t>> tmp;
     tmp.reserve(sorted_KV->size());
-    size_t i = 0, j = first_end;
-    while (i < first_end && j < sorted_KV->size()) {
-        if ((*sorted_KV)[i].first < (*sorted_KV)[j].first) {
-            tmp.emplace_back((*sorted_KV)[i]);
-            ++i;
-        }
-        else if ((*sorted_KV)[i].first > (*sorted_KV)[j].first) {
-            tmp.emplace_back((*sorted_KV)[j]);
-            ++j;
+    bool has_last = false;
+    int64_t last_key = 0; // Older versions of the last key taken out are skipped
+    while (!tournament.empty()) {
+        const pair<int64_t, int64_t>& KV = tournament.top();
+        size_t source = tournament.top_source();
+        if (!has_last || KV.first != last_key) {
+            has_last = true;
+            last_key = KV.first;
+            if (!has_ranges || !newer_ranges[source].covers(KV.first)) tmp.emplace_back(KV);
         }
-        else {
-            tmp.emplace_back((*sorted_KV)[i]);
-            ++i;
-            ++j;
+        if (++next[source] < ends[source]) {
+            tournament.replace_top((*sorted_KV)[next[source]]);
+        } else {
+            tournament.pop_top();
         }
     }
-    while (i < first_end) {
-        tmp.emplace_back((*sorted_KV)[i]);
-        ++i;
-    }
-    while (j < sorted_KV->size()) {
-        tmp.emplace_back((*sorted_KV)[j]);
-        ++j;
-    }
     *sorted_KV = std::move(tmp);
 }
 
-/* Perform scan operation in SSTs */
-void LSMTree::scan(vector<pair<int64_t, int64_t>>*& sorted_KV, const int64_t& key1, const int64_t& key2,
-                                                                                    const bool& use_btree) {
-    size_t len;
+/*  Perform scan operation in SSTs. The range of each SST is appended to sorted_KV as a run of its own,
+    youngest first, and its end pushed to run_ends, its range tombstones to run_ranges;
+    merge_scan_results merges them all at once */
+void LSMTree::scan(vector<pair<int64_t, int64_t>>*& sorted_KV, vector<size_t>& run_ends, vector<RangeTombstones>& run_ranges,
+                   const int64_t& key1, const int64_t& key2, const SearchMode& mode) {
+    // The SSTs are taken from the levels at once, under lsmt_mutex, and scanned without it. Runs are newest first:
+    // every SST of a level that is not partitioned, or the SSTs of a partitioned level that overlap the range, which
+    // hold disjoint keys in order so that together they make one run
+    vector<vector<shared_ptr<SSTHandle>>> runs;
+    {
+        lock_guard<mutex> lock(lsmt_mutex);
+        for (int i = 0; i < (int)num_levels; ++i) {
+            Level& level = levels[i];
+            if (partitioned(i)) {
+                runs.emplace_back();
+                for (size_t j = level.find_SST(key1); j < level.sorted_dir.size() && level.key_ranges[j].first <= key2; ++j) {
+                    runs.back().emplace_back(handle(level.sorted_dir[j]));
+                }
+                continue;
+            }
+            for (auto file_path_itr = level.sorted_dir.rbegin(); file_path_itr != level.sorted_dir.rend(); ++file_path_itr) {
+                runs.push_back({handle(*file_path_itr)});
+            }
+        }
+    }
+
     // counts the number of pages that the scan accesses
     // Used for preventing sequential floodings
     size_t scanPageCount = 0;
 
     // Scan each SST
-    for (int i = 0; i < (int)num_levels; ++i) {
-        for (auto file_path_itr = levels[i].sorted_dir.rbegin();
-             file_path_itr != levels[i].sorted_dir.rend();
-             ++file_path_itr) {
+    for (const vector<shared_ptr<SSTHandle>>& run : runs) {
+        size_t len = sorted_KV->size();
+        RangeTombstones ranges;
+        for (const shared_ptr<SSTHandle>& sst_handle : run) {
             #ifdef DEBUG
-                cout << "Scanning file: " << *file_path_itr << "..." << endl;
+                cout << "Scanning file: " << sst_handle->sst_file << "..." << endl;
             #endif
 
-            int64_t min_key, max_key;
-            size_t file_end = fs::file_size(sst_path / *file_path_itr);
-            size_t non_leaf_start;
-            parse_SST_name(*file_path_itr, min_key, max_key, non_leaf_start);
+            const SSTMeta& sst = sst_handle->meta();
 
             // EXTRA FEATURE
             // Since Bloom Filter does not help with scan(), we use min_key & max_key to
             // make db skip SSTs if the scan is not within the key range of the SST
-            if (key2 < min_key || key1 > max_key) {
+            if (key2 < sst.min_key || key1 > sst.max_key) {
                 #ifdef DEBUG
-                    cout << "key is not in range of: " << *file_path_itr << endl;
+                    cout << "key is not in range of: " << sst_handle->sst_file << endl;
                 #endif
                 continue;
             }
 
-            // Store current size of array for merging
-            len = sorted_KV->size();
-
             // Scan the SST
-            scan_SST(*sorted_KV, sst_path / (*file_path_itr), key1, key2, file_end, non_leaf_start,
-                      scanPageCount, use_btree);
-
-            // Merge into one sorted array
-            merge_scan_results(sorted_KV, len);
+            scan_SST(*sorted_KV, sst_handle->sst_file, key1, key2, sst, scanPageCount, lookup_mode(mode));
+            ranges.add(sst.range_tombstones);
+        }
+        if (sorted_KV->size() > len || !ranges.empty()) {
+            run_ends.emplace_back(sorted_KV->size());
+            run_ranges.emplace_back(move(ranges));
         }
     }
 }
 
-/* Helper function for performing scan on BTree */
-const int32_t LSMTree::scan_helper_BTree(const int& fd, const fs::path& file_path, const int64_t& key1,
-                                         const size_t& file_end, const size_t& non_leaf_start) {
-    int32_t offset = BTree::search_BTree_non_leaf_nodes(*this, fd, file_path, key1, file_end, non_leaf_start);
-    if (offset < 0) return -1;
-    BTreeLeafNode* leafNode;
-    char* tmp;
-    read(file_path.c_str(), fd, tmp, offset, false, true);
-    leafNode = (BTreeLeafNode*)tmp;
-
-    int low = 0;
-    int high = constants::KEYS_PER_NODE - 1;
-    int mid;
+/* Helper function for performing scan on BTree, once the fence pointers or the learned index gave the leaf of key1 */
+const int64_t LSMTree::scan_helper_leaf(const int& fd, const fs::path& file_path, const int64_t& key1, const int64_t& offset) {
+    BTreeLeafNode leafNode;
+    read(file_path.c_str(), fd, (char*)&leafNode, offset, false, true);
 
-    while (low != high) {
-        mid = (low + high) / 2;
-        pair<int64_t, int64_t>& cur = leafNode->data[mid];
-        if (cur.first == key1) {
-            low = mid;
-            break;
-        } else if (cur.first < key1) {
-            low = mid + 1; // target can only in right half
-        } else {
-            high = mid; // target can at mid or in left half
-        }
-    }
-    return (int)(offset / constants::PAIR_SIZE) + low;
+    // The first element >= key1, or the last one of the page
+    size_t index = min(PageSearch::leaf_lower_bound(leafNode, key1), (size_t)constants::KEYS_PER_NODE - 1);
+    return offset / constants::PAIR_SIZE + index;
 }
 
 /* Helper function for performing scan on binary */
-const int32_t LSMTree::scan_helper_Binary(const int& fd, const fs::path& file_path, const int64_t& key1,
-                                          const int32_t& num_elements, const size_t& file_end, const size_t& non_leaf_start) {
+const int64_t LSMTree::scan_helper_Binary(const int& fd, const fs::path& file_path, const int64_t& key1,
+                                          const int64_t& num_elements, const size_t& file_end, const size_t& non_leaf_start) {
     // Variables used in binary search
     pair<int64_t, int64_t> cur;
-    BTreeLeafNode* leafNode = nullptr;
-    int low = 0;
-    int high = num_elements - 1;
-    int mid;
-    int prevPage = -1;
+    BTreeLeafNode leafNode;
+    int64_t low = 0;
+    int64_t high = num_elements - 1;
+    int64_t mid;
+    int64_t prevPage = -1;
 
     // Binary search to find the first element >= key1
     while (low != high) {
         mid = (low + high) / 2;
 
         // Do one I/O per page if not in bufferpool
-        int curPage = floor((mid*constants::PAIR_SIZE) / constants::PAGE_SIZE);
+        int64_t curPage = mid / constants::KEYS_PER_NODE;
         if (curPage != prevPage) {
-            char* tmp;
-            read(file_path.c_str(), fd, tmp, (curPage * constants::PAGE_SIZE), false, true);
-            leafNode = (BTreeLeafNode*)tmp;
+            read(file_path.c_str(), fd, (char*)&leafNode, (curPage * constants::PAGE_SIZE), false, true);
             prevPage = curPage;
         }
-        cur = leafNode->data[mid - curPage * constants::KEYS_PER_NODE];
+        cur = leafNode.data[mid - curPage * constants::KEYS_PER_NODE];
 
         if (cur.first == key1) {
             low = mid;
@@ -616,7 +1400,7 @@ const int32_t LSMTree::scan_helper_Binary(const int& fd, const fs::path& file_pa
 
 /* Scan SST to get keys within range, the implementation is similar with search_SST()*/
 void LSMTree::scan_SST(vector<pair<int64_t, int64_t>>& sorted_KV, const string& file_path, const int64_t& key1, const int64_t& key2,
-                       const size_t& file_end, const size_t& non_leaf_start, size_t& scanPageCount, const bool& use_btree) {
+                       const SSTMeta& sst, size_t& scanPageCount, const SearchMode& mode) {
     // Open the SST file
     int fd = open(file_path.c_str(), O_RDONLY | O_SYNC | O_DIRECT, 0777);
  
@@ -624,23 +1408,20 @@ void LSMTree::scan_SST(vector<pair<int64_t, int64_t>>& sorted_KV, const string&
         assert(fd != -1);
     #endif
 
-    int num_elements = (int)(non_leaf_start / constants::PAIR_SIZE);
+    int64_t num_elements = sst.leaf_end / constants::PAIR_SIZE;
 
-    int32_t start = -1;
-    if (use_btree) {
-        start = scan_helper_BTree(fd, file_path, key1, file_end, non_leaf_start);
-        if (start == -1) return;
+    int64_t start = -1;
+    if (mode != search_binary) {
+        start = scan_helper_leaf(fd, file_path, key1, find_leaf(fd, file_path, sst, key1, mode));
     } else {
-        start = scan_helper_Binary(fd, file_path, key1, num_elements, file_end, non_leaf_start);
+        start = scan_helper_Binary(fd, file_path, key1, num_elements, sst.index_end, sst.leaf_end);
     }
 
     // Low and high both points to what we are looking for
     pair<int64_t, int64_t> cur;
     int64_t prev = -1; // FIXME: init to tombstone?
-    BTreeLeafNode* leafNode = nullptr;
-    int prevPage = -1;
-
-    bool bufferHit = true;
+    BTreeLeafNode leafNode;
+    int64_t prevPage = -1;
 
     for (auto i=start; i < num_elements ; ++i) {
         // Record previous key to prevent reading redundant padded values
@@ -648,13 +1429,8 @@ void LSMTree::scan_SST(vector<pair<int64_t, int64_t>>& sorted_KV, const string&
             prev = cur.first;
         }
         // Iterate each element and push to vector
-        int curPage = floor((i*constants::PAIR_SIZE) / constants::PAGE_SIZE);
+        int64_t curPage = i / constants::KEYS_PER_NODE;
         if (curPage != prevPage) {
-            // Under long scan, since the page returned from read() is not in buffer pool,
-            // no eviction anymore and we need to delte it manually
-            if (scanPageCount >= constants::SEQUENTIAL_FLOODING_LIMIT && !bufferHit) {
-                delete leafNode;
-            }
             // If num of pages accessed by the scan is larger than SEQUENTIAL_FLOODING_LIMIT,
             // then do not put ANY following pages into buffer pool
             #ifdef DEBUG
@@ -664,12 +1440,10 @@ void LSMTree::scan_SST(vector<pair<int64_t, int64_t>>& sorted_KV, const string&
             #endif
             ++scanPageCount;
 
-            char* tmp = nullptr;
-            bufferHit = read(file_path.c_str(), fd, tmp, (curPage * constants::PAGE_SIZE), scanPageCount, true);
-            leafNode = (BTreeLeafNode*)tmp;
+            read(file_path.c_str(), fd, (char*)&leafNode, (curPage * constants::PAGE_SIZE), scanPageCount, true);
             prevPage = curPage;
         }
-        cur = leafNode->data[i - curPage * constants::KEYS_PER_NODE];
+        cur = leafNode.data[i - curPage * constants::KEYS_PER_NODE];
 
         if (cur.first <= key2) { 
             // Padding detection
@@ -681,9 +1455,6 @@ void LSMTree::scan_SST(vector<pair<int64_t, int64_t>>& sorted_KV, const string&
             break; // until meeting the first value out of range
         }
     }
-    if (scanPageCount >= constants::SEQUENTIAL_FLOODING_LIMIT && !bufferHit) {
-        delete leafNode;
-    }
     int close_res = close(fd);
     #ifdef ASSERT
         assert(close_res != -1);
@@ -691,11 +1462,11 @@ void LSMTree::scan_SST(vector<pair<int64_t, int64_t>>& sorted_KV, const string&
 }
 
 /* Combine SST file's name with offset to get the page ID */
-const string LSMTree::parse_pid(const string& file_path, const int32_t& offset) {
+const string LSMTree::parse_pid(const string& file_path, const int64_t& offset) {
     size_t lastSlash = file_path.find_last_of('/');
     size_t lastDot = file_path.find_last_of('.');
     // Note: Here "-1" means to distinguish between sst/ and filter/ (i.e. "t/" vs. "r/")
-    string file_name = file_path.substr(lastSlash - 1, lastDot - lastSlash - 1);
+    string file_name = file_path.substr(lastSlash - 1, lastDot - lastSlash + 1);
     
     // Combine the extracted part with offset into a string
     stringstream combinedString;
@@ -703,72 +1474,77 @@ const string LSMTree::parse_pid(const string& file_path, const int32_t& offset)
     return combinedString.str();
 }
 
-/* Read from bufferpool or storage */
-bool LSMTree::read(const string& file_path, const int& fd, char*& data, const off_t& offset, const size_t& scanPageCount,
+/*  Read a page into the page buffer of the caller, from bufferpool or storage. Only the buffer pool is locked, a copy of
+    its page is returned so that it may be evicted meanwhile. Return: whether the page was in the buffer pool */
+bool LSMTree::read(const string& file_path, const int& fd, char* page, const off_t& offset, const size_t& scanPageCount,
                    const bool& isLeaf) {
     #ifdef ASSERT
         assert(offset >= 0);
     #endif
     const string p_id = parse_pid(file_path, offset);
     char* tmp;
-    
-    if (constants::USE_BUFFER_POOL && buffer->get_from_buffer(p_id, tmp)) { // Read from bufferpool
-        data = tmp;
-        return true;
-    } else { // Read from storage, then insert the page into bufferpool
-        tmp = (char*)new BTreeNonLeafNode();
-        int ret = pread(fd, tmp, constants::KEYS_PER_NODE * constants::PAIR_SIZE, offset);
-        #ifdef ASSERT
-            assert(ret == constants::KEYS_PER_NODE * constants::PAIR_SIZE);
-        #endif
-        // If a range query is long, we do not save it to the buffer pool (aka evict immediately)
-        if (scanPageCount < constants::SEQUENTIAL_FLOODING_LIMIT) {
+
+    if (constants::USE_BUFFER_POOL) { // Read from bufferpool
+        lock_guard<mutex> lock(buffer_mutex);
+        if (buffer->get_from_buffer(p_id, tmp)) {
+            memcpy(page, tmp, constants::PAGE_SIZE);
+            return true;
+        }
+    }
+    // Read from storage, then insert the page into bufferpool
+    int ret = pread(fd, page, constants::KEYS_PER_NODE * constants::PAIR_SIZE, offset);
+    #ifdef ASSERT
+        assert(ret == constants::KEYS_PER_NODE * constants::PAIR_SIZE);
+    #endif
+    // If a range query is long, we do not save it to the buffer pool
+    if (scanPageCount < constants::SEQUENTIAL_FLOODING_LIMIT) {
+        lock_guard<mutex> lock(buffer_mutex);
+        // Another lookup may have read the same page meanwhile
+        if (!buffer->get_from_buffer(p_id, tmp)) {
+            tmp = (char*)new BTreeNonLeafNode();
+            memcpy(tmp, page, constants::PAGE_SIZE);
             buffer->insert_to_buffer(p_id, isLeaf, tmp);
         }
-        data = tmp;
-        return false;
     }
+    return false;
 }
 
-/* Given a level information, calculate the number of kv entries on the SST leaves */
-size_t LSMTree::calculate_sst_size(Level& cur_level) {
+/* Given a level, calculate the nominal number of kv entries on the leaves of a run made of `units` units.
+   For Dostoevsky, the run on the last level is a big contiguous run of several units.
+   Actual runs may differ (the memtable budget can change at runtime), SSTs are sized by their real count */
+size_t LSMTree::calculate_sst_size(const size_t& level, const size_t& units) {
     // num entries in memtable
-    size_t total_num_entries = constants::MEMTABLE_SIZE;
-    // num entries in each SST on cur_level
-    total_num_entries *= pow(constants::LSMT_SIZE_RATIO, cur_level.level); 
-    if (cur_level.last_level) {
-        // For Dostoevsky, if it is at the last level, they will be a big contiguous run
-        total_num_entries *= cur_level.cur_size; 
-    }
-    return total_num_entries;
+    size_t total_num_entries = memtable_capacity;
+    // num entries in each SST on the level
+    total_num_entries *= pow(size_ratio, level);
+    return total_num_entries * units;
 }
 
-/* Given a file path to a filter of a level, and a key, probing if the key is in the level */
-bool LSMTree::check_bloomFilter(const fs::path& filter_path, const int64_t& key, Level& cur_level) {
-    float bits_per_entry = BloomFilter::calculate_num_bits_per_entry(cur_level.level, num_levels);
-    // Convert total num of kv entries to num of BF bits
-    size_t total_num_bits = (size_t)(calculate_sst_size(cur_level) * bits_per_entry);
-    size_t total_num_cache_lines = total_num_bits >> constants::CACHE_LINE_SIZE_BITS_SHIFT;
-
+/*  Given a file path to a filter of an SST, and a key, probing if the key is in the SST.
+    The footer of the SST tells how the filter was sized when it was built */
+bool LSMTree::check_bloomFilter(const fs::path& filter_path, const SSTMeta& meta, const int64_t& key) {
     int fd = open(filter_path.c_str(), O_RDONLY | O_SYNC | O_DIRECT, 0777);
     #ifdef ASSERT
         assert(fd != -1);
     #endif
 
+    BTreeNonLeafNode filter_page;
+    size_t total_num_cache_lines = meta.filter_num_cache_lines;
+    size_t num_of_hashes = meta.filter_num_of_hashes;
+
     // Get the cacheline index
     size_t cache_line_hash = murmur_hash(key, 0) % total_num_cache_lines;
-    // To get the page index of the cacheline. One page has multiple cachelines
-    size_t page = cache_line_hash >> constants::PAGE_CACHELINE_SHIFT;
+    // To get the page index of the cacheline (after the header page). One page has multiple cachelines
+    size_t page = (cache_line_hash >> constants::PAGE_CACHELINE_SHIFT) + 1;
     // To get the cacheline index on the page
     size_t cache_line_hash_on_page = cache_line_hash & ((1<<constants::PAGE_CACHELINE_SHIFT) - 1);
 
-    char* tmp = nullptr;
-    read(filter_path, fd, tmp, page << constants::PAGE_SIZE_SHIFT, false, false);
+    read(filter_path, fd, (char*)&filter_page, page << constants::PAGE_SIZE_SHIFT, false, false);
 
     // Array of bitset<constants::CACHE_LINE_SIZE>
-    bitset<constants::CACHE_LINE_SIZE_BITS>* blocked_bitmaps = (bitset<constants::CACHE_LINE_SIZE_BITS>*)tmp; 
+    bitset<constants::CACHE_LINE_SIZE_BITS>* blocked_bitmaps = (bitset<constants::CACHE_LINE_SIZE_BITS>*)&filter_page; 
 
-    for (uint32_t i = 1; i <= BloomFilter::calculate_num_of_hashes(bits_per_entry); ++i) {
+    for (uint32_t i = 1; i <= num_of_hashes; ++i) {
         // Get the bit index
         size_t hash = murmur_hash(key, i) & ((1<<constants::CACHE_LINE_SIZE_BITS_SHIFT) - 1);
         // If any of the hash results in a negative in the probing, return DNE
@@ -787,26 +1563,52 @@ bool LSMTree::check_bloomFilter(const fs::path& filter_path, const int64_t& key,
     return true;
 }
 
-/*  Function to generate the filename of a SST or a filter
-    Format: <LSMT_level>_<time><clock>_<min_key_value>_<max_key_value>_<file_offset_of_non_leaf_nodes>.bytes */
-string LSMTree::generate_filename(const size_t& level, const int64_t& min_key, const int64_t& max_key,
-                                  const int32_t& leaf_ends) {
-    // We use time+clock to uniquely identify a timestamp
-    string cur_time = to_string(time(0));
-    string cur_clock = to_string(clock()); // In case there is a tie in time())
-    string prefix = to_string(level).append("_").append(cur_time).append(cur_clock).append("_");
-    string suffix = to_string(min_key).append("_").append(to_string(max_key))
-                                      .append("_").append(to_string(leaf_ends)).append(".bytes");
-    return prefix.append(suffix);
+/*  A new SST (and its filter) is named <number>.bytes: everything else about it is in its footer, and its level
+    in the MANIFEST, so a name never changes */
+string LSMTree::new_SST_name() {
+    return to_string(next_file_number++) + ".bytes";
+}
+
+/*  Make the names of new SSTs and of their Bloom Filters durable. Called once they are written, before the MANIFEST
+    lists them: the log of their pairs may be released right after, so a crash must not lose their directory entries */
+void LSMTree::sync_SST_dirs() {
+    sync_directory(sst_path);
+    sync_directory(filter_path);
+}
+
+/* Memory held by the fence pointers of the SSTs searched so far, which stay cached until their SSTs are removed */
+size_t LSMTree::fence_pointer_bytes() {
+    lock_guard<mutex> lock(lsmt_mutex);
+    size_t bytes = 0;
+    for (const pair<const string, shared_ptr<SSTHandle>>& cached : SST_handles) {
+        bytes += cached.second->meta().fence_bytes();
+    }
+    return bytes;
+}
+
+size_t LSMTree::learned_index_bytes() {
+    lock_guard<mutex> lock(lsmt_mutex);
+    size_t bytes = 0;
+    for (const pair<const string, shared_ptr<SSTHandle>>& cached : SST_handles) {
+        bytes += cached.second->meta().learned_index.bytes();
+    }
+    return bytes;
 }
 
 /* Print the LSM-Tree, for debugging purpose */
 void LSMTree::print_lsmt() {
     for (size_t i = 0; i < num_levels; ++i) {
-        cout << "level " << to_string(i) << " cur_size: " << levels[i].cur_size << endl;
+        cout << "level " << to_string(i) << " cur_size: " << levels[i].cur_size << " debt: " << level_debt(i) << endl;
         if (levels[i].cur_size > 0) {
             for (size_t j = 0; j < levels[i].sorted_dir.size(); ++j) {
-                cout << " sorted_dir: " << levels[i].sorted_dir[j].c_str() << endl;
+                cout << " sorted_dir: " << levels[i].sorted_dir[j].c_str();
+                auto cached = SST_handles.find(levels[i].sorted_dir[j].string());
+                if (cached != SST_handles.end()) {
+                    const SSTMeta& sst = cached->second->meta();
+                    cout << " fence pointers: " << sst.fence_bytes() << " bytes, learned index: "
+                         << sst.learned_index.bytes() << " bytes";
+                }
+                cout << endl;
             }
         }
     }
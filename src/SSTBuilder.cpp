@@ -0,0 +1,136 @@
+#include <iostream>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cassert>
+#include <string>
+#include "SSTBuilder.h"
+#include "LSMTree.h"
+#include "BTree.h"
+using namespace std;
+
+atomic<size_t> SSTBuilder::num_builders(0);
+
+SSTBuilder::SSTBuilder(LSMTree& lsmtree, const size_t& level, const size_t& expected_size, const size_t& total_levels) :
+    total_count(0), min_key(constants::TOMBSTONE), max_key(constants::TOMBSTONE), lsmtree(lsmtree),
+    output_buffer(staging_size(expected_size)), bloom_filter(expected_size, lsmtree.bits_per_entry(level, total_levels)), SST_offset(0) {
+    // Try to predict required memory using fan-out = KEYS_PER_NODE
+    non_leaf_keys.reserve(expected_size / constants::KEYS_PER_NODE);
+    // The SST is only renamed to its real name once complete, so a half-written SST is never picked up.
+    // It is synced once by finish() rather than on every write
+    temp_path = new_temp_path(lsmtree.sst_path);
+    fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0777);
+    #ifdef ASSERT
+        assert(fd != -1);
+    #endif
+    // Reserve the space of the leaves plus about one page of non-leaf nodes per KEYS_PER_NODE leaves (and the footer), so the
+    // file system can allocate it in one piece. The size is kept, finish() releases what was not used.
+    // It is only a hint: a file system without fallocate support just allocates as the SST is written
+    size_t expected_pages = (expected_size + constants::KEYS_PER_NODE - 1) / constants::KEYS_PER_NODE;
+    fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, (expected_pages + expected_pages / constants::KEYS_PER_NODE + 2) * constants::PAGE_SIZE);
+}
+
+/* Number of pairs staged before a write: SST_WRITE_SIZE bytes, or less for a small SST, in whole pages */
+size_t SSTBuilder::staging_size(const size_t& expected_size) {
+    size_t expected_pages = max((expected_size + constants::KEYS_PER_NODE - 1) / constants::KEYS_PER_NODE, (size_t)1);
+    return min(expected_pages * constants::KEYS_PER_NODE, constants::SST_WRITE_SIZE / constants::PAIR_SIZE);
+}
+
+SSTBuilder::~SSTBuilder() {
+    // finish() was not called
+    if (fd != -1) {
+        close(fd);
+        remove(temp_path);
+    }
+}
+
+fs::path SSTBuilder::new_temp_path(const fs::path& sst_path) {
+    return sst_path / ("temp" + to_string(num_builders++) + ".bytes");
+}
+
+void SSTBuilder::add(const pair<int64_t, int64_t>& KV) {
+    #ifdef ASSERT
+        assert(total_count == 0 || KV.first > max_key);
+    #endif
+    if (total_count == 0) min_key = KV.first;
+    max_key = KV.first;
+    output_buffer.emplace_back(KV);
+    ++total_count;
+    bloom_filter.set(KV.first);
+    if (KV.second == constants::TOMBSTONE) ++bloom_filter.num_tombstones;
+    if (total_count % constants::KEYS_PER_NODE == 0) {
+        // This is an element in one of the non-leaf nodes in the B-Tree
+        non_leaf_keys.emplace_back(KV.first);
+    }
+    if (output_buffer.isFull()) {
+        output_buffer.flush_to_file(fd, SST_offset);
+    }
+}
+
+void SSTBuilder::add_range(const pair<int64_t, int64_t>& range) {
+    #ifdef ASSERT
+        assert(total_count > 0 && min_key <= range.first && range.second <= max_key);
+    #endif
+    bloom_filter.range_tombstones.add(range.first, range.second);
+}
+
+string SSTBuilder::finish() {
+    if (total_count == 0) {
+        close(fd);
+        fd = -1;
+        remove(temp_path);
+        return "";
+    }
+
+    // We pad repeated last element to form a complete 4kb node
+    size_t padded_count = total_count;
+    if (padded_count % constants::KEYS_PER_NODE != 0) {
+        padded_count += output_buffer.add_padding();
+        non_leaf_keys.emplace_back(output_buffer.back().first);
+    }
+    if (output_buffer.size() > 0) {
+        output_buffer.flush_to_file(fd, SST_offset);
+    }
+
+    // Build up the B-Tree
+    int64_t leaf_end = padded_count * constants::PAIR_SIZE;
+    int64_t offset = leaf_end;
+    if (non_leaf_keys.size() != 0) {
+        BTree btree;
+        // Build-up the non-leaf nodes
+        btree.convertToBtree(non_leaf_keys, padded_count);
+
+        // Write non-leaf levels to file, starting from root
+        btree.write_non_leaf_nodes_to_storage(fd, offset);
+    }
+    SSTFooter footer;
+    footer.num_entries = total_count;
+    footer.min_key = min_key;
+    footer.max_key = max_key;
+    footer.leaf_end = leaf_end;
+    footer.index_end = offset;
+    footer.filter_num_cache_lines = bloom_filter.total_num_cache_lines;
+    footer.filter_num_of_hashes = bloom_filter.num_of_hashes;
+    BTree::write_footer(fd, footer);
+
+    // Release the preallocated space past the end, and make the whole SST durable before it gets its real name
+    int result = ftruncate(fd, offset + sizeof(SSTFooter));
+    #ifdef ASSERT
+        assert(result == 0);
+    #endif
+    fdatasync(fd);
+    result = close(fd);
+    #ifdef ASSERT
+        assert(result != -1);
+    #endif
+    fd = -1;
+
+    string file_name = lsmtree.new_SST_name();
+    result = rename(temp_path.c_str(), (lsmtree.sst_path / file_name).c_str());
+    #ifdef ASSERT
+        assert(result == 0);
+    #endif
+    // Write bloom filter to storage
+    bloom_filter.writeToStorage(lsmtree.filter_path / file_name);
+    lsmtree.sync_SST_dirs();
+    return file_name;
+}
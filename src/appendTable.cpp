@@ -0,0 +1,68 @@
+#include <iostream>
+#include <cassert>
+#include "appendTable.h"
+using namespace std;
+
+AppendTable::AppendTable(size_t capacity) :
+    Memtable(capacity),
+    sorted_KV(max((capacity + constants::KEYS_PER_NODE - 1) / constants::KEYS_PER_NODE, (size_t)1) * constants::KEYS_PER_NODE) {}
+
+/* Append a pair, the caller made sure that the table accepts it */
+Result AppendTable::put(const int64_t& key, const int64_t& value) {
+    if (sorted_KV.isFull()) return memtableFull;
+    #ifdef ASSERT
+        assert(accepts(key));
+    #endif
+    sorted_KV.push_back(key, value);
+    ++curr_size;
+    return allGood;
+}
+
+void AppendTable::put_sorted(const pair<int64_t, int64_t>* sorted_KV, const size_t& count) {
+    #ifdef ASSERT
+        assert(count == 0 || accepts(sorted_KV[0].first, count));
+    #endif
+    for (size_t i = 0; i < count; ++i) {
+        this->sorted_KV.push_back(sorted_KV[i]);
+    }
+    curr_size += count;
+}
+
+/* Retrieve a value by key, with a binary search of the array */
+Result AppendTable::get(int64_t*& result, const int64_t& key) {
+    pair<int64_t, int64_t>* end = sorted_KV.data + sorted_KV.len;
+    pair<int64_t, int64_t>* KV = lower_bound(sorted_KV.data, end, key,
+                                             [](const pair<int64_t, int64_t>& KV, const int64_t& key) { return KV.first < key; });
+    if (KV == end || KV->first != key) {
+        #ifdef DEBUG
+            cout << "Not found Key: " << key << " in memtable. Now searching SSTs..." << endl;
+        #endif
+        return notInMemtable;
+    }
+    result = new int64_t(KV->second);
+    return allGood;
+}
+
+/* Retrieve all KV-pairs in a key range in key order (key1 < key2) */
+void AppendTable::scan(vector<pair<int64_t, int64_t>>& sorted_KV, const int64_t& key1, const int64_t& key2) {
+    pair<int64_t, int64_t>* end = this->sorted_KV.data + this->sorted_KV.len;
+    pair<int64_t, int64_t>* KV = lower_bound(this->sorted_KV.data, end, key1,
+                                             [](const pair<int64_t, int64_t>& KV, const int64_t& key) { return KV.first < key; });
+    for (; KV != end && KV->first <= key2; ++KV) {
+        sorted_KV.emplace_back(*KV);
+    }
+}
+
+/* Copy the whole array, the flush of an append table normally writes the array itself */
+void AppendTable::scan_all(aligned_KV_vector& sorted_KV, const function<void(const size_t&)>& on_chunk) {
+    for (size_t i = 0; i < this->sorted_KV.len; ++i) {
+        sorted_KV.emplace_back(this->sorted_KV.data[i]);
+        if (sorted_KV.len % constants::FLUSH_CHUNK_SIZE == 0) on_chunk(sorted_KV.len);
+    }
+}
+
+void AppendTable::clear() {
+    sorted_KV.len = 0;
+    curr_size = 0;
+    range_tombstones.clear();
+}
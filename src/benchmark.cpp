@@ -8,6 +8,11 @@
 #include <algorithm>
 #include <time.h>
 #include <chrono>
+#include <map>
+#include <random>
+#include <queue>
+#include "loserTree.h"
+#include "pageSearch.h"
 using namespace std;
 
 // Modified from https://www.gormanalysis.com/blog/reading-and-writing-csv-files-with-cpp/
@@ -54,8 +59,447 @@ double calculate_throughput(const chrono::_V2::system_clock::time_point& start_t
     return op * 1000000;
 }
 
+/* Allocator of the std::map baseline below, which counts the allocations of its nodes */
+template <typename T>
+struct CountingAllocator {
+    using value_type = T;
+    size_t* num_allocations;
+
+    CountingAllocator(size_t* num_allocations) : num_allocations(num_allocations) {}
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>& other) : num_allocations(other.num_allocations) {}
+
+    T* allocate(size_t n) {
+        ++*num_allocations;
+        return allocator<T>().allocate(n);
+    }
+    void deallocate(T* ptr, size_t n) {
+        allocator<T>().deallocate(ptr, n);
+    }
+    template <typename U>
+    bool operator==(const CountingAllocator<U>& other) const { return num_allocations == other.num_allocations; }
+    template <typename U>
+    bool operator!=(const CountingAllocator<U>& other) const { return num_allocations != other.num_allocations; }
+};
+
+/* Compare the put path of the arena-backed memtable against a heap-allocated red-black tree (std::map),
+ * which does one allocation per inserted node, just like the memtable did before the arena.
+ * The allocations are those of the arena blocks, and of the nodes of the std::map */
+void benchmark_memtable_put(const string& file_name) {
+    const int num_rounds = 16; // Each round fills up a memtable and then clears it like a flush
+    vector<double> rounds;
+    vector<double> arena_tps, arena_allocs, heap_tps, heap_allocs;
+
+    cerr << "Running memtable put benchmark..." << endl;
+    default_random_engine generator(443);
+    uniform_int_distribution<int64_t> distrib(0, numeric_limits<int64_t>::max());
+    vector<int64_t> keys(constants::MEMTABLE_SIZE);
+
+    RBTree memtable(constants::MEMTABLE_SIZE);
+    size_t heap_allocations = 0;
+    CountingAllocator<pair<const int64_t, int64_t>> heap_allocator(&heap_allocations);
+    map<int64_t, int64_t, less<int64_t>, CountingAllocator<pair<const int64_t, int64_t>>> heap_tree(heap_allocator);
+    for (int round = 1; round <= num_rounds; ++round) {
+        for (int64_t& key : keys) key = distrib(generator);
+
+        size_t allocs_before = memtable.arena.num_allocations;
+        auto start_time = chrono::high_resolution_clock::now();
+        for (int64_t& key : keys) memtable.put(key, key);
+        memtable.clear();
+        double tps = calculate_throughput(start_time, chrono::high_resolution_clock::now(), keys.size());
+        arena_allocs.emplace_back(memtable.arena.num_allocations - allocs_before);
+        arena_tps.emplace_back(tps);
+        cerr << "Round " << round << " arena: " << tps << "ops/sec, " << arena_allocs.back() << " allocations" << endl;
+
+        allocs_before = heap_allocations;
+        start_time = chrono::high_resolution_clock::now();
+        for (int64_t& key : keys) heap_tree[key] = key;
+        heap_tree.clear();
+        tps = calculate_throughput(start_time, chrono::high_resolution_clock::now(), keys.size());
+        heap_allocs.emplace_back(heap_allocations - allocs_before);
+        heap_tps.emplace_back(tps);
+        cerr << "Round " << round << " heap: " << tps << "ops/sec, " << heap_allocs.back() << " allocations" << endl;
+
+        rounds.emplace_back(round);
+    }
+
+    vector<pair<string, vector<double>>> vals = {{"Round", rounds}, {"Put_Arena", arena_tps}, {"Allocations_Arena", arena_allocs},
+                                                 {"Put_Heap", heap_tps}, {"Allocations_Heap", heap_allocs}};
+    cerr << "Writing results to " << file_name << "..." << endl;
+    write_csv(file_name, vals);
+}
+
+/* Full in-order traversal that filters the range afterwards, the way the red-black tree memtable used to scan */
+void full_traversal_scan(vector<pair<int64_t, int64_t>>& sorted_KV, const Node* root, const int64_t& key1, const int64_t& key2) {
+    if (root != nullptr) {
+        full_traversal_scan(sorted_KV, root->left, key1, key2);
+        if (key1 <= root->key && root->key <= key2) {
+            sorted_KV.emplace_back(root->key, root->value);
+        }
+        full_traversal_scan(sorted_KV, root->right, key1, key2);
+    }
+}
+
+/* Short range scans against a full memtable: the bounded red-black tree iterator and the skiplist,
+ * against a full traversal of the tree */
+void benchmark_memtable_scan(const string& file_name) {
+    const int num_scans = 2000;
+    const int64_t key_gap = 1024; // Average distance between two keys in the memtable
+    vector<double> scan_lengths = {16, 256, 4096};
+    vector<double> rbtree_tps, skiplist_tps, traversal_tps;
+
+    cerr << "Running memtable scan benchmark..." << endl;
+    default_random_engine generator(443);
+    uniform_int_distribution<int64_t> distrib(0, constants::MEMTABLE_SIZE * key_gap);
+    RBTree rbtree(constants::MEMTABLE_SIZE);
+    SkipList skiplist(constants::MEMTABLE_SIZE);
+    while (rbtree.curr_size < (size_t)constants::MEMTABLE_SIZE) {
+        int64_t key = distrib(generator);
+        rbtree.put(key, key);
+        skiplist.put(key, key);
+    }
+
+    vector<pair<int64_t, int64_t>> sorted_KV;
+    size_t num_results = 0; // Keeps the scans from being optimized away
+    for (double scan_length : scan_lengths) {
+        vector<int64_t> starts(num_scans);
+        for (int64_t& key : starts) key = distrib(generator);
+        const int64_t range = scan_length * key_gap;
+
+        auto start_time = chrono::high_resolution_clock::now();
+        for (const int64_t& key : starts) {
+            sorted_KV.clear();
+            rbtree.scan(sorted_KV, key, key + range);
+            num_results += sorted_KV.size();
+        }
+        rbtree_tps.emplace_back(calculate_throughput(start_time, chrono::high_resolution_clock::now(), num_scans));
+
+        start_time = chrono::high_resolution_clock::now();
+        for (const int64_t& key : starts) {
+            sorted_KV.clear();
+            skiplist.scan(sorted_KV, key, key + range);
+            num_results += sorted_KV.size();
+        }
+        skiplist_tps.emplace_back(calculate_throughput(start_time, chrono::high_resolution_clock::now(), num_scans));
+
+        start_time = chrono::high_resolution_clock::now();
+        for (const int64_t& key : starts) {
+            sorted_KV.clear();
+            full_traversal_scan(sorted_KV, rbtree.root, key, key + range);
+            num_results += sorted_KV.size();
+        }
+        traversal_tps.emplace_back(calculate_throughput(start_time, chrono::high_resolution_clock::now(), num_scans));
+        cerr << "Scans of ~" << scan_length << " keys: rbtree " << rbtree_tps.back() << "scans/sec, skiplist " << skiplist_tps.back()
+             << "scans/sec, full traversal " << traversal_tps.back() << "scans/sec" << endl;
+    }
+    cerr << num_results << " KV-pairs scanned" << endl;
+
+    vector<pair<string, vector<double>>> vals = {{"Scan_Length", scan_lengths}, {"Scan_RBTree", rbtree_tps}, {"Scan_Skiplist", skiplist_tps},
+                                                 {"Scan_Full_Traversal", traversal_tps}};
+    cerr << "Writing results to " << file_name << "..." << endl;
+    write_csv(file_name, vals);
+}
+
+/* Compare loading random keys with one put() per key against Database::write() with batches of several sizes */
+void benchmark_write_batch(const string& file_name) {
+    const int64_t num_keys = 16 * constants::MEMTABLE_SIZE;
+    const string db_name = "Benchmark_batch";
+    vector<double> batch_sizes = {1, 16, 256, 4096};
+    vector<double> write_tps;
+
+    cerr << "Running write batch benchmark..." << endl;
+    for (double batch_size : batch_sizes) {
+        fs::remove_all(constants::DATA_FOLDER + db_name);
+        Database db(constants::MEMTABLE_SIZE);
+        db.openDB(db_name);
+        default_random_engine generator(443);
+        uniform_int_distribution<int64_t> distrib(0, numeric_limits<int64_t>::max());
+
+        WriteBatch batch;
+        auto start_time = chrono::high_resolution_clock::now();
+        for (int64_t i = 0; i < num_keys; ++i) {
+            int64_t key = distrib(generator);
+            if (batch_size == 1) {
+                db.put(key, key);
+                continue;
+            }
+            batch.put(key, key);
+            if (batch.size() == batch_size) {
+                db.write(batch);
+                batch.clear();
+            }
+        }
+        if (batch.size() > 0) db.write(batch);
+        double tps = calculate_throughput(start_time, chrono::high_resolution_clock::now(), num_keys);
+        write_tps.emplace_back(tps);
+        cerr << "Batch size " << batch_size << ": " << tps << "ops/sec" << endl;
+        db.closeDB();
+    }
+    fs::remove_all(constants::DATA_FOLDER + db_name);
+
+    vector<pair<string, vector<double>>> vals = {{"Batch_Size", batch_sizes}, {"Write", write_tps}};
+    cerr << "Writing results to " << file_name << "..." << endl;
+    write_csv(file_name, vals);
+}
+
+/* Node and comparator of the binary min-heap the compactions used to merge with, newest file first on duplicates */
+struct HeapNode {
+    pair<int64_t, int64_t> data;
+    size_t arrayIndex;
+};
+
+static auto heap_comp = [](const HeapNode &a, const HeapNode &b) {
+    if (a.data.first == b.data.first)
+        return a.arrayIndex < b.arrayIndex;
+    return a.data.first > b.data.first;
+};
+
+/* K-way merge of sorted runs (2 to 64 of them, with overlapping keys): tournament tree of losers vs. binary heap */
+void benchmark_kway_merge(const string& file_name) {
+    const size_t num_keys = 1 << 24;
+    vector<double> ways = {2, 4, 8, 16, 64};
+    vector<double> loser_tree_tps, heap_tps;
+
+    cerr << "Running k-way merge benchmark..." << endl;
+    default_random_engine generator(443);
+    uniform_int_distribution<int64_t> distrib(0, num_keys);
+    for (double way : ways) {
+        const size_t k = way;
+        vector<vector<pair<int64_t, int64_t>>> runs(k);
+        for (vector<pair<int64_t, int64_t>>& run : runs) {
+            for (size_t i = 0; i < num_keys / k; ++i) {
+                int64_t key = distrib(generator);
+                run.emplace_back(key, key);
+            }
+            sort(run.begin(), run.end());
+        }
+        vector<size_t> next(k);
+        vector<pair<int64_t, int64_t>> output;
+        output.reserve(num_keys);
+
+        auto start_time = chrono::high_resolution_clock::now();
+        LoserTree tournament(k);
+        for (size_t i = 0; i < k; ++i) {
+            next[i] = 0;
+            tournament.set(i, runs[i][0]);
+        }
+        tournament.build();
+        while (!tournament.empty()) {
+            output.emplace_back(tournament.top());
+            size_t source = tournament.top_source();
+            if (++next[source] < runs[source].size()) {
+                tournament.replace_top(runs[source][next[source]]);
+            } else {
+                tournament.pop_top();
+            }
+        }
+        loser_tree_tps.emplace_back(calculate_throughput(start_time, chrono::high_resolution_clock::now(), num_keys));
+        vector<pair<int64_t, int64_t>> loser_tree_output;
+        loser_tree_output.swap(output);
+        output.reserve(num_keys);
+
+        start_time = chrono::high_resolution_clock::now();
+        priority_queue<HeapNode, vector<HeapNode>, decltype(heap_comp)> minHeap(heap_comp);
+        for (size_t i = 0; i < k; ++i) {
+            next[i] = 0;
+            minHeap.push({runs[i][0], i});
+        }
+        while (!minHeap.empty()) {
+            HeapNode node = minHeap.top();
+            minHeap.pop();
+            output.emplace_back(node.data);
+            if (++next[node.arrayIndex] < runs[node.arrayIndex].size()) {
+                minHeap.push({runs[node.arrayIndex][next[node.arrayIndex]], node.arrayIndex});
+            }
+        }
+        heap_tps.emplace_back(calculate_throughput(start_time, chrono::high_resolution_clock::now(), num_keys));
+        assert(output == loser_tree_output);
+        cerr << k << "-way merge: loser tree " << loser_tree_tps.back() << "pairs/sec, heap " << heap_tps.back() << "pairs/sec" << endl;
+    }
+
+    vector<pair<string, vector<double>>> vals = {{"Ways", ways}, {"Merge_Loser_Tree", loser_tree_tps}, {"Merge_Heap", heap_tps}};
+    cerr << "Writing results to " << file_name << "..." << endl;
+    write_csv(file_name, vals);
+}
+
+/* Lookups in the SSTs with each index of their leaf pages (Options::sst_index): none (binary search of the leaves),
+ * the fence pointers (the B-Tree non-leaf keys held in memory) and the learned index; with the memory each index keeps.
+ * The database is reopened with each of them, so that every pair is in an SST and only that index is in memory */
+void benchmark_sst_search(const string& file_name) {
+    const int64_t num_ops = 100000;
+    const int64_t megabyte = 1 << 20;
+    const string db_name = "Benchmark_search";
+    vector<double> input_sizes = {16, 64, 256};
+    const vector<pair<SearchMode, string>> modes = {{search_binary, "Binary"}, {search_btree, "BTree"}, {search_learned, "Learned"}};
+    vector<vector<double>> get_tps(modes.size());
+    vector<vector<double>> index_bytes(modes.size());
+    vector<double> btree_bytes;
+
+    cerr << "Running SST search benchmark..." << endl;
+    fs::remove_all(constants::DATA_FOLDER + db_name);
+    Database db(constants::MEMTABLE_SIZE);
+    Options options;
+    db.openDB(db_name, options);
+    default_random_engine generator(443);
+    uniform_int_distribution<int64_t> distrib(0, numeric_limits<int32_t>::max());
+    int64_t num_keys = 0;
+    for (double input_size : input_sizes) {
+        int64_t total_keys = input_size * megabyte / constants::PAIR_SIZE;
+        cerr << "-------------- Input Size: " << input_size << "MB..." << endl;
+        for (; num_keys < total_keys; ++num_keys) {
+            int64_t key = distrib(generator);
+            db.put(key, key);
+        }
+
+        size_t non_leaf_bytes = 0;
+        for (size_t i = 0; i < modes.size(); ++i) {
+            // Every index is timed on a DB opened with it, so that only it is in memory
+            db.closeDB();
+            options.sst_index = modes[i].first;
+            db.openDB(db_name, options);
+            // B-Tree non-leaf nodes of every SST, which the buffer pool caches. This also loads the metadata of the SSTs
+            // (and their index) before the mode is timed
+            non_leaf_bytes = 0;
+            for (size_t level = 0; level < db.lsmtree->num_levels; ++level) {
+                for (const fs::path& sst : db.lsmtree->levels[level].sorted_dir) {
+                    SSTMeta meta = db.lsmtree->SST_meta(sst);
+                    non_leaf_bytes += meta.index_end - meta.leaf_end;
+                }
+            }
+
+            // The same keys for every mode
+            default_random_engine lookups(1);
+            auto start_time = chrono::high_resolution_clock::now();
+            for (int64_t op = 0; op < num_ops; ++op) {
+                delete db.get(distrib(lookups), modes[i].first);
+            }
+            get_tps[i].emplace_back(calculate_throughput(start_time, chrono::high_resolution_clock::now(), num_ops));
+            index_bytes[i].emplace_back(db.lsmtree->fence_pointer_bytes() + db.lsmtree->learned_index_bytes());
+            cerr << modes[i].second << " get(): " << get_tps[i].back() << "ops/sec, index bytes " << index_bytes[i].back() << endl;
+        }
+        btree_bytes.emplace_back(non_leaf_bytes);
+        cerr << "B-Tree non-leaf nodes: " << btree_bytes.back() << " bytes" << endl;
+    }
+    db.closeDB();
+    fs::remove_all(constants::DATA_FOLDER + db_name);
+
+    vector<pair<string, vector<double>>> vals = {{"InputDataSize", input_sizes}};
+    for (size_t i = 0; i < modes.size(); ++i) {
+        vals.push_back({"Get_" + modes[i].second, get_tps[i]});
+    }
+    vals.push_back({"Bytes_BTree_Non_Leaf", btree_bytes});
+    for (size_t i = 0; i < modes.size(); ++i) {
+        vals.push_back({"Bytes_Index_" + modes[i].second, index_bytes[i]});
+    }
+    cerr << "Writing results to " << file_name << "..." << endl;
+    write_csv(file_name, vals);
+}
+
+/* Latency of a search inside a page: the branchy binary search lookups used to do, and each kernel of PageSearch
+ * (0 when the CPU does not support it), over leaves and full non-leaf nodes that stay in the CPU caches */
+void benchmark_page_search(const string& file_name) {
+    const size_t num_pages = 4;
+    const int64_t num_ops = 10000000;
+    default_random_engine generator(443);
+    uniform_int_distribution<int64_t> gap(1, 1000);
+    vector<BTreeLeafNode> leaves(num_pages);
+    vector<BTreeNonLeafNode> nodes(num_pages);
+    for (size_t page = 0; page < num_pages; ++page) {
+        int64_t key = 0;
+        for (size_t i = 0; i < (size_t)constants::KEYS_PER_NODE; ++i) {
+            key += gap(generator);
+            leaves[page].data[i] = make_pair(key, key);
+            if (i < (size_t)constants::NON_LEAF_KEYS) nodes[page].keys[i] = key;
+        }
+        nodes[page].size = constants::NON_LEAF_KEYS;
+    }
+    auto time_searches = [&](auto search) {
+        size_t checksum = 0;
+        auto start_time = chrono::high_resolution_clock::now();
+        uint64_t state = 443;
+        size_t position = 0;
+        for (int64_t op = 0; op < num_ops; ++op) {
+            // A few arithmetic steps give a new page and key every time, so that the outcome of the comparisons cannot
+            // be learnt. The next key depends on this result, so that searches do not overlap: this times their latency
+            state = state * 6364136223846793005ull + 1442695040888963407ull + position;
+            size_t page = (state >> 20) % num_pages;
+            int64_t key = (state >> 33) % (500 * constants::KEYS_PER_NODE);
+            position = search(page, key);
+            checksum += position;
+        }
+        double ns = chrono::duration<double, nano>(chrono::high_resolution_clock::now() - start_time).count() / num_ops;
+        return make_pair(ns, checksum);
+    };
+
+    cerr << "Running in-page search benchmark..." << endl;
+    vector<double> page_types = {0, 1}; // Leaf, non-leaf node
+    vector<double> branchy_ns, scalar_ns, avx2_ns, avx512_ns;
+    for (double page_type : page_types) {
+        bool leaf = (page_type == 0);
+        pair<double, size_t> branchy = time_searches([&](const size_t& page, const int64_t& key) {
+            int low = 0;
+            int high = (leaf ? constants::KEYS_PER_NODE : nodes[page].size) - 1;
+            while (low <= high) {
+                int mid = (low + high) / 2;
+                int64_t cur = leaf ? leaves[page].data[mid].first : nodes[page].keys[mid];
+                if (cur < key) {
+                    low = mid + 1;
+                } else {
+                    high = mid - 1;
+                }
+            }
+            return (size_t)low;
+        });
+        branchy_ns.emplace_back(branchy.first);
+        cerr << (leaf ? "Leaf" : "Non-leaf node") << ": branchy binary search " << branchy.first << "ns";
+        for (SearchKernel kernel : {scalar_kernel, avx2_kernel, avx512_kernel}) {
+            vector<double>& results = (kernel == scalar_kernel) ? scalar_ns : (kernel == avx2_kernel) ? avx2_ns : avx512_ns;
+            if (!PageSearch::supported(kernel)) {
+                results.emplace_back(0);
+                continue;
+            }
+            pair<double, size_t> timed = time_searches([&](const size_t& page, const int64_t& key) {
+                return leaf ? PageSearch::leaf_lower_bound(leaves[page], key, kernel)
+                            : PageSearch::non_leaf_lower_bound(nodes[page], key, kernel);
+            });
+            // Every kernel finds the same positions
+            assert(timed.second == branchy.second);
+            results.emplace_back(timed.first);
+            cerr << ", kernel " << kernel << " " << timed.first << "ns";
+        }
+        cerr << endl;
+    }
+
+    vector<pair<string, vector<double>>> vals = {{"Page_Type", page_types}, {"Branchy_ns", branchy_ns}, {"Scalar_ns", scalar_ns},
+                                                 {"AVX2_ns", avx2_ns}, {"AVX512_ns", avx512_ns}};
+    cerr << "Writing results to " << file_name << "..." << endl;
+    write_csv(file_name, vals);
+}
+
+/* Usage: db <output.csv> [benchmark]
+ * Without a benchmark name, the end-to-end LSM-Tree benchmark is run */
 int main(int argc, char **argv) {
-    assert(argc == 2);
+    assert(argc == 2 || argc == 3);
+    if (argc == 3) {
+        string benchmark = argv[2];
+        if (benchmark == "memtable_put") {
+            benchmark_memtable_put(argv[1]);
+        } else if (benchmark == "write_batch") {
+            benchmark_write_batch(argv[1]);
+        } else if (benchmark == "memtable_scan") {
+            benchmark_memtable_scan(argv[1]);
+        } else if (benchmark == "kway_merge") {
+            benchmark_kway_merge(argv[1]);
+        } else if (benchmark == "sst_search") {
+            benchmark_sst_search(argv[1]);
+        } else if (benchmark == "page_search") {
+            benchmark_page_search(argv[1]);
+        } else {
+            cerr << "Unknown benchmark: " << benchmark << endl;
+            return 1;
+        }
+        return 0;
+    }
     srand (1);
     const int64_t num_ops = 1000;
     const int64_t megabyte = 1 << 20;
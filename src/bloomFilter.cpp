@@ -19,6 +19,7 @@ void BloomFilter::set(const int64_t& key) {
 }
 
 // Write the filter to storage
+// Filter file layout: |header page|....cacheline bitmaps....|range tombstones (if any)|
 void BloomFilter::writeToStorage(const string& filter_path) {
     int fd = open(filter_path.c_str(), O_WRONLY | O_CREAT | O_SYNC | O_DIRECT, 0777);
     #ifdef ASSERT
@@ -28,12 +29,58 @@ void BloomFilter::writeToStorage(const string& filter_path) {
         // Check if the bloom filter is a multiple of pages
         assert((padded_num_cache_line << constants::CACHE_LINE_SIZE_BYTES_SHIFT) % constants::PAGE_SIZE == 0);
     #endif
-    int nbytes = pwrite(fd, (char*)bitmap, padded_num_cache_line << constants::CACHE_LINE_SIZE_BYTES_SHIFT, 0);
+    BloomFilterHeader header;
+    header.num_cache_lines = total_num_cache_lines;
+    header.num_of_hashes = num_of_hashes;
+    header.num_tombstones = num_tombstones;
+    header.num_range_tombstones = range_tombstones.ranges.size();
+    int nbytes = pwrite(fd, (char*)&header, sizeof(BloomFilterHeader), 0);
+    #ifdef ASSERT
+        assert(nbytes == (int)sizeof(BloomFilterHeader));
+    #endif
+    nbytes = pwrite(fd, (char*)bitmap, padded_num_cache_line << constants::CACHE_LINE_SIZE_BYTES_SHIFT, sizeof(BloomFilterHeader));
     #ifdef ASSERT
         assert(nbytes == (int)(padded_num_cache_line << constants::CACHE_LINE_SIZE_BYTES_SHIFT));
     #endif
+    if (!range_tombstones.empty()) {
+        // Whole pages, as O_DIRECT requires
+        size_t num_pages = (range_tombstones.ranges.size() + constants::KEYS_PER_NODE - 1) / constants::KEYS_PER_NODE;
+        aligned_KV_vector pages(num_pages * constants::KEYS_PER_NODE);
+        for (const pair<int64_t, int64_t>& range : range_tombstones.ranges) {
+            pages.emplace_back(range);
+        }
+        nbytes = pwrite(fd, (char*)pages.data, num_pages * constants::PAGE_SIZE,
+                        sizeof(BloomFilterHeader) + (padded_num_cache_line << constants::CACHE_LINE_SIZE_BYTES_SHIFT));
+        #ifdef ASSERT
+            assert(nbytes == (int)(num_pages * constants::PAGE_SIZE));
+        #endif
+    }
     int close_res = close(fd);
     #ifdef ASSERT
         assert(close_res != -1);
     #endif
-}
\ No newline at end of file
+}
+
+BloomFilterHeader BloomFilter::read_header(const fs::path& filter_path, RangeTombstones* range_tombstones) {
+    BloomFilterHeader header;
+    int fd = open(filter_path.c_str(), O_RDONLY);
+    #ifdef ASSERT
+        assert(fd != -1);
+    #endif
+    int nbytes = pread(fd, (char*)&header, sizeof(BloomFilterHeader), 0);
+    #ifdef ASSERT
+        assert(nbytes == (int)sizeof(BloomFilterHeader));
+    #endif
+    if (range_tombstones != nullptr && header.num_range_tombstones > 0) {
+        // The bitmap is padded to whole pages
+        size_t bitmap_pages = (header.num_cache_lines + constants::NUM_CACHELINE_PER_PAGE - 1) / constants::NUM_CACHELINE_PER_PAGE;
+        range_tombstones->ranges.resize(header.num_range_tombstones);
+        nbytes = pread(fd, (char*)range_tombstones->ranges.data(), header.num_range_tombstones * constants::PAIR_SIZE,
+                       sizeof(BloomFilterHeader) + bitmap_pages * constants::PAGE_SIZE);
+        #ifdef ASSERT
+            assert(nbytes == (int)(header.num_range_tombstones * constants::PAIR_SIZE));
+        #endif
+    }
+    close(fd);
+    return header;
+}
@@ -12,11 +12,22 @@
 #include <string>
 #include <sstream>
 #include <time.h>
+#include <stdexcept>
 using namespace std;
 
 
-void Database::openDB(const string db_name) {
+void Database::openDB(const string db_name, const Options& options) {
+    // Appended SSTs are only chained on the last level without being merged when it is partitioned. Otherwise they
+    // would be placed above it, and every one of them merged again
+    if (options.append_mode && !options.partitioned_levels) {
+        throw invalid_argument("Cannot open database " + db_name + ": append_mode requires partitioned_levels");
+    }
+    // Monkey takes the logarithm of the FPR: a rate of 0 or below would size the Bloom Filters to infinity
+    if (!(options.bloom_fpr > 0)) {
+        throw invalid_argument("Cannot open database " + db_name + ": bloom_fpr must be greater than 0");
+    }
     this->db_name = db_name;
+    this->options = options;
     fs::path directoryPath = constants::DATA_FOLDER + db_name;
     bool db_exist = false;
 
@@ -27,6 +38,13 @@ void Database::openDB(const string db_name) {
             std::cout << "Directory exists." << db_name << std::endl;
         #endif
         db_exist = true;
+        // An SST directory of an older format (SSTs named after their levels and key ranges, no MANIFEST) would look like
+        // a crash left nothing but orphans: rather than remove its SSTs, do not open it
+        fs::path unrecognised = LSMTree::unrecognised_file(directoryPath / "sst", directoryPath / "filter");
+        if (!unrecognised.empty()) {
+            throw runtime_error("Cannot open database " + db_name + ": " + unrecognised.string()
+                                + " is not a file of this format (written by an older version?)");
+        }
     } else {
         #ifdef DEBUG
             std::cout << "Directory does not exist." << db_name <<  std::endl;
@@ -34,97 +52,293 @@ void Database::openDB(const string db_name) {
         fs::create_directories(directoryPath / "sst");
         fs::create_directory(directoryPath / "filter");
     }
-    memtable = new RBTree(memtable_capacity, memtable_root);
+    fs::create_directory(directoryPath / "wal");
+    if (options.memtable_budget > 0) {
+        memtable_capacity = max(options.memtable_budget / constants::PAIR_SIZE, (size_t)1);
+    }
+    memtable = new_memtable();
+    spare_memtable = nullptr;
+    append_table = nullptr;
     bufferpool = new Bufferpool(constants::BUFFER_POOL_CAPACITY);
-    lsmtree = new LSMTree(db_name, bufferpool);
+    lsmtree = new LSMTree(db_name, bufferpool, options.l0_stall_limit, memtable_capacity);
+    lsmtree->readahead_size = options.compaction_readahead_size;
+    lsmtree->size_ratio = max(options.size_ratio, (size_t)2);
+    lsmtree->merge_policy = options.merge_policy;
+    lsmtree->runs_per_level = (options.runs_per_level == 0) ? lsmtree->size_ratio - 1
+                                                            : min(options.runs_per_level, lsmtree->size_ratio - 1);
+    lsmtree->bloom_fpr = options.bloom_fpr;
+    lsmtree->tombstone_ratio = options.tombstone_compaction_ratio;
+    lsmtree->sst_index = options.sst_index;
+    if (options.partitioned_levels) {
+        // Partitions end on a page boundary, so that they have no padding
+        lsmtree->partition_size = max(options.sst_partition_size / constants::PAGE_SIZE, (size_t)1) * constants::KEYS_PER_NODE;
+    }
 
-    if (db_exist) {
-        // Restoring the sorted list of existing SST files when reopen DB
-        vector<fs::path> sorted_dir;
-        for (auto& file_path : fs::directory_iterator(lsmtree->sst_path)) {
-            sorted_dir.push_back(file_path.path().filename());
-        }
-        if (sorted_dir.size() == 0) return;
-        sort(sorted_dir.begin(), sorted_dir.end());
-        size_t cur_level;
-        for (auto file_path_itr = sorted_dir.begin(); file_path_itr != sorted_dir.end(); ++file_path_itr) {
-            lsmtree->parse_SST_level(*file_path_itr, cur_level);
-            lsmtree->levels[cur_level].sorted_dir.push_back(*file_path_itr);
-            ++lsmtree->levels[cur_level].cur_size;
-        }
-        lsmtree->levels[0].last_level = false;
-        lsmtree->levels[cur_level].last_level = true;
-        lsmtree->num_levels = cur_level + 1;
-
-        /* Since we change the name of the last_level's SST in closeDB(), we need
-           to change it back.
-        */
-        Level& last_level = lsmtree->levels[lsmtree->num_levels - 1];
-        if (last_level.sorted_dir.size() > 0) {
-            #ifdef ASSERT
-                assert(last_level.sorted_dir.size() == 1);
-            #endif
-            string old_name = string(last_level.sorted_dir[0]);
-            // Parse the last level's size
-            int first = old_name.rfind('_');
-            int second = old_name.rfind('.');
-            last_level.cur_size = stoi(old_name.substr(first + 1, second - first - 1));
-
-            // Change back to the original filename format
-            string new_name = old_name.substr(0, first).append(".bytes");
-            rename((lsmtree->sst_path / old_name).c_str(), (lsmtree->sst_path / new_name).c_str());
-            last_level.sorted_dir[0] = new_name;
-        }
+    // Segments left behind mean the DB was not closed properly: their memtables never made it into SSTs
+    vector<fs::path> old_segments = WAL::find_segments(directoryPath / "wal");
+    // The levels are those of the last version in the MANIFEST. After a crash, the SST directories may also hold
+    // SSTs that no version lists, half-written or compacted away
+    bool restored = lsmtree->restore_levels();
+    if (db_exist && (!restored || !old_segments.empty())) {
+        lsmtree->remove_orphans();
+    }
+
+    lsmtree->start_compaction();
+    stop_flush = false;
+    flush_thread = thread(&Database::flush_worker, this);
+
+    wal = new WAL(directoryPath / "wal", options.wal_sync_policy, options.wal_sync_interval_ms);
+    replay_wal(old_segments);
+}
+
+/* Rebuild the memtables from the log segments of the previous run, oldest first.
+   The records are logged again into the new segments, so the old ones can go once those are synced */
+void Database::replay_wal(const vector<fs::path>& segments) {
+    if (segments.empty()) return;
+    for (const fs::path& segment : segments) {
+        WAL::replay(segment, [this](const pair<int64_t, int64_t>* KVs, const size_t& count, const bool& range_delete) {
+            if (range_delete) {
+                log_and_delete_range(KVs[0].first, KVs[0].second);
+            } else if (count == 1) {
+                log_and_insert(KVs[0].first, KVs[0].second);
+            } else {
+                log_and_insert(KVs, count);
+            }
+        });
+    }
+    wal->sync();
+    for (const fs::path& segment : segments) {
+        fs::remove(segment);
     }
 }
 
 void Database::closeDB() {
+    // Let the flush thread drain the immutable memtables first, so that SSTs are added in order
+    {
+        unique_lock<shared_mutex> lock(memtable_mutex);
+        stop_flush = true;
+    }
+    flush_cv.notify_all();
+    flush_thread.join();
+
     if (memtable->curr_size > 0) {
-        string file_path = writeToSST();
-
-        /* For the purpose of reopen the DB in the future, we need to record the
-           size of the largest level, because it only has one big contiguous SST
-           in Dostoevsky (without this record, we can't tell if the last level
-           reaches capacity or not).
-        */
-        Level& last_level = lsmtree->levels[lsmtree->num_levels - 1];
-        string old_name = string(last_level.sorted_dir[0]);
-        #ifdef ASSERT
-            assert(last_level.sorted_dir.size() == 1);
-        #endif
-        // We add the current size of the last_level to its filename
-        // New format: <level>_<time><clock>_<min>_<max>_<BTree leaf end>_<level size>.bytes
-        string new_name = old_name.substr(0, old_name.find('.')).append("_")
-                                                                .append(to_string(last_level.cur_size))
-                                                                .append(".bytes");
-        rename((lsmtree->sst_path / old_name).c_str(), (lsmtree->sst_path / new_name).c_str());
+        string file_path = writeToSST(memtable);
     }
+    // Every memtable is in an SST now, so the log is not needed anymore
+    wal->release_all();
+    // Wait for the background compactions to finish, so the last level is one contiguous run again
+    lsmtree->stop_compaction();
+
+    if (wal) delete wal;
     if (memtable) delete memtable;
+    if (spare_memtable) delete spare_memtable;
     if (lsmtree) delete lsmtree;
     if (bufferpool) delete bufferpool;
 }
 
 /*  API for put: insert a key-value pair into the database.
-    If memtable is not full, we will directly insert into memtable, otherwise,
-    flush the full memtable into SST and push to the empty memtable */
+    The pair is logged into the WAL first, and put() returns once the log is as durable
+    as the sync policy promises. With a concurrent memtable, several threads can put at
+    the same time, and their log records are synced together */
 void Database::put(const int64_t& key, const int64_t& value) {
-    if (memtable->put(key, value) == memtableFull) {
-        string file_path = writeToSST();
+    uint64_t seq = log_and_insert(key, value);
+    wal->commit(seq);
+}
+
+/* Log the pair and insert it into the memtable. If memtable is not full, we will directly insert
+   into memtable, otherwise, hand the full memtable to the flush thread and insert into an empty one.
+   Return: the sequence number of the log record */
+uint64_t Database::log_and_insert(const int64_t& key, const int64_t& value) {
+    while (true) {
+        Result result = memtableFull;
+        uint64_t seq = 0;
+        // The record is appended under the same lock as the insert, so it goes to the segment of this memtable
+        if (memtable->concurrent()) {
+            shared_lock<shared_mutex> lock(memtable_mutex);
+            if (memtable->curr_size < memtable->max_size) {
+                seq = wal->append(key, value);
+                result = memtable->put(key, value);
+            }
+        } else {
+            unique_lock<shared_mutex> lock(memtable_mutex);
+            if (options.append_mode) switch_append_mode(key, 1, lock);
+            if (memtable->curr_size < memtable->max_size) {
+                seq = wal->append(key, value);
+                result = memtable->put(key, value);
+            }
+        }
+        // A record logged for a memtable that filled up in the meantime is logged again below; replaying both is harmless
+        if (result != memtableFull) return seq;
+
+        // Swapping needs exclusive access. Another writer may have swapped while we waited for the lock.
+        unique_lock<shared_mutex> lock(memtable_mutex);
+        if (memtable->curr_size >= memtable->max_size) {
+            swap_memtable(lock);
+        }
+    }
+}
+
+/* Log a sorted chunk of a WriteBatch as a single record and insert it into the memtable.
+   The whole chunk goes into one memtable (swapping it first if the chunk might not fit),
+   under the exclusive lock, so readers never see half of it.
+   Return: the sequence number of the log record */
+uint64_t Database::log_and_insert(const pair<int64_t, int64_t>* sorted_KV, const size_t& count) {
+    unique_lock<shared_mutex> lock(memtable_mutex);
+    if (options.append_mode) switch_append_mode(sorted_KV[0].first, count, lock);
+    // Keys already in the memtable do not take more room, so this may swap a bit early
+    if (memtable->curr_size > 0 && memtable->curr_size + count > memtable->max_size) {
+        swap_memtable(lock);
+    }
+    uint64_t seq = wal->append(sorted_KV, count);
+    memtable->put_sorted(sorted_KV, count);
+    return seq;
+}
+
+/* Log a range delete and apply it to the memtable, under the exclusive lock so readers never see half of it.
+   The memtable gets point tombstones on both ends of the range, room is made for them first.
+   Return: the sequence number of the log record */
+uint64_t Database::log_and_delete_range(const int64_t& key1, const int64_t& key2) {
+    unique_lock<shared_mutex> lock(memtable_mutex);
+    // An append table only takes increasing keys. Leaving may wait for a flush, and another writer may start a new one
+    while (append_table != nullptr) {
+        leave_append_mode(lock);
+    }
+    if (memtable->curr_size > 0 && memtable->curr_size + 2 > memtable->max_size) {
+        swap_memtable(lock);
+    }
+    uint64_t seq = wal->append_range_delete(key1, key2);
+    memtable->delete_range(key1, key2);
+    return seq;
+}
+
+/* Create an empty memtable of the type chosen in openDB */
+Memtable* Database::new_memtable() {
+    if (options.memtable_type == skiplist_memtable) {
+        return new SkipList(memtable_capacity);
+    }
+    return new RBTree(memtable_capacity, memtable_root);
+}
+
+/* The regular memtable to switch to: the spare one if there is one, a new one otherwise */
+Memtable* Database::take_memtable() {
+    if (spare_memtable == nullptr) return new_memtable();
+    Memtable* table = spare_memtable;
+    table->max_size = memtable_capacity; // The budget may have changed since it was created
+    spare_memtable = nullptr;
+    return table;
+}
+
+/* Turn the full memtable into an immutable one and hand it over to the flush thread.
+   If too many memtables are already waiting to be flushed, block until one is done.
+   The caller must hold memtable_mutex exclusively */
+void Database::swap_memtable(unique_lock<shared_mutex>& lock) {
+    stall_cv.wait(lock, [this] { return immutable_memtables.size() < options.max_immutable_memtables; });
+    // Another writer may have swapped while we waited
+    if (memtable->curr_size == 0) return;
+    #ifdef DEBUG
+        cout << "Memtable capacity reaches maximum. Scheduling a flush..." << endl;
+    #endif
+    immutable_memtables.push_back(memtable);
+    wal->roll();
+    memtable = take_memtable();
+    append_table = nullptr;
+    flush_cv.notify_one();
+}
+
+/*  Append mode: before count sorted pairs starting with key are put, switch to an append table if they are the first
+    pairs of the memtable and come after every key of the database, and back to a regular memtable if they do not
+    come after the last key appended (or do not fit). An append table is single-writer, so a concurrent memtable is
+    never switched. Caller must hold memtable_mutex exclusively */
+void Database::switch_append_mode(const int64_t& key, const size_t& count, unique_lock<shared_mutex>& lock) {
+    // Leaving may wait for a flush without the lock, and another writer may start a new append table meanwhile
+    while (append_table != nullptr && !append_table->accepts(key, count)) {
+        leave_append_mode(lock);
+    }
+    if (append_table != nullptr || memtable->curr_size > 0 || memtable->concurrent()) return;
+    for (Memtable* table : immutable_memtables) {
+        if (table->has_key_from(key)) return;
+    }
+    if (!lsmtree->keys_below(key)) return;
+    AppendTable* table = new AppendTable(memtable_capacity);
+    if (!table->accepts(key, count)) {
+        delete table;
+        return;
+    }
+    // The empty memtable is kept for when append mode ends
+    if (spare_memtable == nullptr) {
+        spare_memtable = memtable;
+    } else {
+        delete memtable;
+    }
+    memtable = append_table = table;
+}
+
+/*  Keys stopped coming in order: go back to a regular memtable. An append table that does not fill a page yet is
+    poured into it (within the same log segment), so that a load that is not monotonic leaves no tiny SSTs behind;
+    a larger one is handed over to the flush thread. Caller must hold memtable_mutex exclusively */
+void Database::leave_append_mode(unique_lock<shared_mutex>& lock) {
+    if (append_table->curr_size >= constants::KEYS_PER_NODE) {
+        swap_memtable(lock);
+        return;
+    }
+    memtable = take_memtable();
+    memtable->put_sorted(append_table->sorted_KV.data, append_table->sorted_KV.len);
+    delete append_table;
+    append_table = nullptr;
+}
+
+/* Background thread that writes the immutable memtables into SSTs, oldest first */
+void Database::flush_worker() {
+    while (true) {
+        Memtable* table;
+        {
+            unique_lock<shared_mutex> lock(memtable_mutex);
+            flush_cv.wait(lock, [this] { return stop_flush || !immutable_memtables.empty(); });
+            if (immutable_memtables.empty()) return; // Asked to stop and nothing left to flush
+            table = immutable_memtables.front();
+        }
+
+        // The immutable memtable is read-only, so readers can keep using it while we flush
+        string file_path = writeToSST(table);
         #ifdef DEBUG
-            cout << "Memtable capacity reaches maximum. Data has been " <<
-                    "saved to: " << file_path << endl;
+            cout << "Immutable memtable has been saved to: " << file_path << endl;
         #endif
 
-        memtable->put(key, value);
+        // The SST is now visible in the LSM-Tree, so the memtable can be retired
+        {
+            unique_lock<shared_mutex> lock(memtable_mutex);
+            immutable_memtables.pop_front();
+            wal->release_oldest();
+            table->clear();
+            if (spare_memtable == nullptr && dynamic_cast<AppendTable*>(table) == nullptr) {
+                spare_memtable = table;
+            } else {
+                delete table;
+            }
+        }
+        stall_cv.notify_all();
     }
 }
-
 /*  API for get: return the value of the key
-    First check the memtable, then SSTs. Check if the key is already deleted before returing */
-const int64_t* Database::get(const int64_t& key, const bool use_btree){
+    First check the memtable, then the immutable memtables (newest first), then SSTs.
+    A source that does not hold the key but has a range tombstone over it ends the search: the key was deleted.
+    Check if the key is already deleted before returing */
+const int64_t* Database::get(const int64_t& key, const bool use_btree) {
+    return get(key, use_btree ? search_btree : search_binary);
+}
+
+const int64_t* Database::get(const int64_t& key, const SearchMode mode) {
     int64_t* result;
-    if(memtable->get(result, key) == notInMemtable) {
-        return lsmtree->get(key, use_btree);
+    shared_lock<shared_mutex> lock(memtable_mutex);
+    Result found = memtable->get(result, key);
+    bool range_deleted = (found == notInMemtable) && memtable->range_tombstones.covers(key);
+    for (auto table = immutable_memtables.rbegin(); found == notInMemtable && !range_deleted && table != immutable_memtables.rend(); ++table) {
+        found = (*table)->get(result, key);
+        range_deleted = (found == notInMemtable) && (*table)->range_tombstones.covers(key);
+    }
+    if (range_deleted) return nullptr;
+    if(found == notInMemtable) {
+        return lsmtree->get(key, mode);
     }
     if(*result == constants::TOMBSTONE){
         #ifdef DEBUG
@@ -137,21 +351,40 @@ const int64_t* Database::get(const int64_t& key, const bool use_btree){
 }
 
 /*  API for scan: return a pointer to an array containing KV-pairs that are within the range, from key1 to key2.
-    First scan the memtable, then scan all SSTs from youngest to oldest, will merge-sort the results in lsmtree->scan.
+    First scan the memtable and the immutable memtables, then scan all SSTs from youngest to oldest,
+    and merge all the results at once with a k-way merge.
     Lastly, remove all deleted values from results before returing */
 const vector<pair<int64_t, int64_t>>* Database::scan(const int64_t& key1, const int64_t& key2, const bool use_btree) {
+    return scan(key1, key2, use_btree ? search_btree : search_binary);
+}
+
+const vector<pair<int64_t, int64_t>>* Database::scan(const int64_t& key1, const int64_t& key2, const SearchMode mode) {
     // Check if key1 < key2
     #ifdef ASSERT
         assert(key1 < key2);
     #endif
 
     vector<pair<int64_t, int64_t>>* sorted_KV = new vector<pair<int64_t, int64_t>>;
+    shared_lock<shared_mutex> lock(memtable_mutex);
+
+    vector<size_t> run_ends; // Every source is scanned into a sorted run of its own, newest first
+    vector<RangeTombstones> run_ranges; // The range tombstones of each run
 
     // Scan the memtable
-    memtable->scan(*sorted_KV, memtable->root, key1, key2);
+    memtable->scan(*sorted_KV, key1, key2);
+    run_ends.emplace_back(sorted_KV->size());
+    run_ranges.emplace_back(memtable->range_tombstones);
+
+    // Scan the immutable memtables from youngest to oldest
+    for (auto table = immutable_memtables.rbegin(); table != immutable_memtables.rend(); ++table) {
+        (*table)->scan(*sorted_KV, key1, key2);
+        run_ends.emplace_back(sorted_KV->size());
+        run_ranges.emplace_back((*table)->range_tombstones);
+    }
 
-    // Scan each SST
-    lsmtree->scan(sorted_KV, key1, key2, use_btree);
+    // Scan each SST, then merge all the runs (newer entries win, and hide the older ones their ranges cover)
+    lsmtree->scan(sorted_KV, run_ends, run_ranges, key1, key2, mode);
+    lsmtree->merge_scan_results(sorted_KV, run_ends, run_ranges);
     removeTombstones(sorted_KV, constants::TOMBSTONE);
     return sorted_KV;
 }
@@ -172,99 +405,303 @@ void Database::del(const int64_t& key){
     put(key, constants::TOMBSTONE);
 }
 
+/*  API for range delete: delete every key in [key1, key2] without looking them up. The range is kept as a range
+    tombstone, by the memtable and then by the SST it is flushed to, which hides the keys of the older data from get()
+    and scan(). Compactions drop the pairs it covers, and the range itself once it reaches the last level */
+void Database::delete_range(const int64_t& key1, const int64_t& key2) {
+    #ifdef ASSERT
+        assert(key1 <= key2);
+    #endif
+    uint64_t seq = log_and_delete_range(key1, key2);
+    wal->commit(seq);
+}
+
+/*  API for write: apply all the puts and deletes of a batch.
+    The batch is sorted once, then inserted into the memtable in key order with a single capacity check,
+    and logged as a single WAL record. A batch larger than the memtable is applied in memtable-sized chunks,
+    and is only atomic chunk by chunk */
+void Database::write(WriteBatch& batch) {
+    batch.sort();
+    uint64_t seq = 0;
+    size_t chunk_size = memtable_capacity;
+    for (size_t i = 0; i < batch.size(); i += chunk_size) {
+        seq = log_and_insert(batch.entries.data() + i, min(chunk_size, batch.size() - i));
+    }
+    if (seq > 0) wal->commit(seq);
+}
+
+/*  API for bulk ingestion: load a file of KV-pairs sorted by key, laid out like the SST leaves
+    (pair<int64_t, int64_t> after pair<int64_t, int64_t>), without going through the memtable */
+void Database::ingest_sorted(const fs::path& file_path) {
+    int fd = open(file_path.c_str(), O_RDONLY);
+    #ifdef ASSERT
+        assert(fd != -1);
+    #endif
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    vector<pair<int64_t, int64_t>> buffer(constants::INGEST_READ_SIZE / constants::PAIR_SIZE);
+    size_t len = 0, pos = 0;
+    off_t offset = 0;
+    ingest_sorted([&](pair<int64_t, int64_t>& KV) {
+        if (pos == len) {
+            ssize_t nbytes = pread(fd, (char*)buffer.data(), buffer.size() * constants::PAIR_SIZE, offset);
+            if (nbytes < constants::PAIR_SIZE) return false;
+            len = nbytes / constants::PAIR_SIZE;
+            pos = 0;
+            offset += len * constants::PAIR_SIZE;
+        }
+        KV = buffer[pos++];
+        return true;
+    }, fs::file_size(file_path) / constants::PAIR_SIZE);
+    close(fd);
+}
+
+/*  API for bulk ingestion: next() fills in the next KV-pair of a stream sorted by key, and returns false at its end.
+    If a key appears several times in a row, the last one wins. expected_count sizes the Bloom Filter.
+    The stream is written straight into a single SST, which is then placed as deep in the LSM-Tree as its
+    key range allows, so its pairs are not rewritten by every level on the way down.
+    Ingested pairs overwrite anything written before the call */
+void Database::ingest_sorted(const function<bool(pair<int64_t, int64_t>&)>& next, const size_t& expected_count) {
+    // Build the SST (with its B-Tree and Bloom Filter) on the fly, without holding any lock
+    size_t level = lsmtree->ingest_level(expected_count);
+    SSTBuilder builder(*lsmtree, level, max(expected_count, (size_t)constants::KEYS_PER_NODE), max((size_t)lsmtree->num_levels, level + 1));
+    pair<int64_t, int64_t> KV, last_KV;
+    bool has_last = false;
+    while (next(KV)) {
+        #ifdef ASSERT
+            assert(!has_last || KV.first >= last_KV.first);
+        #endif
+        if (has_last && KV.first != last_KV.first) builder.add(last_KV);
+        last_KV = KV;
+        has_last = true;
+    }
+    if (has_last) builder.add(last_KV);
+    string file_name = builder.finish();
+    if (file_name.empty()) return;
+
+    // The memtables hold newer pairs than the LSM-Tree. If they overlap the SST, flush them first,
+    // so that the ingested pairs can be placed above everything they overwrite
+    unique_lock<shared_mutex> lock(memtable_mutex);
+    vector<pair<int64_t, int64_t>> overlap;
+    bool range_overlap = memtable->range_tombstones.overlaps(builder.min_key, builder.max_key);
+    memtable->scan(overlap, builder.min_key, builder.max_key);
+    for (Memtable* table : immutable_memtables) {
+        table->scan(overlap, builder.min_key, builder.max_key);
+        range_overlap = range_overlap || table->range_tombstones.overlaps(builder.min_key, builder.max_key);
+    }
+    if (!overlap.empty() || range_overlap) {
+        if (memtable->curr_size > 0) swap_memtable(lock);
+        stall_cv.wait(lock, [this] { return immutable_memtables.empty(); });
+    }
+    lsmtree->ingest_SST(file_name, builder.total_count);
+}
+
+/*  API to change the memtable budget at runtime, e.g. a write-heavy phase can use a much larger memtable
+    to flush (and therefore compact) less often.
+    bytes: size of the KV-pairs a memtable holds, that is of the leaves of its SST.
+    The active memtable takes the new budget right away, and is handed to the flush thread if it is already over it */
+void Database::set_memtable_budget(const size_t& bytes) {
+    unique_lock<shared_mutex> lock(memtable_mutex);
+    memtable_capacity = max(bytes / constants::PAIR_SIZE, (size_t)1);
+    lsmtree->memtable_capacity = memtable_capacity.load();
+    memtable->max_size = memtable_capacity;
+    if (memtable->curr_size > 0 && memtable->curr_size >= memtable->max_size) {
+        swap_memtable(lock);
+    }
+}
+
 /* When memtable reaches its capacity, write it into an SST
- * File name format: timeclock_min_max_leaf-end-offset.bytes
+ * File layout: |....leaves....|...B-Tree non-leaf nodes...|footer|
+ *
+ * The flush is a pipeline: this thread scans the memtable into the leaves, a writer thread writes
+ * every FLUSH_CHUNK_SIZE scanned pairs to the file right away, and an indexer thread sets the Bloom
+ * Filter bits and collects the B-Tree non-leaf keys from the same chunks. Only the non-leaf nodes and
+ * the filter are left to write once the scan is over.
  */
-string Database::writeToSST() {
+string Database::writeToSST(Memtable* table) {
+    AppendTable* appended = dynamic_cast<AppendTable*>(table);
+    if (appended != nullptr) return writeAppendedToSST(appended);
+
+    // The memtable is immutable, so its size is the exact number of pairs flushed. Leave room for the padding
+    size_t num_entries = table->curr_size;
+    size_t num_pages = (num_entries + constants::KEYS_PER_NODE - 1) / constants::KEYS_PER_NODE;
     // Content in std::vector is stored contiguously
-    aligned_KV_vector sorted_KV(constants::MEMTABLE_SIZE); // Stores all non-leaf elements
+    aligned_KV_vector sorted_KV(num_pages * constants::KEYS_PER_NODE);
     BTree btree;
-    int32_t leaf_ends; // Stores the file offset of the end of leaf nodes
-    scan_memtable(sorted_KV, memtable->root);
-    
-    // Check if we need to perform compaction in LSMTree
-    bool ifCompact = lsmtree->check_LSMTree_compaction();
-
-    // Create a Bloom Filter for the SST
-    ++lsmtree->levels[0].cur_size; // We need to increment cur_size here because the Bloom Filter needs it
-    BloomFilter bloom_filter(lsmtree->calculate_sst_size(lsmtree->levels[0]), 0, lsmtree->num_levels);
 
-    // We only build up the BTree if we do not need any compaction
-    if (ifCompact) {
-        leaf_ends = btree.convertToBTree(sorted_KV, bloom_filter);
-    } else {
-        leaf_ends = sorted_KV.size() * constants::PAIR_SIZE;
-        // We pad repeated last element to make it 4kb aligned
-        if ((int32_t)sorted_KV.size() % constants::KEYS_PER_NODE != 0) {
-            sorted_KV.add_padding();
+    // Progress of the scan, shared with the writer and the indexer
+    mutex scan_mutex;
+    condition_variable scan_cv;
+    size_t scanned = 0;
+    bool scan_done = false;
+    auto publish = [&](const size_t& count, const bool& done) {
+        {
+            unique_lock<mutex> lock(scan_mutex);
+            scanned = count;
+            scan_done = done;
         }
-    }
+        scan_cv.notify_all();
+    };
+    // Wait for pairs past the consumed ones. Return: the end of the scanned pairs (consumed, once there is nothing left)
+    auto wait_scanned = [&](const size_t& consumed) {
+        unique_lock<mutex> lock(scan_mutex);
+        scan_cv.wait(lock, [&] { return scanned > consumed || scan_done; });
+        return scanned;
+    };
 
-    // Create file name based on current time
-    string SST_path = lsmtree->sst_path;
-    string filter_path = lsmtree->filter_path;
-    string file_name;
-    if (ifCompact)
-        file_name = lsmtree->generate_filename(0, memtable->min_key, memtable->max_key, leaf_ends);
-    else
-        // If the file will be compated further, we randomly assign it two equal min&max keys
-        file_name = lsmtree->generate_filename(0, constants::TOMBSTONE, constants::TOMBSTONE, leaf_ends);
-    SST_path.append(file_name);
-    filter_path.append(file_name);
-
-    // Write data structure to binary file
-    int fd = open(SST_path.c_str(), O_WRONLY | O_CREAT | O_SYNC | O_DIRECT, 0777);
+    // The SST is written under a temporary name, so that a half-written SST is never picked up
+    fs::path temp_path = SSTBuilder::new_temp_path(lsmtree->sst_path);
+    int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_SYNC | O_DIRECT, 0777);
     #ifdef ASSERT
         assert(fd!=-1);
     #endif
 
-    int nbytes;
-    int64_t offset = 0;
-    // Write clustered leaves
-    nbytes = pwrite(fd, (char*)sorted_KV.data, sorted_KV.size()*constants::PAIR_SIZE, offset);
-    #ifdef ASSERT
-        assert(nbytes == (int)(sorted_KV.size()*constants::PAIR_SIZE));
-    #endif
+    // Write clustered leaves. Chunks are whole pages, as O_DIRECT requires
+    thread writer([&] {
+        size_t end;
+        for (size_t written = 0; (end = wait_scanned(written)) > written; written = end) {
+            int nbytes = pwrite(fd, (char*)(sorted_KV.data + written), (end - written) * constants::PAIR_SIZE, written * constants::PAIR_SIZE);
+            #ifdef ASSERT
+                assert(nbytes == (int)((end - written) * constants::PAIR_SIZE));
+            #endif
+        }
+    });
 
-    if (ifCompact) {
-        offset += nbytes;
-        // Write non-leaf levels, starting from root
-        btree.write_non_leaf_nodes_to_storage(fd, offset);
+    // Create a Bloom Filter for the SST
+    // Since compactions run in the background, the SST is visible to readers until it is compacted,
+    // so it always gets its B-Tree and Bloom Filter, even if it is about to be merged
+    BloomFilter bloom_filter(num_entries, lsmtree->bits_per_entry(0, lsmtree->num_levels));
+    thread indexer([&] {
+        vector<int64_t> non_leaf_keys; // Last key of every leaf page
+        non_leaf_keys.reserve(num_pages);
+        size_t end;
+        size_t indexed = 0;
+        for (; (end = wait_scanned(indexed)) > indexed; indexed = end) {
+            for (size_t i = indexed; i < end; ++i) {
+                // Keys are unique, so a repeated key is the padding of the last page
+                if (i == 0 || sorted_KV.data[i].first != sorted_KV.data[i - 1].first) {
+                    bloom_filter.set(sorted_KV.data[i].first);
+                    if (sorted_KV.data[i].second == constants::TOMBSTONE) ++bloom_filter.num_tombstones;
+                }
+                if (i % constants::KEYS_PER_NODE == constants::KEYS_PER_NODE - 1) {
+                    non_leaf_keys.emplace_back(sorted_KV.data[i].first);
+                }
+            }
+        }
+        btree.convertToBtree(non_leaf_keys, indexed);
+    });
+
+    table->scan_all(sorted_KV, [&](const size_t& count) { publish(count, false); });
+    int64_t min_key = sorted_KV.data[0].first;
+    int64_t max_key = sorted_KV.back().first;
+    // We pad repeated last element to form a complete leaf node
+    if (sorted_KV.size() % constants::KEYS_PER_NODE != 0) {
+        sorted_KV.add_padding();
     }
+    publish(sorted_KV.size(), true);
+    writer.join();
+    indexer.join();
+
+    // Write non-leaf levels, starting from root, then the footer
+    int64_t leaf_ends = sorted_KV.size() * constants::PAIR_SIZE; // The file offset of the end of leaf nodes
+    int64_t offset = leaf_ends;
+    btree.write_non_leaf_nodes_to_storage(fd, offset);
+    SSTFooter footer;
+    footer.num_entries = num_entries;
+    footer.min_key = min_key;
+    footer.max_key = max_key;
+    footer.leaf_end = leaf_ends;
+    footer.index_end = offset;
+    footer.filter_num_cache_lines = bloom_filter.total_num_cache_lines;
+    footer.filter_num_of_hashes = bloom_filter.num_of_hashes;
+    BTree::write_footer(fd, footer);
 
     int close_res = close(fd);
     #ifdef ASSERT
         assert(close_res != -1);
     #endif
 
-    if (ifCompact) {
-        // Write Bloom Filter to storage
-        bloom_filter.writeToStorage(filter_path);
-    }
+    string file_name = lsmtree->new_SST_name();
+    string SST_path = lsmtree->sst_path / file_name;
+    int rename_res = rename(temp_path.c_str(), SST_path.c_str());
+    #ifdef ASSERT
+        assert(rename_res == 0);
+    #endif
 
-    // Add to the maintained directory list
-    lsmtree->add_SST(file_name);
+    // Write Bloom Filter to storage, the range tombstones of the memtable go with it
+    bloom_filter.range_tombstones = table->range_tombstones;
+    bloom_filter.writeToStorage(lsmtree->filter_path / file_name);
+    lsmtree->sync_SST_dirs();
 
-    // Clear the memtable
-    clear_tree();
+    // Add to the maintained directory list, this may schedule compactions (or stall on compaction debt)
+    lsmtree->add_SST(file_name);
 
     return SST_path;
 }
 
-/* Helper function to recursively perform inorder scan */
-void Database::scan_memtable(aligned_KV_vector& sorted_KV, Node* root) {
-    if (root != nullptr) {
-        scan_memtable(sorted_KV, root->left);
-        sorted_KV.emplace_back(root->key, root->value);
-        scan_memtable(sorted_KV, root->right);
+/*  Flush an append table. Its array already holds the leaves of the SST, in key order and page-aligned, so it is
+    written as it is with a single write, once its last page is padded in place; only the Bloom Filter and the
+    non-leaf nodes are built. Its keys come after everything that was in the LSM-Tree when it was started, so
+    the SST goes to the last level without being merged (see LSMTree::ingest_SST) */
+string Database::writeAppendedToSST(AppendTable* table) {
+    aligned_KV_vector& leaves = table->sorted_KV;
+    size_t num_entries = leaves.len;
+    size_t padded_count = (num_entries + constants::KEYS_PER_NODE - 1) / constants::KEYS_PER_NODE * constants::KEYS_PER_NODE;
+    // Readers only look at the first len pairs, so the padding can go past them while the table is still readable
+    for (size_t i = num_entries; i < padded_count; ++i) {
+        leaves.data[i] = leaves.data[num_entries - 1];
     }
-}
+    int64_t min_key = leaves.data[0].first;
+    int64_t max_key = leaves.data[num_entries - 1].first;
 
-/* Clear all the nodes in the tree */
-void Database::clear_tree() {
-    delete memtable->root;
-    memtable->root = nullptr;
-    memtable->curr_size = 0;
-    memtable->min_key = numeric_limits<int64_t>::max();
-    memtable->max_key = numeric_limits<int64_t>::min();
-}
\ No newline at end of file
+    size_t level = lsmtree->num_levels - 1;
+    BloomFilter bloom_filter(num_entries, lsmtree->bits_per_entry(level, lsmtree->num_levels));
+    vector<int64_t> non_leaf_keys; // Last key of every leaf page
+    non_leaf_keys.reserve(padded_count / constants::KEYS_PER_NODE);
+    for (size_t i = 0; i < num_entries; ++i) {
+        bloom_filter.set(leaves.data[i].first);
+        if (leaves.data[i].second == constants::TOMBSTONE) ++bloom_filter.num_tombstones;
+    }
+    for (size_t i = constants::KEYS_PER_NODE - 1; i < padded_count; i += constants::KEYS_PER_NODE) {
+        non_leaf_keys.emplace_back(leaves.data[i].first);
+    }
+    BTree btree;
+    btree.convertToBtree(non_leaf_keys, padded_count);
+
+    fs::path temp_path = SSTBuilder::new_temp_path(lsmtree->sst_path);
+    int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_SYNC | O_DIRECT, 0777);
+    #ifdef ASSERT
+        assert(fd != -1);
+    #endif
+    int64_t leaf_ends = padded_count * constants::PAIR_SIZE;
+    ssize_t nbytes = pwrite(fd, (char*)leaves.data, leaf_ends, 0);
+    #ifdef ASSERT
+        assert(nbytes == leaf_ends);
+    #endif
+    int64_t offset = leaf_ends;
+    btree.write_non_leaf_nodes_to_storage(fd, offset);
+    SSTFooter footer;
+    footer.num_entries = num_entries;
+    footer.min_key = min_key;
+    footer.max_key = max_key;
+    footer.leaf_end = leaf_ends;
+    footer.index_end = offset;
+    footer.filter_num_cache_lines = bloom_filter.total_num_cache_lines;
+    footer.filter_num_of_hashes = bloom_filter.num_of_hashes;
+    BTree::write_footer(fd, footer);
+    int close_res = close(fd);
+    #ifdef ASSERT
+        assert(close_res != -1);
+    #endif
+
+    string file_name = lsmtree->new_SST_name();
+    int rename_res = rename(temp_path.c_str(), (lsmtree->sst_path / file_name).c_str());
+    #ifdef ASSERT
+        assert(rename_res == 0);
+    #endif
+    bloom_filter.writeToStorage(lsmtree->filter_path / file_name);
+    lsmtree->sync_SST_dirs();
+
+    // Placed as deep as its key range allows, this may schedule compactions
+    lsmtree->ingest_SST(file_name, num_entries);
+    return lsmtree->sst_path / file_name;
+}
@@ -0,0 +1,42 @@
+#include <iostream>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cassert>
+#include "filterReader.h"
+#include "bloomFilter.h"
+#include "util.h"
+using namespace std;
+
+FilterReader::FilterReader(const fs::path& filter_path) {
+    fd = open(filter_path.c_str(), O_RDONLY);
+    #ifdef ASSERT
+        assert(fd != -1);
+    #endif
+    BloomFilterHeader header;
+    int nbytes = pread(fd, (char*)&header, sizeof(BloomFilterHeader), 0);
+    #ifdef ASSERT
+        assert(nbytes == (int)sizeof(BloomFilterHeader));
+    #endif
+    num_cache_lines = header.num_cache_lines;
+    num_of_hashes = header.num_of_hashes;
+}
+
+FilterReader::~FilterReader() {
+    close(fd);
+}
+
+/* Same probe as LSMTree::check_bloomFilter, the cachelines come after the header page */
+bool FilterReader::may_contain(const int64_t& key) {
+    size_t cache_line_hash = murmur_hash(key, 0) % num_cache_lines;
+    bitset<constants::CACHE_LINE_SIZE_BITS> cache_line;
+    int nbytes = pread(fd, (char*)&cache_line, constants::CACHE_LINE_SIZE_BYTES,
+                       constants::PAGE_SIZE + (cache_line_hash << constants::CACHE_LINE_SIZE_BYTES_SHIFT));
+    #ifdef ASSERT
+        assert(nbytes == (int)constants::CACHE_LINE_SIZE_BYTES);
+    #endif
+    for (uint32_t i = 1; i <= num_of_hashes; ++i) {
+        size_t hash = murmur_hash(key, i) & ((1<<constants::CACHE_LINE_SIZE_BITS_SHIFT) - 1);
+        if (!cache_line.test(hash)) return false;
+    }
+    return true;
+}
@@ -0,0 +1,74 @@
+#include <iostream>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include "leafReader.h"
+using namespace std;
+
+LeafReader::LeafReader(const fs::path& file_path, const size_t& start, const size_t& end, const size_t& chunk_size) :
+    end(end), next_offset(start), reading_buffer(0), data(nullptr), index(0), len(0), reading(false) {
+    // O_DIRECT reads whole pages
+    this->chunk_size = max((chunk_size + constants::PAGE_SIZE - 1) / constants::PAGE_SIZE * constants::PAGE_SIZE, constants::PAGE_SIZE);
+    for (pair<int64_t, int64_t>*& buffer : buffers) {
+        buffer = new(align_val_t(constants::PAGE_SIZE)) pair<int64_t, int64_t>[this->chunk_size / constants::PAIR_SIZE];
+    }
+    fd = open(file_path.c_str(), O_RDONLY | O_DIRECT, 0777);
+    #ifdef ASSERT
+        assert(fd != -1);
+        assert(start % constants::PAGE_SIZE == 0 && end % constants::PAGE_SIZE == 0);
+    #endif
+    start_read();
+    advance();
+}
+
+LeafReader::~LeafReader() {
+    // The buffer of a read in flight cannot be freed under it
+    if (reading) wait_read();
+    close(fd);
+    for (pair<int64_t, int64_t>* buffer : buffers) {
+        ::operator delete[] (buffer, align_val_t(constants::PAGE_SIZE));
+    }
+}
+
+/* Issue the read of the next chunk into the buffer that is not being consumed */
+void LeafReader::start_read() {
+    if (next_offset >= end) return;
+    memset(&request, 0, sizeof(request));
+    request.aio_fildes = fd;
+    request.aio_buf = buffers[reading_buffer];
+    request.aio_nbytes = min(chunk_size, end - next_offset);
+    request.aio_offset = next_offset;
+    int result = aio_read(&request);
+    #ifdef ASSERT
+        assert(result == 0);
+    #endif
+    next_offset += request.aio_nbytes;
+    reading = true;
+}
+
+void LeafReader::wait_read() {
+    const struct aiocb* requests[1] = {&request};
+    while (aio_error(&request) == EINPROGRESS) {
+        aio_suspend(requests, 1, nullptr);
+    }
+    reading = false;
+}
+
+/* The current chunk is drained: switch to the chunk read ahead, and start reading the one after it */
+void LeafReader::advance() {
+    index = 0;
+    len = 0;
+    if (!reading) return; // Past the end
+    wait_read();
+    ssize_t nbytes = aio_return(&request);
+    #ifdef ASSERT
+        assert(nbytes == (ssize_t)request.aio_nbytes);
+    #endif
+    if (nbytes <= 0) return;
+    data = buffers[reading_buffer];
+    len = nbytes / constants::PAIR_SIZE;
+    reading_buffer = 1 - reading_buffer;
+    start_read();
+}
@@ -0,0 +1,51 @@
+#include <iostream>
+#include <cmath>
+#include <limits>
+#include "learnedIndex.h"
+using namespace std;
+
+/* Fit the segments greedily, in one pass over the fences: a segment keeps the range of slopes that still predict all
+ * of its fences within the error (a cone from its first fence), and a fence that no slope of the range fits starts
+ * the next segment. Fence i is the last key of page i
+ */
+void LearnedIndex::build(const vector<int64_t>& fences) {
+    segments.clear();
+    last_page = fences.size();
+    if (fences.empty()) return;
+
+    const double error = constants::LEARNED_INDEX_ERROR;
+    size_t first = 0;
+    double min_slope = 0;
+    double max_slope = numeric_limits<double>::infinity();
+    for (size_t i = 1; i < fences.size(); ++i) {
+        // Keys are unique, so dx > 0
+        double dx = (double)fences[i] - (double)fences[first];
+        double dy = (double)(i - first);
+        double low = (dy - error) / dx;
+        double high = (dy + error) / dx;
+        if (low > max_slope || high < min_slope) {
+            segments.push_back({fences[first], (int64_t)first, (min_slope + max_slope) / 2});
+            first = i;
+            min_slope = 0;
+            max_slope = numeric_limits<double>::infinity();
+            continue;
+        }
+        min_slope = max(min_slope, low);
+        max_slope = min(max_slope, high);
+    }
+    // A segment of a single fence has no upper bound on its slope
+    segments.push_back({fences[first], (int64_t)first, isinf(max_slope) ? 0 : (min_slope + max_slope) / 2});
+    segments.shrink_to_fit();
+}
+
+int64_t LearnedIndex::predict(const int64_t& key) const {
+    // Up to the first fence, the key can only be on the first page
+    auto next = upper_bound(segments.begin(), segments.end(), key,
+                            [](const int64_t& key, const Segment& segment) { return key < segment.first_key; });
+    if (next == segments.begin()) return 0;
+    const Segment& segment = *(next - 1);
+    double page = segment.first_page + segment.slope * ((double)key - (double)segment.first_key);
+    // Past the last fence of a segment, the key is at most on the first page of the next one
+    int64_t limit = (next == segments.end()) ? last_page : next->first_page;
+    return llround(min(max(page, (double)segment.first_page), (double)limit));
+}
@@ -0,0 +1,114 @@
+#include <iostream>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cassert>
+#include <cstring>
+#include "manifest.h"
+#include "MurmurHash3.h"
+using namespace std;
+
+Manifest::~Manifest() {
+    if (fd != -1) close(fd);
+}
+
+uint64_t Manifest::checksum(const char* record, const size_t& length) {
+    uint64_t hash[2];
+    MurmurHash3_x64_128(record, length, 443, hash);
+    return hash[0];
+}
+
+bool Manifest::load(ManifestRecordHeader& header, vector<ManifestFile>& files) {
+    if (!fs::exists(path)) return false;
+    // The file holds at most MANIFEST_MAX_SIZE bytes of records and one more, so it is read in one go
+    vector<char> buffer(fs::file_size(path));
+    int fd = open(path.c_str(), O_RDONLY);
+    #ifdef ASSERT
+        assert(fd != -1);
+    #endif
+    ssize_t nbytes = pread(fd, buffer.data(), buffer.size(), 0);
+    close(fd);
+    if (nbytes < 0) return false;
+
+    bool found = false;
+    size_t offset = 0;
+    while (offset + sizeof(ManifestRecordHeader) <= (size_t)nbytes) {
+        ManifestRecordHeader record = *(ManifestRecordHeader*)(buffer.data() + offset);
+        if (record.magic != constants::MANIFEST_MAGIC) break;
+        size_t length = sizeof(ManifestRecordHeader) + record.num_files * sizeof(ManifestFile);
+        // A partial or corrupted record was being written when the database crashed, its version never made it
+        if (record.num_files > ((size_t)nbytes - offset) / sizeof(ManifestFile) || length > (size_t)nbytes - offset) break;
+        ((ManifestRecordHeader*)(buffer.data() + offset))->checksum = 0;
+        if (record.checksum != checksum(buffer.data() + offset, length)) break;
+        header = record;
+        ManifestFile* record_files = (ManifestFile*)(buffer.data() + offset + sizeof(ManifestRecordHeader));
+        files.assign(record_files, record_files + record.num_files);
+        found = true;
+        offset += length;
+    }
+    if (found) version = header.version;
+    return found;
+}
+
+vector<char> Manifest::record(const uint64_t& next_file_number, const uint64_t& num_levels, const vector<ManifestFile>& files) {
+    ManifestRecordHeader header = {constants::MANIFEST_MAGIC, ++version, next_file_number, num_levels, files.size(), 0};
+    vector<char> record(sizeof(ManifestRecordHeader) + files.size() * sizeof(ManifestFile));
+    memcpy(record.data(), &header, sizeof(ManifestRecordHeader));
+    memcpy(record.data() + sizeof(ManifestRecordHeader), files.data(), files.size() * sizeof(ManifestFile));
+    header.checksum = checksum(record.data(), record.size());
+    memcpy(record.data(), &header, sizeof(ManifestRecordHeader));
+    return record;
+}
+
+void Manifest::append(const uint64_t& next_file_number, const uint64_t& num_levels, const vector<ManifestFile>& files) {
+    write(record(next_file_number, num_levels, files));
+}
+
+void Manifest::write(const vector<char>& record) {
+    lock_guard<mutex> lock(write_mutex);
+    // Records may come in out of order once built: the newer version written meanwhile already holds this one
+    uint64_t record_version = ((const ManifestRecordHeader*)record.data())->version;
+    if (record_version <= written_version) return;
+    written_version = record_version;
+
+    if (fd == -1 || size + record.size() > constants::MANIFEST_MAX_SIZE) {
+        rewrite(record);
+        return;
+    }
+    ssize_t nbytes = ::write(fd, record.data(), record.size());
+    #ifdef ASSERT
+        assert(nbytes == (ssize_t)record.size());
+    #endif
+    fdatasync(fd);
+    size += record.size();
+}
+
+/* Replace the file with a single record, so that a crash leaves either the old file or the new one */
+void Manifest::rewrite(const vector<char>& record) {
+    if (fd != -1) close(fd);
+    fs::path temp_path = path;
+    temp_path += ".temp";
+    int temp_fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0777);
+    #ifdef ASSERT
+        assert(temp_fd != -1);
+    #endif
+    ssize_t nbytes = ::write(temp_fd, record.data(), record.size());
+    #ifdef ASSERT
+        assert(nbytes == (ssize_t)record.size());
+    #endif
+    fdatasync(temp_fd);
+    close(temp_fd);
+    int result = rename(temp_path.c_str(), path.c_str());
+    #ifdef ASSERT
+        assert(result == 0);
+    #endif
+    // Make the rename itself durable
+    int dir_fd = open(path.parent_path().c_str(), O_RDONLY | O_DIRECTORY);
+    fsync(dir_fd);
+    close(dir_fd);
+
+    fd = open(path.c_str(), O_WRONLY | O_APPEND);
+    #ifdef ASSERT
+        assert(fd != -1);
+    #endif
+    size = record.size();
+}
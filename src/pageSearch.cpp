@@ -0,0 +1,163 @@
+#include <iostream>
+#include <cassert>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#include "pageSearch.h"
+using namespace std;
+
+// Keys of a block, the last of which the vector kernels compare first: 16 blocks make a leaf
+static const size_t BLOCK_KEYS = 16;
+static_assert(constants::KEYS_PER_NODE == 16 * BLOCK_KEYS, "The vector kernels search 16 blocks of 16 keys");
+
+/* Branch-free binary search of n keys, stride int64s apart: the base only moves by conditional moves,
+ * and the number of steps only depends on n */
+static inline size_t scalar_lower_bound(const int64_t* keys, const size_t& stride, size_t n, const int64_t& key) {
+    if (n == 0) return 0;
+    const int64_t* base = keys;
+    while (n > 1) {
+        size_t half = n / 2;
+        base = (base[half * stride] < key) ? base + half * stride : base;
+        n -= half;
+    }
+    return (base - keys) / stride + (*base < key);
+}
+
+#if defined(__x86_64__)
+/* The pairs of a leaf are 2 int64s each: the keys are the even int64s */
+__attribute__((target("avx2")))
+static size_t avx2_leaf_lower_bound(const BTreeLeafNode& leaf, const int64_t& key) {
+    const int64_t* keys = (const int64_t*)leaf.data;
+    const __m256i target = _mm256_set1_epi64x(key);
+    // Last key of every block: pair 16j + 15
+    size_t block = 0;
+    for (int j = 0; j < 16; j += 4) {
+        const __m256i index = _mm256_setr_epi64x(32 * j + 30, 32 * (j + 1) + 30, 32 * (j + 2) + 30, 32 * (j + 3) + 30);
+        __m256i last_keys = _mm256_mask_i64gather_epi64(target, (const long long*)keys, index, _mm256_set1_epi64x(-1), 8);
+        block += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(target, last_keys))));
+    }
+    // Every key is smaller: the count within the last block is 16 too
+    block = min(block, (size_t)15);
+    const int64_t* block_keys = keys + 2 * BLOCK_KEYS * block;
+    size_t count = 0;
+    for (size_t i = 0; i < 2 * BLOCK_KEYS; i += 4) {
+        __m256i pairs = _mm256_loadu_si256((const __m256i*)(block_keys + i));
+        count += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(target, pairs))) & 0b0101);
+    }
+    return BLOCK_KEYS * block + count;
+}
+
+__attribute__((target("avx2")))
+static size_t avx2_non_leaf_lower_bound(const BTreeNonLeafNode& node, const int64_t& key) {
+    const int64_t size = node.size;
+    const __m256i target = _mm256_set1_epi64x(key);
+    const __m256i lanes = _mm256_setr_epi64x(0, 1, 2, 3);
+    // Only the blocks that are full have a last key to compare
+    const __m256i full_blocks = _mm256_set1_epi64x(size / BLOCK_KEYS);
+    size_t block = 0;
+    for (int j = 0; j < 16; j += 4) {
+        const __m256i block_index = _mm256_add_epi64(lanes, _mm256_set1_epi64x(j));
+        const __m256i valid = _mm256_cmpgt_epi64(full_blocks, block_index);
+        const __m256i index = _mm256_add_epi64(_mm256_slli_epi64(block_index, 4), _mm256_set1_epi64x(15));
+        __m256i last_keys = _mm256_mask_i64gather_epi64(_mm256_setzero_si256(), (const long long*)node.keys, index, valid, 8);
+        __m256i less = _mm256_and_si256(valid, _mm256_cmpgt_epi64(target, last_keys));
+        block += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(less)));
+    }
+    // The block may be partial, its keys past the size are not compared
+    const int64_t* block_keys = node.keys + BLOCK_KEYS * block;
+    const __m256i num_keys = _mm256_set1_epi64x(size - BLOCK_KEYS * block);
+    size_t count = 0;
+    for (size_t i = 0; i < BLOCK_KEYS; i += 4) {
+        const __m256i valid = _mm256_cmpgt_epi64(num_keys, _mm256_add_epi64(lanes, _mm256_set1_epi64x(i)));
+        __m256i keys = _mm256_maskload_epi64((const long long*)(block_keys + i), valid);
+        __m256i less = _mm256_and_si256(valid, _mm256_cmpgt_epi64(target, keys));
+        count += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(less)));
+    }
+    return BLOCK_KEYS * block + count;
+}
+
+__attribute__((target("avx512f")))
+static size_t avx512_leaf_lower_bound(const BTreeLeafNode& leaf, const int64_t& key) {
+    const int64_t* keys = (const int64_t*)leaf.data;
+    const __m512i target = _mm512_set1_epi64(key);
+    const __m512i index = _mm512_setr_epi64(30, 62, 94, 126, 158, 190, 222, 254);
+    __m512i low_last_keys = _mm512_mask_i64gather_epi64(target, 0xff, index, keys, 8);
+    __m512i high_last_keys = _mm512_mask_i64gather_epi64(target, 0xff, index, keys + 256, 8);
+    size_t block = __builtin_popcount(_mm512_cmplt_epi64_mask(low_last_keys, target))
+                 + __builtin_popcount(_mm512_cmplt_epi64_mask(high_last_keys, target));
+    block = min(block, (size_t)15);
+    const int64_t* block_keys = keys + 2 * BLOCK_KEYS * block;
+    size_t count = 0;
+    for (size_t i = 0; i < 2 * BLOCK_KEYS; i += 8) {
+        count += __builtin_popcount(_mm512_mask_cmplt_epi64_mask(0x55, _mm512_loadu_si512(block_keys + i), target));
+    }
+    return BLOCK_KEYS * block + count;
+}
+
+__attribute__((target("avx512f")))
+static size_t avx512_non_leaf_lower_bound(const BTreeNonLeafNode& node, const int64_t& key) {
+    const size_t size = node.size;
+    const __m512i target = _mm512_set1_epi64(key);
+    const __m512i index = _mm512_setr_epi64(15, 31, 47, 63, 79, 95, 111, 127);
+    const uint32_t full_blocks = (1u << (size / BLOCK_KEYS)) - 1;
+    __m512i low_last_keys = _mm512_mask_i64gather_epi64(target, full_blocks & 0xff, index, node.keys, 8);
+    __m512i high_last_keys = _mm512_mask_i64gather_epi64(target, full_blocks >> 8, index, node.keys + 128, 8);
+    size_t block = __builtin_popcount(_mm512_mask_cmplt_epi64_mask(full_blocks & 0xff, low_last_keys, target))
+                 + __builtin_popcount(_mm512_mask_cmplt_epi64_mask(full_blocks >> 8, high_last_keys, target));
+    const int64_t* block_keys = node.keys + BLOCK_KEYS * block;
+    const uint32_t valid = (1u << min(size - BLOCK_KEYS * block, BLOCK_KEYS)) - 1;
+    __m512i low_keys = _mm512_maskz_loadu_epi64(valid & 0xff, block_keys);
+    __m512i high_keys = _mm512_maskz_loadu_epi64((valid >> 8) & 0xff, block_keys + 8);
+    size_t count = __builtin_popcount(_mm512_mask_cmplt_epi64_mask(valid & 0xff, low_keys, target))
+                 + __builtin_popcount(_mm512_mask_cmplt_epi64_mask((valid >> 8) & 0xff, high_keys, target));
+    return BLOCK_KEYS * block + count;
+}
+#endif
+
+SearchKernel PageSearch::best_kernel() {
+    #if defined(__x86_64__)
+        // Called before main, maybe before the CPU features are detected
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) return avx512_kernel;
+        if (__builtin_cpu_supports("avx2")) return avx2_kernel;
+    #endif
+    return scalar_kernel;
+}
+
+const SearchKernel PageSearch::kernel = PageSearch::best_kernel();
+
+bool PageSearch::supported(const SearchKernel& kernel) {
+    return kernel <= PageSearch::kernel;
+}
+
+size_t PageSearch::leaf_lower_bound(const BTreeLeafNode& leaf, const int64_t& key, const SearchKernel& kernel) {
+    #ifdef ASSERT
+        assert(supported(kernel));
+    #endif
+    switch (kernel) {
+        #if defined(__x86_64__)
+        case avx512_kernel:
+            return avx512_leaf_lower_bound(leaf, key);
+        case avx2_kernel:
+            return avx2_leaf_lower_bound(leaf, key);
+        #endif
+        default:
+            return scalar_lower_bound((const int64_t*)leaf.data, 2, constants::KEYS_PER_NODE, key);
+    }
+}
+
+size_t PageSearch::non_leaf_lower_bound(const BTreeNonLeafNode& node, const int64_t& key, const SearchKernel& kernel) {
+    #ifdef ASSERT
+        assert(supported(kernel) && node.size >= 0 && node.size <= constants::NON_LEAF_KEYS);
+    #endif
+    switch (kernel) {
+        #if defined(__x86_64__)
+        case avx512_kernel:
+            return avx512_non_leaf_lower_bound(node, key);
+        case avx2_kernel:
+            return avx2_non_leaf_lower_bound(node, key);
+        #endif
+        default:
+            return scalar_lower_bound(node.keys, 1, node.size, key);
+    }
+}
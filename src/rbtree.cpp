@@ -12,8 +12,7 @@
 #include <sstream>
 using namespace std;
 
-RBTree::RBTree(size_t capacity, Node* root): root(root), max_size{capacity} {
-    curr_size = 0;
+RBTree::RBTree(size_t capacity, Node* root): Memtable(capacity), root(root) {
     min_key = numeric_limits<int64_t>::max();
     max_key = numeric_limits<int64_t>::min();
 }
@@ -21,8 +20,8 @@ RBTree::~RBTree() {
     #ifdef DEBUG
         cout << "Deleting tree..." << endl;
     #endif
-    
-    delete root;
+
+    // All nodes are released together with the arena
     root = nullptr;
 }
 
@@ -33,12 +32,28 @@ Result RBTree::put(const int64_t& key, const int64_t& value) {
         return memtableFull;
     }
 
-    // Otherwise, insert a new node
-    Node* node = new Node(key, value);
-    insertNode(node);
+    // Otherwise, insert a new node (or update the existing one)
+    insertNode(key, value);
     return allGood;
 }
 
+/* Insert a sorted batch of KV-pairs, the capacity was already checked for the whole batch */
+void RBTree::put_sorted(const pair<int64_t, int64_t>* sorted_KV, const size_t& count) {
+    for (size_t i = 0; i < count; ++i) {
+        insertNode(sorted_KV[i].first, sorted_KV[i].second);
+    }
+}
+
+/* Drop all the nodes in one shot by rewinding the arena */
+void RBTree::clear() {
+    arena.reset();
+    root = nullptr;
+    curr_size = 0;
+    range_tombstones.clear();
+    min_key = numeric_limits<int64_t>::max();
+    max_key = numeric_limits<int64_t>::min();
+}
+
 /* Retrieve a value by key */
 Result RBTree::get(int64_t*& result, const int64_t& key) {
     // Search for the key in the Red-Black Tree
@@ -68,18 +83,52 @@ Node* RBTree::search(Node* root, const int64_t& key) {
     }
 }
 
-/* Scan the memtable and SST to retrieve all KV-pairs in a key range in key order (key1 < key2) */
-void RBTree::scan(vector<pair<int64_t, int64_t>>& sorted_KV, const Node* root, const int64_t& key1, const int64_t& key2) {
-    if (root != nullptr) {
-        scan(sorted_KV, root->left, key1, key2);
-        // Only include KV-pairs that are in the range
-        if (key1 <= root->key && root->key <= key2) {
-            sorted_KV.emplace_back(root->key, root->value);
+/* Find the first node with a key >= key, by descending from the root once */
+RBTree::Iterator RBTree::seek(const int64_t& key) {
+    Node* lower_bound = nullptr;
+    Node* node = root;
+    while (node != nullptr) {
+        if (node->key >= key) {
+            lower_bound = node;
+            node = node->left;
+        } else {
+            node = node->right;
         }
-        scan(sorted_KV, root->right, key1, key2);
     }
+    return Iterator(lower_bound);
 }
 
+/* Move to the in-order successor: the leftmost node of the right subtree if there is one,
+   otherwise the first ancestor we reach from its left subtree */
+void RBTree::Iterator::next() {
+    if (node->right != nullptr) {
+        node = node->right;
+        while (node->left != nullptr) node = node->left;
+        return;
+    }
+    Node* child = node;
+    node = node->parent;
+    while (node != nullptr && node->right == child) {
+        child = node;
+        node = node->parent;
+    }
+}
+
+/* Scan the memtable to retrieve all KV-pairs in a key range in key order (key1 < key2).
+   Only the nodes in the range are visited, plus the path to the first one */
+void RBTree::scan(vector<pair<int64_t, int64_t>>& sorted_KV, const int64_t& key1, const int64_t& key2) {
+    for (Iterator it = seek(key1); it.valid() && it.node->key <= key2; it.next()) {
+        sorted_KV.emplace_back(it.node->key, it.node->value);
+    }
+}
+
+/* Scan the whole memtable in key order, used when flushing to an SST */
+void RBTree::scan_all(aligned_KV_vector& sorted_KV, const function<void(const size_t&)>& on_chunk) {
+    for (Iterator it = seek(numeric_limits<int64_t>::min()); it.valid(); it.next()) {
+        sorted_KV.emplace_back(it.node->key, it.node->value);
+        if (sorted_KV.len % constants::FLUSH_CHUNK_SIZE == 0) on_chunk(sorted_KV.len);
+    }
+}
 
 /*
  * Helper function to perform left rotation
@@ -242,25 +291,28 @@ void RBTree::insertFixup(Node* node) {
     root->color = black;
 }
 
-/* Insert a node into the Red-Black Tree */
-void RBTree::insertNode(Node* node) {
+/* Insert a key-value pair into the Red-Black Tree */
+void RBTree::insertNode(const int64_t& key, const int64_t& value) {
     // Perform a standard Binary Search Tree insertion
     Node* y = nullptr;
     Node* x = root;
 
     while (x != nullptr) {
         y = x;
-        if (node->key == x->key) {
-            x->value = node->value;
-            delete node;
+        if (key == x->key) {
+            // Updates are done in-place, no node is allocated
+            x->value = value;
             return;
         }
-        else if (node->key < x->key)
+        else if (key < x->key)
             x = x->left;
         else
             x = x->right;
     }
 
+    // Only allocate a node from the arena once we know the key is new
+    Node* node = new(arena.allocate(sizeof(Node))) Node(key, value);
+
     // Set the parent of the new node
     node->parent = y;
 
@@ -0,0 +1,185 @@
+#include <iostream>
+#include <random>
+#include <thread>
+#include <cassert>
+#include <limits>
+#include "skiplist.h"
+using namespace std;
+
+SkipList::SkipList(size_t capacity) : Memtable(capacity) {
+    // The head is a sentinel with the maximum height, kept outside the arena so clear() can keep it
+    head = new(new char[SkipNode::size_of(constants::SKIPLIST_MAX_HEIGHT)])
+           SkipNode(numeric_limits<int64_t>::min(), 0, constants::SKIPLIST_MAX_HEIGHT);
+    for (int32_t i = 0; i < constants::SKIPLIST_MAX_HEIGHT; ++i) {
+        head->next[i].store(nullptr, memory_order_relaxed);
+    }
+}
+
+SkipList::~SkipList() {
+    delete[] (char*)head;
+    head = nullptr;
+}
+
+/* Pick the height of a new node, each level is reached with probability 1/SKIPLIST_BRANCHING */
+int32_t SkipList::random_height() {
+    // Each writer thread has its own generator, so no synchronization is needed
+    thread_local minstd_rand generator(hash<thread::id>()(this_thread::get_id()));
+    int32_t height = 1;
+    while (height < constants::SKIPLIST_MAX_HEIGHT && generator() % constants::SKIPLIST_BRANCHING == 0) {
+        ++height;
+    }
+    return height;
+}
+
+/* Find the predecessor and successor of key on every level
+ * Return: whether the key is already in the list (it is then succs[0]) */
+bool SkipList::find(const int64_t& key, SkipNode** preds, SkipNode** succs) {
+    SkipNode* pred = head;
+    for (int32_t level = constants::SKIPLIST_MAX_HEIGHT - 1; level >= 0; --level) {
+        SkipNode* cur = pred->next[level].load(memory_order_acquire);
+        while (cur != nullptr && cur->key < key) {
+            pred = cur;
+            cur = cur->next[level].load(memory_order_acquire);
+        }
+        preds[level] = pred;
+        succs[level] = cur;
+    }
+    return succs[0] != nullptr && succs[0]->key == key;
+}
+
+/* Return the first node whose key is >= key, or nullptr */
+SkipNode* SkipList::seek(const int64_t& key) {
+    SkipNode* pred = head;
+    SkipNode* cur = nullptr;
+    for (int32_t level = constants::SKIPLIST_MAX_HEIGHT - 1; level >= 0; --level) {
+        cur = pred->next[level].load(memory_order_acquire);
+        while (cur != nullptr && cur->key < key) {
+            pred = cur;
+            cur = cur->next[level].load(memory_order_acquire);
+        }
+    }
+    return cur;
+}
+
+/* Insert or update key-value pair into the memtable, safe to call from several threads */
+Result SkipList::put(const int64_t& key, const int64_t& value) {
+    SkipNode* preds[constants::SKIPLIST_MAX_HEIGHT];
+    SkipNode* succs[constants::SKIPLIST_MAX_HEIGHT];
+    SkipNode* node = nullptr;
+
+    // Link the node on the bottom level first. This is the linearization point of the insert.
+    while (true) {
+        if (find(key, preds, succs)) {
+            // Someone (maybe a racing writer) already inserted the key, so this is an update
+            if (node != nullptr) --curr_size; // Give back the reserved slot, the node stays unused in the arena
+            succs[0]->value.store(value, memory_order_release);
+            return allGood;
+        }
+        if (node == nullptr) {
+            // Reserve a slot before allocating, so concurrent writers cannot overshoot the capacity
+            if (curr_size.fetch_add(1) >= max_size) {
+                --curr_size;
+                return memtableFull;
+            }
+            int32_t height = random_height();
+            node = new(arena.allocate_concurrent(SkipNode::size_of(height))) SkipNode(key, value, height);
+        }
+        for (int32_t level = 0; level < node->height; ++level) {
+            node->next[level].store(succs[level], memory_order_relaxed);
+        }
+        SkipNode* expected = succs[0];
+        if (preds[0]->next[0].compare_exchange_strong(expected, node)) break;
+        // Lost the race against another writer on this position, search again
+    }
+
+    // Link the upper levels, they only speed up searches so readers never depend on them
+    for (int32_t level = 1; level < node->height; ++level) {
+        while (true) {
+            SkipNode* expected = succs[level];
+            if (preds[level]->next[level].compare_exchange_strong(expected, node)) break;
+            // The neighbourhood changed on this level, recompute it and retry
+            find(key, preds, succs);
+            node->next[level].store(succs[level], memory_order_relaxed);
+        }
+    }
+
+    #ifdef DEBUG
+        cout << "Insert key: " << key << " value: " << value << endl;
+    #endif
+    return allGood;
+}
+
+/* Insert a sorted batch of KV-pairs, the capacity was already checked for the whole batch.
+   The writer has the list to itself, and since the keys are ascending, the search for a key
+   resumes from the predecessors of the previous one instead of starting over from the head */
+void SkipList::put_sorted(const pair<int64_t, int64_t>* sorted_KV, const size_t& count) {
+    SkipNode* preds[constants::SKIPLIST_MAX_HEIGHT];
+    for (int32_t level = 0; level < constants::SKIPLIST_MAX_HEIGHT; ++level) {
+        preds[level] = head;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        const int64_t& key = sorted_KV[i].first;
+        SkipNode* pred = head;
+        for (int32_t level = constants::SKIPLIST_MAX_HEIGHT - 1; level >= 0; --level) {
+            // Both candidates are before key, start from the one further down the list
+            if (preds[level] != head && (pred == head || preds[level]->key > pred->key)) pred = preds[level];
+            SkipNode* cur = pred->next[level].load(memory_order_relaxed);
+            while (cur != nullptr && cur->key < key) {
+                pred = cur;
+                cur = cur->next[level].load(memory_order_relaxed);
+            }
+            preds[level] = pred;
+        }
+
+        SkipNode* succ = preds[0]->next[0].load(memory_order_relaxed);
+        if (succ != nullptr && succ->key == key) {
+            succ->value.store(sorted_KV[i].second, memory_order_release);
+            continue;
+        }
+        int32_t height = random_height();
+        SkipNode* node = new(arena.allocate(SkipNode::size_of(height))) SkipNode(key, sorted_KV[i].second, height);
+        for (int32_t level = 0; level < height; ++level) {
+            node->next[level].store(preds[level]->next[level].load(memory_order_relaxed), memory_order_relaxed);
+            preds[level]->next[level].store(node, memory_order_release);
+        }
+        ++curr_size;
+    }
+}
+
+/* Retrieve a value by key, without taking any lock */
+Result SkipList::get(int64_t*& result, const int64_t& key) {
+    SkipNode* node = seek(key);
+    if (node == nullptr || node->key != key) {
+        #ifdef DEBUG
+            cout << "Not found Key: " << key << " in memtable. Now searching SSTs..." << endl;
+        #endif
+        return notInMemtable;
+    }
+    result = new int64_t(node->value.load(memory_order_acquire));
+    return allGood;
+}
+
+/* Retrieve all KV-pairs in a key range in key order (key1 < key2) */
+void SkipList::scan(vector<pair<int64_t, int64_t>>& sorted_KV, const int64_t& key1, const int64_t& key2) {
+    for (SkipNode* node = seek(key1); node != nullptr && node->key <= key2; node = node->next[0].load(memory_order_acquire)) {
+        sorted_KV.emplace_back(node->key, node->value.load(memory_order_acquire));
+    }
+}
+
+/* Scan the whole memtable in key order, used when flushing to an SST */
+void SkipList::scan_all(aligned_KV_vector& sorted_KV, const function<void(const size_t&)>& on_chunk) {
+    for (SkipNode* node = head->next[0].load(memory_order_acquire); node != nullptr; node = node->next[0].load(memory_order_acquire)) {
+        sorted_KV.emplace_back(node->key, node->value.load(memory_order_acquire));
+        if (sorted_KV.len % constants::FLUSH_CHUNK_SIZE == 0) on_chunk(sorted_KV.len);
+    }
+}
+
+/* Drop all the nodes in one shot by rewinding the arena */
+void SkipList::clear() {
+    arena.reset();
+    for (int32_t i = 0; i < constants::SKIPLIST_MAX_HEIGHT; ++i) {
+        head->next[i].store(nullptr, memory_order_relaxed);
+    }
+    curr_size = 0;
+    range_tombstones.clear();
+}
@@ -1,5 +1,7 @@
 #include <iostream>
 #include "database.h"
+#include "loserTree.h"
+#include "pageSearch.h"
 #include <fstream>
 #include <cassert>
 #include <fcntl.h>
@@ -7,6 +9,8 @@
 #include <iomanip>
 #include <algorithm>
 #include <random>
+#include <thread>
+#include <sys/wait.h>
 using namespace std;
 namespace fs = std::filesystem;
 
@@ -60,9 +64,9 @@ void test_put_small(string db_name)
     db.put(8, 80);
     #ifdef DEBUG
         cout << "\ntree-graph for key: (Read from left to right)" << endl;
-        inorderKey(db.memtable->root);
+        inorderKey(((RBTree*)db.memtable)->root);
         cout << "\ntree-graph for color - 0 black, 1 red:" << endl;
-        inorderColor(db.memtable->root);
+        inorderColor(((RBTree*)db.memtable)->root);
     #endif
     assert(db.memtable->curr_size == 6);
     cout << "--- test case 2: Test put() with exceeding tree capacity ---" << endl;
@@ -74,9 +78,9 @@ void test_put_small(string db_name)
     assert(db.lsmtree->num_levels == 1);
     #ifdef DEBUG
         cout << "\ntree-graph for key: (Read from left to right)" << endl;
-        inorderKey(db.memtable->root);
+        inorderKey(((RBTree*)db.memtable)->root);
         cout << "\ntree-graph for color - 0 black, 1 red:" << endl;
-        inorderColor(db.memtable->root);
+        inorderColor(((RBTree*)db.memtable)->root);
     #endif
     db.closeDB();
 }
@@ -440,6 +444,1428 @@ void test_open_close_DB(const string& db_name, Database& db, vector<pair<int64_t
     }
 }
 
+// Test the skiplist memtable with several writer threads and a concurrent reader
+void test_concurrent_skiplist(const string& db_name, const bool& ifBtree) {
+    const int num_writers = 4;
+    const int64_t keys_per_writer = 3 * 1000;
+    Options options;
+    options.memtable_type = skiplist_memtable;
+    Database db(1000); // Small memtable, so that writers also race on flushes
+    db.openDB(db_name, options);
+
+    cout << "--- test case 1: Test put() from several threads ---" << endl;
+    vector<thread> writers;
+    for (int t = 0; t < num_writers; ++t) {
+        writers.emplace_back([&db, t, keys_per_writer]() {
+            // Writers interleave their keys, so they keep inserting next to each other
+            for (int64_t i = 0; i < keys_per_writer; ++i) {
+                int64_t key = i * num_writers + t;
+                db.put(key, key * 10);
+            }
+        });
+    }
+    // Read while the writers are running; any key found must have its final value
+    thread reader([&db, &ifBtree, keys_per_writer]() {
+        for (int64_t key = 0; key < keys_per_writer * num_writers; key += 7) {
+            const int64_t* value = db.get(key, ifBtree);
+            if (value != nullptr) {
+                assert(*value == key * 10);
+                delete value;
+            }
+        }
+    });
+    for (thread& writer : writers) writer.join();
+    reader.join();
+
+    cout << "--- test case 2: Test get() after concurrent put() ---" << endl;
+    for (int64_t key = 0; key < keys_per_writer * num_writers; ++key) {
+        const int64_t* value = db.get(key, ifBtree);
+        assert(value != nullptr && *value == key * 10);
+        delete value;
+    }
+
+    cout << "--- test case 3: Test scan() after concurrent put() ---" << endl;
+    const vector<pair<int64_t, int64_t>>* values = db.scan(100, 2100, ifBtree);
+    assert(values->size() == 2001);
+    for (int64_t i = 0; i < (int64_t)values->size(); ++i) {
+        assert(values->at(i).first == 100 + i && values->at(i).second == (100 + i) * 10);
+    }
+    delete values;
+
+    db.closeDB();
+}
+
+// Test that reads see the data of memtables that are still being flushed in the background
+void test_background_flush(const string& db_name, const bool& ifBtree) {
+    const int64_t num_keys = 20 * 1000;
+    Database db(1000);
+    db.openDB(db_name);
+
+    cout << "--- test case 1: Test get() right after put() that swapped memtables ---" << endl;
+    for (int64_t key = 0; key < num_keys; ++key) {
+        db.put(key, -key);
+        // The previous memtable may not be an SST yet
+        const int64_t* value = db.get(key - 500 * (key % 3), ifBtree);
+        if (key >= 1000) assert(value != nullptr && *value == -(key - 500 * (key % 3)));
+        delete value;
+    }
+    assert(db.immutable_memtables.size() <= db.options.max_immutable_memtables);
+
+    cout << "--- test case 2: Test scan() across active, immutable memtables and SSTs ---" << endl;
+    const vector<pair<int64_t, int64_t>>* values = db.scan(num_keys - 3000, num_keys, ifBtree);
+    assert(values->size() == 3000);
+    for (int64_t i = 0; i < (int64_t)values->size(); ++i) {
+        assert(values->at(i).first == num_keys - 3000 + i && values->at(i).second == -(num_keys - 3000 + i));
+    }
+    delete values;
+
+    db.closeDB();
+}
+
+void test_background_compaction(const string& db_name, const bool& ifBtree) {
+    const int64_t num_keys = 50 * 1000;
+    Database db(1000);
+    Options options;
+    options.l0_stall_limit = 1;
+    db.openDB(db_name, options);
+
+    cout << "--- test case 1: Test flushes stall on level 0 debt while compactions run ---" << endl;
+    for (int64_t key = 0; key < num_keys; ++key) {
+        db.put(key, -key);
+        if (key % 3 == 0) db.put(key / 2, key); // Overwrite older keys so merges have to pick the newest value
+    }
+    db.closeDB();
+    db.openDB(db_name, options);
+    assert(db.lsmtree->num_levels > 1);
+    for (size_t level = 0; level < db.lsmtree->num_levels; ++level) {
+        assert(db.lsmtree->level_debt(level) == 0);
+    }
+
+    cout << "--- test case 2: Test get() after background compactions ---" << endl;
+    auto expected = [num_keys](const int64_t& key) {
+        return (key * 2 < num_keys && (key * 2) % 3 == 0) ? key * 2 :
+               (key * 2 + 1 < num_keys && (key * 2 + 1) % 3 == 0) ? key * 2 + 1 : -key;
+    };
+    for (int64_t key = 0; key < num_keys; ++key) {
+        const int64_t* value = db.get(key, ifBtree);
+        assert(value != nullptr && *value == expected(key));
+        delete value;
+    }
+
+    cout << "--- test case 3: Test get() and scan() from several threads while compactions remove the SSTs they read ---" << endl;
+    atomic<bool> writing(true);
+    vector<thread> readers;
+    for (int64_t t = 0; t < 3; ++t) {
+        readers.emplace_back([&db, &writing, &expected, &ifBtree, num_keys, t]() {
+            int64_t key = t;
+            while (writing) {
+                key = (key + 7919) % (num_keys - 100);
+                const int64_t* value = db.get(key, ifBtree);
+                assert(value != nullptr && *value == expected(key));
+                delete value;
+                const vector<pair<int64_t, int64_t>>* values = db.scan(key, key + 99, ifBtree);
+                assert(values->size() == 100);
+                for (const pair<int64_t, int64_t>& KV : *values) {
+                    assert(KV.second == expected(KV.first));
+                }
+                delete values;
+                // Lookups hold the memtables shared, leave the writer room to swap them
+                this_thread::sleep_for(chrono::microseconds(200));
+            }
+        });
+    }
+    for (int64_t key = num_keys; key < 3 * num_keys; ++key) {
+        db.put(key, -key);
+    }
+    writing = false;
+    for (thread& reader : readers) reader.join();
+    db.closeDB();
+    db.openDB(db_name, options);
+    // The SSTs compacted away while they were read are gone too
+    size_t num_SSTs = 0;
+    for (size_t i = 0; i < db.lsmtree->num_levels; ++i) {
+        num_SSTs += db.lsmtree->levels[i].sorted_dir.size();
+    }
+    assert((size_t)distance(fs::directory_iterator(constants::DATA_FOLDER + db_name + "/sst"), fs::directory_iterator()) == num_SSTs);
+
+    db.closeDB();
+}
+
+// Run the writes of a test in a child process that exits without closeDB, like a crash
+void crash_after(const string& db_name, const Options& options, const function<void(Database&)>& writes) {
+    pid_t pid = fork();
+    assert(pid != -1);
+    if (pid == 0) {
+        // Never destroyed: the background threads are still running when the process dies
+        Database* db = new Database(1000);
+        db->openDB(db_name, options);
+        writes(*db);
+        _exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+void test_wal_recovery(const string& db_name, const bool& ifBtree) {
+    const int64_t num_threads = 4;
+    const int64_t keys_per_thread = 500;
+    const int64_t num_keys = 2500;
+
+    cout << "--- test case 1: Test concurrent put() with sync_always survives a crash ---" << endl;
+    Options options;
+    options.memtable_type = skiplist_memtable;
+    options.wal_sync_policy = sync_always;
+    crash_after(db_name, options, [&](Database& db) {
+        vector<thread> writers;
+        for (int64_t t = 0; t < num_threads; ++t) {
+            writers.emplace_back([&db, t, keys_per_thread]() {
+                for (int64_t key = t * keys_per_thread; key < (t + 1) * keys_per_thread; ++key) {
+                    db.put(key, key + 1);
+                }
+            });
+        }
+        for (thread& writer : writers) writer.join();
+        cout << "Group commit: " << num_threads * keys_per_thread << " puts in " << db.wal->num_syncs << " syncs" << endl;
+    });
+    {
+        Database db(1000);
+        db.openDB(db_name);
+        for (int64_t key = 0; key < num_threads * keys_per_thread; ++key) {
+            const int64_t* value = db.get(key, ifBtree);
+            assert(value != nullptr && *value == key + 1);
+            delete value;
+        }
+        db.closeDB();
+        assert(fs::is_empty(constants::DATA_FOLDER + db_name + "/wal"));
+    }
+    deleteSSTs(constants::DATA_FOLDER + db_name);
+
+    cout << "--- test case 2: Test put() and del() with sync_interval survive a crash across memtable swaps ---" << endl;
+    options = Options();
+    options.wal_sync_interval_ms = 1;
+    crash_after(db_name, options, [&](Database& db) {
+        for (int64_t key = 0; key < num_keys; ++key) {
+            db.put(key, -key);
+        }
+        for (int64_t key = 0; key < num_keys; key += 5) {
+            db.del(key);
+        }
+        this_thread::sleep_for(chrono::milliseconds(100));
+    });
+    {
+        Database db(1000);
+        db.openDB(db_name);
+        for (int64_t key = 0; key < num_keys; ++key) {
+            const int64_t* value = db.get(key, ifBtree);
+            if (key % 5 == 0) {
+                assert(value == nullptr);
+            } else {
+                assert(value != nullptr && *value == -key);
+            }
+            delete value;
+        }
+        db.closeDB();
+    }
+
+    cout << "--- test case 3: Test replay stops at a torn record ---" << endl;
+    options = Options();
+    options.wal_sync_policy = sync_always;
+    crash_after(db_name, options, [&](Database& db) {
+        db.put(num_keys, 1);
+        db.put(num_keys + 1, 2);
+    });
+    vector<fs::path> segments = WAL::find_segments(constants::DATA_FOLDER + db_name + "/wal");
+    assert(segments.size() == 1);
+    // Corrupt the value of the second record
+    fs::resize_file(segments[0], fs::file_size(segments[0]) - constants::PAIR_SIZE / 2);
+    {
+        Database db(1000);
+        db.openDB(db_name);
+        const int64_t* value = db.get(num_keys, ifBtree);
+        assert(value != nullptr && *value == 1);
+        delete value;
+        assert(db.get(num_keys + 1, ifBtree) == nullptr);
+        db.closeDB();
+    }
+}
+
+void test_write_batch(const string& db_name, const bool& ifBtree) {
+    const int64_t num_keys = 2500;
+    for (MemtableType memtable_type : {rbtree_memtable, skiplist_memtable}) {
+        cout << "--- test case 1: Test write() with puts, deletes and repeated keys (memtable type " << memtable_type << ") ---" << endl;
+        Database db(1000);
+        Options options;
+        options.memtable_type = memtable_type;
+        db.openDB(db_name, options);
+        WriteBatch batch;
+        // Keys in descending order, every key is written twice and every third one is then deleted
+        for (int64_t key = num_keys - 1; key >= 0; --key) {
+            batch.put(key, 0);
+            batch.put(key, -key);
+            if (key % 3 == 0) batch.del(key);
+        }
+        db.write(batch);
+        batch.clear();
+        for (int64_t key = 0; key < num_keys; ++key) {
+            const int64_t* value = db.get(key, ifBtree);
+            if (key % 3 == 0) {
+                assert(value == nullptr);
+            } else {
+                assert(value != nullptr && *value == -key);
+            }
+            delete value;
+        }
+
+        cout << "--- test case 2: Test a small write() lands in a single memtable ---" << endl;
+        for (int64_t key = num_keys; key < num_keys + 900; ++key) {
+            batch.put(key, key);
+        }
+        db.write(batch);
+        batch.clear();
+        // The 500 keys left in the memtable by the previous batch leave no room, so the memtable was swapped first
+        assert(db.memtable->curr_size == 900);
+        const vector<pair<int64_t, int64_t>>* values = db.scan(num_keys - 10, num_keys + 900, ifBtree);
+        assert(values->size() == 906 && values->back().second == num_keys + 899);
+        delete values;
+        db.closeDB();
+        deleteSSTs(constants::DATA_FOLDER + db_name);
+    }
+
+    cout << "--- test case 3: Test a batch is replayed from the WAL as a whole ---" << endl;
+    Options options;
+    options.wal_sync_policy = sync_always;
+    crash_after(db_name, options, [&](Database& db) {
+        WriteBatch batch;
+        for (int64_t key = 0; key < 500; ++key) batch.put(key, key);
+        db.write(batch);
+        batch.clear();
+        for (int64_t key = 500; key < 1000; ++key) batch.put(key, key);
+        db.write(batch);
+    });
+    // Tear the second batch, none of it must be replayed
+    vector<fs::path> segments = WAL::find_segments(constants::DATA_FOLDER + db_name + "/wal");
+    assert(segments.size() == 1);
+    fs::resize_file(segments[0], fs::file_size(segments[0]) - constants::PAIR_SIZE / 2);
+    Database db(1000);
+    db.openDB(db_name);
+    for (int64_t key = 0; key < 1000; ++key) {
+        const int64_t* value = db.get(key, ifBtree);
+        if (key < 500) {
+            assert(value != nullptr && *value == key);
+        } else {
+            assert(value == nullptr);
+        }
+        delete value;
+    }
+    db.closeDB();
+}
+
+void test_ingest_sorted(const string& db_name, const bool& ifBtree) {
+    const int64_t num_keys = 200 * 1000;
+    Database db(1000);
+    db.openDB(db_name);
+
+    cout << "--- test case 1: Test ingesting a sorted file into an empty DB goes straight to its level ---" << endl;
+    fs::path input_path = constants::DATA_FOLDER + "ingest.bytes";
+    {
+        // Even keys, with a repeated key whose last value wins
+        vector<pair<int64_t, int64_t>> input;
+        for (int64_t key = 0; key < 2 * num_keys; key += 2) {
+            if (key == 100) input.emplace_back(key, 0);
+            input.emplace_back(key, key);
+        }
+        ofstream input_file(input_path, ios::binary);
+        input_file.write((char*)input.data(), input.size() * constants::PAIR_SIZE);
+    }
+    db.ingest_sorted(input_path);
+    fs::remove(input_path);
+    size_t level = db.lsmtree->ingest_level(num_keys);
+    assert(level > 0 && db.lsmtree->num_levels == level + 1 && db.lsmtree->levels[level].sorted_dir.size() == 1);
+    for (int64_t key = 0; key < 2 * num_keys; key += 997) {
+        const int64_t* value = db.get(key, ifBtree);
+        if (key % 2 == 0) {
+            assert(value != nullptr && *value == key);
+        } else {
+            assert(value == nullptr);
+        }
+        delete value;
+    }
+
+    cout << "--- test case 2: Test ingested pairs overwrite the memtable and older runs ---" << endl;
+    for (int64_t key = 1; key < 20000; key += 2) {
+        db.put(key, -key);
+    }
+    db.put(2, -2);
+    // Multiples of 3 in [0, 30000)
+    int64_t next_key = 0;
+    db.ingest_sorted([&next_key](pair<int64_t, int64_t>& KV) {
+        if (next_key >= 30000) return false;
+        KV = {next_key, next_key * 10 + 1};
+        next_key += 3;
+        return true;
+    }, 10000);
+    for (int64_t key = 0; key < 40000; ++key) {
+        const int64_t* value = db.get(key, ifBtree);
+        int64_t expected = (key < 30000 && key % 3 == 0) ? key * 10 + 1 : (key == 2) ? -2 : (key % 2 == 0) ? key : (key < 20000) ? -key : 0;
+        if (expected == 0) {
+            assert(value == nullptr);
+        } else {
+            assert(value != nullptr && *value == expected);
+        }
+        delete value;
+    }
+
+    cout << "--- test case 3: Test a non-overlapping ingest smaller than the last level stays above it, and survives reopening ---" << endl;
+    next_key = 2 * num_keys;
+    db.ingest_sorted([&next_key, &num_keys](pair<int64_t, int64_t>& KV) {
+        if (next_key >= 3 * num_keys) return false;
+        KV = {next_key, next_key};
+        ++next_key;
+        return true;
+    }, num_keys);
+    // Nothing overlaps it, but it is smaller than the last level: it joins the deepest non-last level
+    assert(db.lsmtree->num_levels > 1);
+    fs::path ingested = db.lsmtree->levels[db.lsmtree->num_levels - 2].sorted_dir.back();
+    assert(db.lsmtree->SST_meta(ingested).min_key == 2 * num_keys);
+    const vector<pair<int64_t, int64_t>>* values = db.scan(2 * num_keys - 10, 2 * num_keys + 10, ifBtree);
+    assert(values->size() == 16);
+    delete values;
+    db.closeDB();
+    db.openDB(db_name);
+    for (int64_t key = 0; key < 3 * num_keys; key += 101) {
+        const int64_t* value = db.get(key, ifBtree);
+        int64_t expected = (key < 30000 && key % 3 == 0) ? key * 10 + 1 : (key == 2) ? -2 : (key >= 2 * num_keys || key % 2 == 0) ? key : (key < 20000) ? -key : 0;
+        if (expected == 0) {
+            assert(value == nullptr);
+        } else {
+            assert(value != nullptr && *value == expected);
+        }
+        delete value;
+    }
+    db.closeDB();
+}
+
+void test_memtable_budget(const string& db_name, const bool& ifBtree) {
+    Database db(1000);
+    Options options;
+    options.memtable_budget = 500 * constants::PAIR_SIZE;
+    db.openDB(db_name, options);
+
+    cout << "--- test case 1: Test the memtable budget given in bytes when opening the DB ---" << endl;
+    assert(db.memtable_capacity == 500 && db.lsmtree->memtable_capacity == 500);
+    for (int64_t key = 0; key < 1200; ++key) {
+        db.put(key, -key);
+    }
+    assert(db.memtable->max_size == 500 && db.memtable->curr_size == 200);
+
+    cout << "--- test case 2: Test a larger budget at runtime applies to the active memtable ---" << endl;
+    db.set_memtable_budget(4000 * constants::PAIR_SIZE);
+    for (int64_t key = 1200; key < 4200; ++key) {
+        db.put(key, -key);
+    }
+    assert(db.memtable->max_size == 4000 && db.memtable->curr_size == 3200);
+
+    cout << "--- test case 3: Test a smaller budget hands the memtable over to the flush thread ---" << endl;
+    db.set_memtable_budget(1000 * constants::PAIR_SIZE);
+    assert(db.memtable->max_size == 1000 && db.memtable->curr_size == 0);
+    for (int64_t key = 0; key < 4200; key += 7) {
+        const int64_t* value = db.get(key, ifBtree);
+        assert(value != nullptr && *value == -key);
+        delete value;
+    }
+    db.closeDB();
+
+    cout << "--- test case 4: Test Bloom Filters are sized by the number of entries actually flushed ---" << endl;
+    db.openDB(db_name);
+    size_t num_entries = 0;
+    for (size_t level = 0; level < db.lsmtree->num_levels; ++level) {
+        for (const fs::path& file_name : db.lsmtree->levels[level].sorted_dir) {
+            size_t leaf_end = db.lsmtree->SST_meta(file_name).leaf_end;
+            num_entries += leaf_end / constants::PAIR_SIZE;
+            // Level 0 gets the most bits per entry
+            float max_bits = ceil(db.lsmtree->bits_per_entry(0, db.lsmtree->num_levels)) * leaf_end / constants::PAIR_SIZE;
+            size_t max_filter_size = constants::PAGE_SIZE * (2 + (size_t)max_bits / 8 / constants::PAGE_SIZE);
+            assert(fs::file_size(db.lsmtree->filter_path / file_name) <= max_filter_size);
+        }
+    }
+    assert(num_entries >= 4200 && num_entries < 4200 + 8 * constants::KEYS_PER_NODE);
+    for (int64_t key = 0; key < 4200; key += 7) {
+        const int64_t* value = db.get(key, ifBtree);
+        assert(value != nullptr && *value == -key);
+        delete value;
+    }
+    db.closeDB();
+}
+
+void test_subcompactions(const string& db_name, const bool& ifBtree) {
+    const int64_t num_keys = 40 * 1000;
+    Database db(1000);
+    db.openDB(db_name);
+    // Split every compaction of more than two memtables worth of pairs
+    db.lsmtree->subcompaction_size = 2000;
+
+    cout << "--- test case 1: Test get() and scan() after compactions split into key ranges ---" << endl;
+    // Keys are spread over every SST, written twice, and every 7th one is then deleted
+    for (int64_t round = 0; round < 2; ++round) {
+        for (int64_t i = 0; i < num_keys; ++i) {
+            int64_t key = (i * 7919) % num_keys;
+            db.put(key, key * 10 + round);
+        }
+    }
+    for (int64_t key = 0; key < num_keys; key += 7) {
+        db.del(key);
+    }
+    auto check = [&]() {
+        for (int64_t key = 0; key < num_keys; key += 3) {
+            const int64_t* value = db.get(key, ifBtree);
+            if (key % 7 == 0) {
+                assert(value == nullptr);
+            } else {
+                assert(value != nullptr && *value == key * 10 + 1);
+            }
+            delete value;
+        }
+        const vector<pair<int64_t, int64_t>>* values = db.scan(0, num_keys, ifBtree);
+        assert((int64_t)values->size() == num_keys - (num_keys + 6) / 7);
+        for (size_t i = 1; i < values->size(); ++i) {
+            assert(values->at(i - 1).first < values->at(i).first && values->at(i).second == values->at(i).first * 10 + 1);
+        }
+        delete values;
+    };
+    check();
+    // The flushes stall on compaction debt, so compactions have been running all along
+    assert(db.lsmtree->num_subcompactions > 0);
+    db.closeDB();
+
+    cout << "--- test case 2: Test the stitched SSTs after reopening the DB ---" << endl;
+    db.openDB(db_name);
+    check();
+    db.closeDB();
+}
+
+void test_compaction_readahead(const string& db_name, const bool& ifBtree) {
+    const int64_t num_keys = 20 * 1000;
+    // Chunks of one page, and of 3 pages which do not divide the SSTs, so that the ends of chunks,
+    // of subcompaction ranges and of the SSTs all fall in different places
+    for (size_t readahead_size : {constants::PAGE_SIZE, 3 * constants::PAGE_SIZE}) {
+        cout << "--- test case: Test compactions with " << readahead_size << " bytes of read-ahead ---" << endl;
+        Database db(1000);
+        Options options;
+        options.compaction_readahead_size = readahead_size;
+        db.openDB(db_name, options);
+        db.lsmtree->subcompaction_size = 3000;
+        for (int64_t i = 0; i < num_keys; ++i) {
+            int64_t key = (i * 7919) % num_keys;
+            db.put(key, key % 5 == 0 ? constants::TOMBSTONE : -key);
+        }
+        db.closeDB();
+        db.openDB(db_name, options);
+        for (int64_t key = 0; key < num_keys; ++key) {
+            const int64_t* value = db.get(key, ifBtree);
+            if (key % 5 == 0) {
+                assert(value == nullptr);
+            } else {
+                assert(value != nullptr && *value == -key);
+            }
+            delete value;
+        }
+        db.closeDB();
+        deleteSSTs(constants::DATA_FOLDER + db_name);
+    }
+}
+
+void test_kway_merge(const string& db_name, const bool& ifBtree) {
+    cout << "--- test case 1: Test the tournament tree on runs with shared keys and empty runs ---" << endl;
+    vector<vector<pair<int64_t, int64_t>>> runs = {{{1, 0}, {4, 0}, {9, 0}}, {}, {{1, 2}, {2, 2}, {9, 2}}, {{4, 3}}, {{0, 4}, {9, 4}}};
+    LoserTree tournament(runs.size());
+    vector<size_t> next(runs.size(), 0);
+    for (size_t i = 0; i < runs.size(); ++i) {
+        if (!runs[i].empty()) tournament.set(i, runs[i][0]);
+    }
+    tournament.build();
+    vector<pair<int64_t, int64_t>> merged;
+    while (!tournament.empty()) {
+        merged.emplace_back(tournament.top());
+        size_t source = tournament.top_source();
+        if (++next[source] < runs[source].size()) {
+            tournament.replace_top(runs[source][next[source]]);
+        } else {
+            tournament.pop_top();
+        }
+    }
+    // Equal keys come out newest (greatest source) first
+    vector<pair<int64_t, int64_t>> expected = {{0, 4}, {1, 2}, {1, 0}, {2, 2}, {4, 3}, {4, 0}, {9, 4}, {9, 2}, {9, 0}};
+    assert(merged == expected);
+
+    cout << "--- test case 2: Test Scan(key1, key2) over versions spread across the memtable and many SSTs ---" << endl;
+    const int64_t num_keys = 2000;
+    Database db(1000);
+    db.openDB(db_name);
+    // Every round rewrites a different subset of the keys, so the versions of a key end up in different sources
+    for (int64_t round = 1; round <= 6; ++round) {
+        for (int64_t key = 0; key < num_keys; ++key) {
+            if (key % round != 0) continue;
+            db.put(key, (key % 11 == round) ? constants::TOMBSTONE : key * 10 + round);
+        }
+    }
+    const vector<pair<int64_t, int64_t>>* values = db.scan(0, num_keys, ifBtree);
+    size_t i = 0;
+    for (int64_t key = 0; key < num_keys; ++key) {
+        int64_t round = 6;
+        while (key % round != 0) --round;
+        if (key % 11 == round) continue;
+        assert(i < values->size() && values->at(i).first == key && values->at(i).second == key * 10 + round);
+        ++i;
+    }
+    assert(i == values->size());
+    delete values;
+    db.closeDB();
+}
+
+void test_partitioned_levels(const string& db_name, const bool& ifBtree) {
+    const int64_t num_keys = 40 * 1000;
+    Database db(1000);
+    Options options;
+    options.partitioned_levels = true;
+    options.sst_partition_size = 4 * constants::PAGE_SIZE;
+    const size_t partition_size = 4 * constants::KEYS_PER_NODE;
+    db.openDB(db_name, options);
+    for (int64_t i = 0; i < num_keys; ++i) {
+        int64_t key = (i * 7919) % num_keys;
+        db.put(key, key);
+    }
+    // Overwrite and delete some keys, so that versions are found on different levels
+    for (int64_t key = 0; key < num_keys; key += 3) {
+        db.put(key, key % 2 == 0 ? constants::TOMBSTONE : -key);
+    }
+
+    auto check = [&]() {
+        for (int64_t key = 0; key < num_keys; ++key) {
+            const int64_t* value = db.get(key, ifBtree);
+            if (key % 3 == 0 && key % 2 == 0) {
+                assert(value == nullptr);
+            } else {
+                assert(value != nullptr && *value == (key % 3 == 0 ? -key : key));
+            }
+            delete value;
+        }
+        const vector<pair<int64_t, int64_t>>* values = db.scan(100, 30000, ifBtree);
+        size_t i = 0;
+        for (int64_t key = 100; key <= 30000; ++key) {
+            if (key % 3 == 0 && key % 2 == 0) continue;
+            assert(i < values->size() && values->at(i).first == key && values->at(i).second == (key % 3 == 0 ? -key : key));
+            ++i;
+        }
+        assert(i == values->size());
+        delete values;
+    };
+
+    cout << "--- test case 1: Test the levels below level 0 are cut into small non-overlapping SSTs ---" << endl;
+    check();
+    db.closeDB();
+    db.openDB(db_name, options);
+    assert(db.lsmtree->num_levels >= 3);
+    for (size_t i = 1; i < db.lsmtree->num_levels; ++i) {
+        Level& level = db.lsmtree->levels[i];
+        for (size_t j = 0; j < level.sorted_dir.size(); ++j) {
+            size_t leaf_end = db.lsmtree->SST_meta(level.sorted_dir[j]).leaf_end;
+            assert(leaf_end <= partition_size * constants::PAIR_SIZE);
+            if (j > 0) assert(level.key_ranges[j - 1].second < level.key_ranges[j].first);
+        }
+    }
+    assert(db.lsmtree->levels[db.lsmtree->num_levels - 1].sorted_dir.size() > 1);
+
+    cout << "--- test case 2: Test Get(key) and Scan(key1, key2) after reopening the DB ---" << endl;
+    check();
+    db.closeDB();
+}
+
+void test_merge_policies(const string& db_name, const bool& ifBtree) {
+    cout << "--- test case 1: Test Monkey derives the bits per entry from the size ratio, the merge policy and the FPR ---" << endl;
+    {
+        // The defaults give the Dostoevsky allocation of T = 4, R = 0.1: 5.39 bits on the last level
+        LSMTree lsmtree("unused");
+        assert(fabs(lsmtree.bits_per_entry(2, 3) - 5.3913) < 0.01);
+        assert(fabs(lsmtree.bits_per_entry(1, 3) - (2 * 2.885 + 4.7925)) < 0.01);
+        // Every level up is T times smaller: ln(T) / ln(2)^2 more bits per entry
+        lsmtree.size_ratio = 8;
+        lsmtree.runs_per_level = 7;
+        assert(fabs(lsmtree.bits_per_entry(0, 3) - lsmtree.bits_per_entry(1, 3) - log(8) / (M_LN2 * M_LN2)) < 0.01);
+        // A lower FPR costs more bits everywhere
+        float bits = lsmtree.bits_per_entry(2, 3);
+        lsmtree.bloom_fpr = 0.01;
+        assert(lsmtree.bits_per_entry(2, 3) > bits);
+        // With leveling, a level holds a single run, which gets fewer bits than each of several runs
+        bits = lsmtree.bits_per_entry(1, 3);
+        lsmtree.merge_policy = leveling;
+        assert(lsmtree.bits_per_entry(1, 3) < bits);
+    }
+
+    const int64_t num_keys = 30 * 1000;
+    vector<pair<string, Options>> policies(4);
+    policies[0].first = "tiering, size ratio 3";
+    policies[0].second.merge_policy = tiering;
+    policies[0].second.size_ratio = 3;
+    policies[1].first = "leveling, size ratio 5";
+    policies[1].second.merge_policy = leveling;
+    policies[1].second.size_ratio = 5;
+    policies[2].first = "lazy leveling, size ratio 6, 2 runs per level, FPR 0.01";
+    policies[2].second.merge_policy = lazy_leveling;
+    policies[2].second.size_ratio = 6;
+    policies[2].second.runs_per_level = 2;
+    policies[2].second.bloom_fpr = 0.01;
+    policies[3].first = "leveling then tiering";
+    policies[3].second.merge_policy = leveling;
+    for (size_t p = 0; p < policies.size(); ++p) {
+        cout << "--- test case " << p + 2 << ": Test Put(key, value), Get(key) and Scan(key1, key2) with " << policies[p].first << " ---" << endl;
+        Options& options = policies[p].second;
+        Database db(1000);
+        db.openDB(db_name, options);
+        for (int64_t i = 0; i < num_keys; ++i) {
+            int64_t key = (i * 7919) % num_keys;
+            db.put(key, key);
+        }
+        for (int64_t key = 0; key < num_keys; key += 3) {
+            db.put(key, key % 2 == 0 ? constants::TOMBSTONE : -key);
+        }
+        db.closeDB();
+        // Reopening (with another policy for the last case) keeps the data, and the levels end up in shape
+        if (p == 3) options.merge_policy = tiering;
+        db.openDB(db_name, options);
+        for (int64_t key = 0; key < num_keys; ++key) {
+            const int64_t* value = db.get(key, ifBtree);
+            if (key % 3 == 0 && key % 2 == 0) {
+                assert(value == nullptr);
+            } else {
+                assert(value != nullptr && *value == (key % 3 == 0 ? -key : key));
+            }
+            delete value;
+        }
+        const vector<pair<int64_t, int64_t>>* values = db.scan(0, num_keys, ifBtree);
+        assert((int64_t)values->size() == num_keys - (num_keys + 5) / 6);
+        delete values;
+        db.closeDB();
+        db.openDB(db_name, options);
+        LSMTree& lsmtree = *db.lsmtree;
+        assert(lsmtree.num_levels >= 3);
+        for (size_t level = 0; level < lsmtree.num_levels; ++level) {
+            assert(lsmtree.levels[level].sorted_dir.size() <= lsmtree.max_runs(level, lsmtree.num_levels));
+            assert(lsmtree.levels[level].cur_size < lsmtree.size_ratio);
+        }
+        db.closeDB();
+        deleteSSTs(constants::DATA_FOLDER + db_name);
+    }
+
+    cout << "--- test case " << policies.size() + 2 << ": Test a FPR of 0 is refused ---" << endl;
+    Database db(1000);
+    Options options;
+    options.bloom_fpr = 0;
+    bool refused = false;
+    try {
+        db.openDB(db_name, options);
+    } catch (const invalid_argument&) {
+        refused = true;
+    }
+    assert(refused);
+}
+
+void test_trivial_move(const string& db_name, const bool& ifBtree) {
+    const int64_t memtable_size = 1500;
+    const int64_t num_keys = 40 * memtable_size;
+    Database db(memtable_size);
+    Options options;
+    options.partitioned_levels = true;
+    options.sst_partition_size = 4 * constants::PAGE_SIZE;
+    db.openDB(db_name, options);
+
+    cout << "--- test case 1: Test time-ordered keys go down the levels without being rewritten ---" << endl;
+    for (int64_t key = 0; key < num_keys; ++key) {
+        db.put(key, -key);
+    }
+    db.closeDB();
+    db.openDB(db_name, options);
+    assert(db.lsmtree->num_levels >= 3);
+    // A flushed SST holds 1500 pairs (6 pages), while a merge would cut its output into SSTs of 4 pages
+    size_t flushed_leaf_end = (memtable_size + constants::KEYS_PER_NODE - 1) / constants::KEYS_PER_NODE * constants::PAGE_SIZE;
+    for (size_t i = 0; i < db.lsmtree->num_levels; ++i) {
+        for (const fs::path& file_name : db.lsmtree->levels[i].sorted_dir) {
+            assert(db.lsmtree->SST_meta(file_name).leaf_end == flushed_leaf_end);
+        }
+    }
+    for (int64_t key = 0; key < num_keys; key += 7) {
+        const int64_t* value = db.get(key, ifBtree);
+        assert(value != nullptr && *value == -key);
+        delete value;
+    }
+
+    cout << "--- test case 2: Test overlapping keys are still merged ---" << endl;
+    for (int64_t key = 0; key < num_keys; key += 5) {
+        db.put(key, key);
+    }
+    db.closeDB();
+    db.openDB(db_name, options);
+    const vector<pair<int64_t, int64_t>>* values = db.scan(0, num_keys, ifBtree);
+    assert((int64_t)values->size() == num_keys);
+    for (int64_t key = 0; key < num_keys; ++key) {
+        assert(values->at(key).first == key && values->at(key).second == (key % 5 == 0 ? key : -key));
+    }
+    delete values;
+    db.closeDB();
+}
+
+void test_append_mode(const string& db_name, const bool& ifBtree) {
+    const int64_t memtable_size = 1500;
+    const int64_t num_keys = 40 * memtable_size;
+    Database db(memtable_size);
+    Options options;
+    options.partitioned_levels = true;
+    options.sst_partition_size = 4 * constants::PAGE_SIZE;
+    options.append_mode = true;
+    db.openDB(db_name, options);
+
+    cout << "--- test case 1: Test increasing keys are appended and chained on the last level without merging ---" << endl;
+    for (int64_t key = 0; key < num_keys; ++key) {
+        db.put(2 * key, -key);
+        assert(dynamic_cast<AppendTable*>(db.memtable) != nullptr);
+    }
+    for (int64_t key = 0; key < num_keys; key += 7) {
+        const int64_t* value = db.get(2 * key, ifBtree);
+        assert(value != nullptr && *value == -key);
+        delete value;
+        assert(db.get(2 * key + 1, ifBtree) == nullptr);
+    }
+    db.closeDB();
+    db.openDB(db_name, options);
+    // Flushed SSTs never go through level 0, and hold 1500 pairs (6 pages) where a merge would cut SSTs of 4 pages
+    assert(db.lsmtree->levels[0].sorted_dir.empty());
+    size_t flushed_leaf_end = (memtable_size + constants::KEYS_PER_NODE - 1) / constants::KEYS_PER_NODE * constants::PAGE_SIZE;
+    for (size_t i = 0; i < db.lsmtree->num_levels; ++i) {
+        for (const fs::path& file_name : db.lsmtree->levels[i].sorted_dir) {
+            assert(db.lsmtree->SST_meta(file_name).leaf_end == flushed_leaf_end);
+        }
+    }
+
+    cout << "--- test case 2: Test a key out of order goes back to the memtable ---" << endl;
+    for (int64_t key = num_keys; key < num_keys + memtable_size / 2; ++key) {
+        db.put(2 * key, -key);
+    }
+    db.put(1, 1);
+    assert(dynamic_cast<AppendTable*>(db.memtable) == nullptr);
+    for (int64_t key = 0; key < num_keys + memtable_size / 2; key += 5) {
+        db.put(2 * key + 1, key);
+    }
+    db.closeDB();
+    db.openDB(db_name, options);
+    const vector<pair<int64_t, int64_t>>* values = db.scan(0, 2 * (num_keys + memtable_size / 2), ifBtree);
+    size_t i = 0;
+    for (int64_t key = 0; key < num_keys + memtable_size / 2; ++key) {
+        assert(values->at(i++) == make_pair(2 * key, -key));
+        if (key == 0) {
+            assert(values->at(i++) == make_pair((int64_t)1, (int64_t)0));
+        } else if (key % 5 == 0) {
+            assert(values->at(i++) == make_pair(2 * key + 1, key));
+        }
+    }
+    assert(i == values->size());
+    delete values;
+
+    cout << "--- test case 3: Test a few appended pairs are moved into the memtable ---" << endl;
+    int64_t max_key = 2 * (num_keys + memtable_size);
+    db.put(max_key, 1);
+    assert(dynamic_cast<AppendTable*>(db.memtable) != nullptr);
+    db.put(max_key - 1, 2);
+    assert(dynamic_cast<AppendTable*>(db.memtable) == nullptr && db.memtable->curr_size == 2);
+    for (int64_t key = max_key - 1; key <= max_key; ++key) {
+        const int64_t* value = db.get(key, ifBtree);
+        assert(value != nullptr && *value == max_key - key + 1);
+        delete value;
+    }
+    db.closeDB();
+
+    cout << "--- test case 4: Test append mode requires partitioned levels ---" << endl;
+    options.partitioned_levels = false;
+    bool refused = false;
+    try {
+        db.openDB(db_name, options);
+    } catch (const invalid_argument&) {
+        refused = true;
+    }
+    assert(refused);
+}
+
+void test_tombstone_compaction(const string& db_name, const bool& ifBtree) {
+    const int64_t memtable_size = 1000;
+    const int64_t num_keys = 40 * memtable_size;
+    // Tombstones left in the SSTs of the database
+    auto count_tombstones = [](Database& db) {
+        size_t count = 0;
+        for (size_t i = 0; i < db.lsmtree->num_levels; ++i) {
+            for (const fs::path& file_name : db.lsmtree->levels[i].sorted_dir) {
+                count += db.lsmtree->num_tombstones(file_name);
+            }
+        }
+        return count;
+    };
+
+    for (const bool& partitioned : {false, true}) {
+        cout << "--- test case " << (partitioned ? 2 : 1) << ": Test SSTs full of tombstones are compacted down to the last level"
+             << (partitioned ? " (partitioned levels)" : "") << " ---" << endl;
+        Database db(memtable_size);
+        Options options;
+        options.partitioned_levels = partitioned;
+        options.sst_partition_size = 4 * constants::PAGE_SIZE;
+        db.openDB(db_name, options);
+        for (int64_t key = 0; key < num_keys; ++key) {
+            db.put(key, -key);
+        }
+        db.closeDB();
+        db.openDB(db_name, options);
+        for (int64_t key = 0; key < memtable_size; ++key) {
+            db.del(key);
+        }
+        // A single memtable of deletes would stay on level 0 until enough others come
+        db.closeDB();
+        db.openDB(db_name, options);
+        assert(count_tombstones(db) == 0);
+        for (int64_t key = 0; key < num_keys; key += 7) {
+            const int64_t* value = db.get(key, ifBtree);
+            assert(key < memtable_size ? value == nullptr : value != nullptr && *value == -key);
+            delete value;
+        }
+        db.closeDB();
+        deleteSSTs(constants::DATA_FOLDER + db_name);
+    }
+
+    cout << "--- test case 3: Test tombstones of keys the levels below do not hold are dropped by compactions ---" << endl;
+    Database db(memtable_size);
+    Options options;
+    options.tombstone_compaction_ratio = 1;
+    db.openDB(db_name, options);
+    for (int64_t key = 0; key < num_keys; ++key) {
+        db.put(2 * key, -key);
+    }
+    db.closeDB();
+    db.openDB(db_name, options);
+    const int64_t num_deletes = 4 * memtable_size;
+    for (int64_t key = 0; key < num_deletes; ++key) {
+        db.del(2 * key + 1);
+    }
+    db.closeDB();
+    db.openDB(db_name, options);
+    // Every delete went through a merge above the last level, only false positives of the Bloom Filters keep theirs
+    assert(count_tombstones(db) < num_deletes / 4);
+    const vector<pair<int64_t, int64_t>>* values = db.scan(0, 2 * num_deletes - 1, ifBtree);
+    assert((int64_t)values->size() == num_deletes);
+    for (int64_t key = 0; key < num_deletes; ++key) {
+        assert(values->at(key) == make_pair(2 * key, -key));
+    }
+    delete values;
+    db.closeDB();
+}
+
+void test_range_delete(const string& db_name, const bool& ifBtree) {
+    const int64_t memtable_size = 1000;
+    const int64_t num_keys = 40 * memtable_size;
+    // Whether the database holds exactly the keys of [0, end) that present() tells, with value -key
+    auto check = [&](Database& db, const int64_t& end, const function<bool(const int64_t&)>& present) {
+        for (int64_t key = 0; key < end; key += 7) {
+            const int64_t* value = db.get(key, ifBtree);
+            assert(present(key) ? value != nullptr && *value == -key : value == nullptr);
+            delete value;
+        }
+        const vector<pair<int64_t, int64_t>>* values = db.scan(0, end - 1, ifBtree);
+        size_t i = 0;
+        for (int64_t key = 0; key < end; ++key) {
+            if (present(key)) assert(i < values->size() && values->at(i++) == make_pair(key, -key));
+        }
+        assert(i == values->size());
+        delete values;
+    };
+
+    cout << "--- test case 1: Test delete_range() in the memtable ---" << endl;
+    {
+        Database db(memtable_size);
+        db.openDB(db_name);
+        for (int64_t key = 0; key < memtable_size / 2; ++key) {
+            db.put(key, -key);
+        }
+        db.delete_range(100, 199);
+        db.put(150, -150);
+        db.delete_range(450, num_keys);
+        check(db, memtable_size / 2, [](const int64_t& key) { return (key < 100 || key > 199 || key == 150) && key < 450; });
+        db.closeDB();
+        deleteSSTs(constants::DATA_FOLDER + db_name);
+    }
+
+    for (const bool& partitioned : {false, true}) {
+        cout << "--- test case " << (partitioned ? 3 : 2) << ": Test delete_range() over SSTs, through flushes and compactions"
+             << (partitioned ? " (partitioned levels)" : "") << " ---" << endl;
+        Database db(memtable_size);
+        Options options;
+        options.partitioned_levels = partitioned;
+        options.sst_partition_size = 4 * constants::PAGE_SIZE;
+        db.openDB(db_name, options);
+        for (int64_t key = 0; key < num_keys; ++key) {
+            db.put(key, -key);
+        }
+        db.closeDB();
+        db.openDB(db_name, options);
+        db.delete_range(1000, 9999);
+        db.put(5000, -5000);
+        db.delete_range(20000, 20999);
+        auto present = [](const int64_t& key) { return (key < 1000 || key > 9999 || key == 5000) && (key < 20000 || key > 20999); };
+        check(db, num_keys, present);
+        // The ranges go down with their SST
+        db.closeDB();
+        db.openDB(db_name, options);
+        check(db, num_keys, present);
+        for (int64_t key = num_keys; key < 3 * num_keys; ++key) {
+            db.put(key, -key);
+        }
+        db.closeDB();
+        db.openDB(db_name, options);
+        check(db, 3 * num_keys, present);
+        db.closeDB();
+        deleteSSTs(constants::DATA_FOLDER + db_name);
+    }
+
+    cout << "--- test case 4: Test delete_range() survives a crash ---" << endl;
+    Options options;
+    options.wal_sync_interval_ms = 1;
+    crash_after(db_name, options, [&](Database& db) {
+        for (int64_t key = 0; key < 2500; ++key) {
+            db.put(key, -key);
+        }
+        db.delete_range(100, 1999);
+        this_thread::sleep_for(chrono::milliseconds(100));
+    });
+    Database db(1000);
+    db.openDB(db_name);
+    check(db, 2500, [](const int64_t& key) { return key < 100 || key > 1999; });
+    db.closeDB();
+}
+
+void test_large_SST(const string& db_name, const bool& ifBtree) {
+    cout << "--- test case 1: Test get() and scan() through a B-Tree whose offsets go past 4GB (sparse SST) ---" << endl;
+    {
+        // 6GB of leaves, key 2 * i and value i for the i-th pair. Only the pages that are read are written
+        const int64_t num_pairs = (int64_t)3 << 27;
+        const int64_t num_pages = num_pairs / constants::KEYS_PER_NODE;
+        const vector<int64_t> pages = {0, 1, num_pages / 2, num_pages - 2, num_pages - 1};
+        Database db(1000);
+        db.openDB(db_name);
+        fs::path temp_path = SSTBuilder::new_temp_path(db.lsmtree->sst_path);
+        int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0777);
+        assert(fd != -1);
+        BloomFilter bloom_filter(pages.size() * constants::KEYS_PER_NODE, 10);
+        BTreeLeafNode leaf;
+        for (const int64_t& page : pages) {
+            for (int64_t i = 0; i < constants::KEYS_PER_NODE; ++i) {
+                int64_t pair_index = page * constants::KEYS_PER_NODE + i;
+                leaf.data[i] = make_pair(2 * pair_index, pair_index);
+                bloom_filter.set(2 * pair_index);
+            }
+            ssize_t nbytes = pwrite(fd, (char*)&leaf, constants::PAGE_SIZE, page * constants::PAGE_SIZE);
+            assert(nbytes == (ssize_t)constants::PAGE_SIZE);
+        }
+        vector<int64_t> non_leaf_keys;
+        for (int64_t page = 0; page < num_pages; ++page) {
+            non_leaf_keys.emplace_back(2 * (page * constants::KEYS_PER_NODE + constants::KEYS_PER_NODE - 1));
+        }
+        BTree btree;
+        btree.convertToBtree(non_leaf_keys, num_pairs);
+        int64_t leaf_end = num_pairs * constants::PAIR_SIZE;
+        int64_t offset = leaf_end;
+        btree.write_non_leaf_nodes_to_storage(fd, offset);
+        SSTFooter footer;
+        footer.num_entries = num_pairs;
+        footer.min_key = 0;
+        footer.max_key = 2 * (num_pairs - 1);
+        footer.leaf_end = leaf_end;
+        footer.index_end = offset;
+        footer.filter_num_cache_lines = bloom_filter.total_num_cache_lines;
+        footer.filter_num_of_hashes = bloom_filter.num_of_hashes;
+        BTree::write_footer(fd, footer);
+        close(fd);
+        string file_name = db.lsmtree->new_SST_name();
+        fs::rename(temp_path, db.lsmtree->sst_path / file_name);
+        bloom_filter.writeToStorage(db.lsmtree->filter_path / file_name);
+        db.lsmtree->add_SST(file_name);
+
+        for (const int64_t& page : pages) {
+            for (int64_t i = 0; i < constants::KEYS_PER_NODE; i += 51) {
+                int64_t pair_index = page * constants::KEYS_PER_NODE + i;
+                const int64_t* value = db.get(2 * pair_index, true);
+                assert(value != nullptr && *value == pair_index);
+                delete value;
+            }
+        }
+        int64_t first = (num_pages - 2) * constants::KEYS_PER_NODE;
+        const vector<pair<int64_t, int64_t>>* values = db.scan(2 * first + 1, 2 * (num_pairs - 1), true);
+        assert((int64_t)values->size() == num_pairs - first - 1);
+        for (size_t i = 0; i < values->size(); ++i) {
+            assert(values->at(i) == make_pair(2 * (first + 1 + (int64_t)i), first + 1 + (int64_t)i));
+        }
+        delete values;
+        db.closeDB();
+        deleteSSTs(constants::DATA_FOLDER + db_name);
+    }
+
+    // Writes a real run of more than 4GB, so it only runs when asked to
+    if (getenv("KV_LARGE_TESTS") == nullptr) return;
+    cout << "--- test case 2: Test a run of more than 4GB (KV_LARGE_TESTS) ---" << endl;
+    const int64_t num_pairs = ((int64_t)9 << 30) / 2 / constants::PAIR_SIZE;
+    Database db(constants::MEMTABLE_SIZE);
+    db.openDB(db_name);
+    int64_t next_key = 0;
+    db.ingest_sorted([&](pair<int64_t, int64_t>& KV) {
+        if (next_key == num_pairs) return false;
+        KV = make_pair(next_key, -next_key);
+        ++next_key;
+        return true;
+    }, num_pairs);
+    db.closeDB();
+    db.openDB(db_name);
+    for (int64_t key = 0; key < num_pairs; key += num_pairs / 1000) {
+        const int64_t* value = db.get(key, ifBtree);
+        assert(value != nullptr && *value == -key);
+        delete value;
+    }
+    const vector<pair<int64_t, int64_t>>* values = db.scan(num_pairs - 10000, num_pairs + 10000, ifBtree);
+    assert(values->size() == 10000 && values->back() == make_pair(num_pairs - 1, 1 - num_pairs));
+    delete values;
+    db.closeDB();
+}
+
+void test_fence_pointers(const string& db_name, const bool& ifBtree) {
+    // SSTs of several hundred leaf pages, whose B-Trees have more than one level of non-leaf nodes
+    const int64_t num_keys = 300000;
+    Database db(100000);
+    db.openDB(db_name);
+    for (int64_t key = 0; key < num_keys; ++key) {
+        db.put(3 * key, -key);
+    }
+    db.closeDB();
+
+    cout << "--- test case 1: Test the fence pointers of an SST are the last keys of its leaf pages ---" << endl;
+    db.openDB(db_name);
+    size_t num_SSTs = 0;
+    size_t fence_bytes = 0;
+    for (size_t i = 0; i < db.lsmtree->num_levels; ++i) {
+        for (const fs::path& file_name : db.lsmtree->levels[i].sorted_dir) {
+            SSTMeta meta = db.lsmtree->SST_meta(file_name);
+            assert(meta.fences.size() == meta.leaf_end / constants::PAGE_SIZE - 1);
+            int fd = open((db.lsmtree->sst_path / file_name).c_str(), O_RDONLY);
+            assert(fd != -1);
+            BTreeLeafNode leaf;
+            for (size_t page = 0; page < meta.fences.size(); ++page) {
+                assert(pread(fd, (char*)&leaf, constants::PAGE_SIZE, page * constants::PAGE_SIZE) == constants::PAGE_SIZE);
+                assert(meta.fences[page] == leaf.data[constants::KEYS_PER_NODE - 1].first);
+            }
+            close(fd);
+            ++num_SSTs;
+            fence_bytes += meta.fences.size() * sizeof(int64_t);
+        }
+    }
+    assert(num_SSTs > 0 && db.lsmtree->fence_pointer_bytes() >= fence_bytes);
+
+    cout << "--- test case 2: Test get() and scan() only read leaf pages of the SSTs ---" << endl;
+    for (int64_t key = 0; key < num_keys; key += 11) {
+        const int64_t* value = db.get(3 * key, ifBtree);
+        assert(value != nullptr && *value == -key);
+        delete value;
+        // Between two keys, and past the last one
+        assert(db.get(3 * key + 1, ifBtree) == nullptr);
+    }
+    assert(db.get(3 * num_keys, ifBtree) == nullptr);
+    for (int64_t key = 0; key < num_keys; key += 9973) {
+        const vector<pair<int64_t, int64_t>>* values = db.scan(3 * key - 1, 3 * key + 3000, ifBtree);
+        assert(values->size() == (size_t)min((int64_t)1001, num_keys - key));
+        assert(values->front() == make_pair(3 * key, -key));
+        delete values;
+    }
+    for (const list<Frame>& bucket : db.lsmtree->buffer->hash_directory) {
+        for (const Frame& frame : bucket) {
+            // Pages of the filters are not leaves, "r/<name>_<offset>"
+            assert(frame.leaf_page || frame.p_id[0] == 'r');
+        }
+    }
+    db.closeDB();
+}
+
+void test_learned_index(const string& db_name) {
+    cout << "--- test case 1: Test the model predicts the page of every fence within the error ---" << endl;
+    default_random_engine generator(443);
+    uniform_int_distribution<int64_t> gap(1, 1000);
+    vector<vector<int64_t>> all_fences(3);
+    for (int64_t page = 0; page < 10000; ++page) {
+        // Evenly spread keys, random gaps, and keys that get sparser and sparser
+        all_fences[0].push_back(3 * page);
+        all_fences[1].push_back((all_fences[1].empty() ? 0 : all_fences[1].back()) + gap(generator));
+        all_fences[2].push_back(page * page * page);
+    }
+    for (const vector<int64_t>& fences : all_fences) {
+        LearnedIndex learned_index;
+        learned_index.build(fences);
+        for (size_t page = 0; page < fences.size(); ++page) {
+            assert(abs(learned_index.predict(fences[page]) - (int64_t)page) <= (int64_t)constants::LEARNED_INDEX_ERROR + 1);
+            // Keys between two fences, before the first one and after the last one
+            assert(abs(learned_index.predict(fences[page] - 1) - (int64_t)page) <= (int64_t)constants::LEARNED_INDEX_ERROR + 1);
+            assert(abs(learned_index.predict(fences[page] + 1) - (int64_t)page - 1) <= (int64_t)constants::LEARNED_INDEX_ERROR + 1);
+        }
+        assert(learned_index.predict(numeric_limits<int64_t>::min()) == 0);
+        assert(learned_index.predict(numeric_limits<int64_t>::max()) == (int64_t)fences.size());
+    }
+    LearnedIndex linear;
+    linear.build(all_fences[0]);
+    assert(linear.segments.size() == 1);
+
+    cout << "--- test case 2: Test get() and scan() with the learned index ---" << endl;
+    const int64_t num_keys = 300000;
+    uniform_int_distribution<int64_t> distrib(0, 1000 * num_keys);
+    map<int64_t, int64_t> expected;
+    Database db(100000);
+    Options options;
+    options.sst_index = search_learned;
+    db.openDB(db_name, options);
+    while ((int64_t)expected.size() < num_keys) {
+        int64_t key = distrib(generator);
+        expected[key] = -key;
+        db.put(key, -key);
+    }
+    db.closeDB();
+    db.openDB(db_name, options);
+    for (const pair<const int64_t, int64_t>& KV : expected) {
+        const int64_t* value = db.get(KV.first, search_learned);
+        assert(value != nullptr && *value == KV.second);
+        delete value;
+        if (expected.count(KV.first + 1) == 0) assert(db.get(KV.first + 1, search_learned) == nullptr);
+    }
+    assert(db.get(-1, search_learned) == nullptr && db.get(1001 * num_keys, search_learned) == nullptr);
+    for (int64_t key1 = -1000; key1 < 1001 * num_keys; key1 += 999983) {
+        const vector<pair<int64_t, int64_t>>* values = db.scan(key1, key1 + 50000, search_learned);
+        const vector<pair<int64_t, int64_t>>* binary_values = db.scan(key1, key1 + 50000, search_binary);
+        assert(*values == *binary_values);
+        delete values;
+        delete binary_values;
+    }
+    // Uniform keys: a segment stands for many pages. The fences the model was fitted on are not kept
+    size_t fence_bytes = 0;
+    for (size_t i = 0; i < db.lsmtree->num_levels; ++i) {
+        for (const fs::path& file_name : db.lsmtree->levels[i].sorted_dir) {
+            SSTMeta meta = db.lsmtree->SST_meta(file_name);
+            assert(meta.fences.empty());
+            fence_bytes += (meta.leaf_end / constants::PAGE_SIZE - 1) * sizeof(int64_t);
+        }
+    }
+    assert(db.lsmtree->fence_pointer_bytes() == 0);
+    assert(db.lsmtree->learned_index_bytes() > 0 && db.lsmtree->learned_index_bytes() < fence_bytes / 10);
+    db.closeDB();
+}
+
+void test_page_search() {
+    default_random_engine generator(443);
+    vector<SearchKernel> kernels;
+    for (SearchKernel kernel : {scalar_kernel, avx2_kernel, avx512_kernel}) {
+        if (PageSearch::supported(kernel)) kernels.push_back(kernel);
+    }
+    cout << "Kernels supported: " << kernels.size() << ", picked: " << PageSearch::kernel << endl;
+    assert(PageSearch::supported(PageSearch::kernel));
+
+    cout << "--- test case 1: Test every kernel finds the lower bound of a key in a leaf ---" << endl;
+    for (int round = 0; round < 200; ++round) {
+        // Sparse or dense keys, and the last page of an SST, padded with its last pair
+        uniform_int_distribution<int64_t> gap(1, round % 2 == 0 ? 3 : 1000000);
+        BTreeLeafNode leaf;
+        int64_t key = (round % 3 == 0) ? numeric_limits<int64_t>::min() + 1 : -500000;
+        size_t num_pairs = (round % 5 == 0) ? 1 + round % constants::KEYS_PER_NODE : constants::KEYS_PER_NODE;
+        for (size_t i = 0; i < (size_t)constants::KEYS_PER_NODE; ++i) {
+            if (i < num_pairs) key += gap(generator);
+            leaf.data[i] = make_pair(key, -key);
+        }
+        auto compare = [](const pair<int64_t, int64_t>& KV, const int64_t& key) { return KV.first < key; };
+        for (size_t i = 0; i < (size_t)constants::KEYS_PER_NODE; ++i) {
+            for (int64_t delta = -1; delta <= 1; ++delta) {
+                int64_t probe = leaf.data[i].first + delta;
+                size_t expected = lower_bound(leaf.data, leaf.data + constants::KEYS_PER_NODE, probe, compare) - leaf.data;
+                for (SearchKernel kernel : kernels) {
+                    assert(PageSearch::leaf_lower_bound(leaf, probe, kernel) == expected);
+                }
+            }
+        }
+        for (SearchKernel kernel : kernels) {
+            assert(PageSearch::leaf_lower_bound(leaf, numeric_limits<int64_t>::min(), kernel) == 0);
+            assert(PageSearch::leaf_lower_bound(leaf, numeric_limits<int64_t>::max(), kernel) == (size_t)constants::KEYS_PER_NODE);
+        }
+    }
+
+    cout << "--- test case 2: Test every kernel finds the lower bound of a key in non-leaf nodes of every size ---" << endl;
+    uniform_int_distribution<int64_t> gap(1, 1000);
+    for (int32_t size = 1; size <= constants::NON_LEAF_KEYS; ++size) {
+        BTreeNonLeafNode node;
+        int64_t key = -1000 * size;
+        for (int32_t i = 0; i < size; ++i) {
+            key += gap(generator);
+            node.keys[i] = key;
+        }
+        node.size = size;
+        for (int32_t i = 0; i < size; ++i) {
+            for (int64_t delta = -1; delta <= 1; ++delta) {
+                int64_t probe = node.keys[i] + delta;
+                size_t expected = lower_bound(node.keys, node.keys + size, probe) - node.keys;
+                for (SearchKernel kernel : kernels) {
+                    assert(PageSearch::non_leaf_lower_bound(node, probe, kernel) == expected);
+                }
+            }
+        }
+        for (SearchKernel kernel : kernels) {
+            // The keys past the size of the node are not looked at
+            assert(PageSearch::non_leaf_lower_bound(node, numeric_limits<int64_t>::max(), kernel) == (size_t)size);
+        }
+    }
+}
+
+void test_manifest(const string& db_name, const bool& ifBtree) {
+    const int64_t num_keys = 20000;
+    auto check = [&](Database& db) {
+        for (int64_t key = 0; key < num_keys; key += 7) {
+            const int64_t* value = db.get(key, ifBtree);
+            assert(value != nullptr && *value == -key);
+            delete value;
+        }
+        const vector<pair<int64_t, int64_t>>* values = db.scan(100, 5099, ifBtree);
+        assert(values->size() == 5000 && values->front() == make_pair((int64_t)100, (int64_t)-100));
+        delete values;
+    };
+
+    cout << "--- test case 1: Test the footers of the SSTs hold their metadata ---" << endl;
+    Database db(1000);
+    db.openDB(db_name);
+    for (int64_t key = 0; key < num_keys; ++key) {
+        db.put(key, -key);
+    }
+    db.closeDB();
+    db.openDB(db_name);
+    size_t num_entries = 0;
+    vector<vector<fs::path>> sorted_dirs;
+    vector<vector<size_t>> run_units;
+    for (size_t i = 0; i < db.lsmtree->num_levels; ++i) {
+        for (const fs::path& file_name : db.lsmtree->levels[i].sorted_dir) {
+            SSTMeta meta = db.lsmtree->SST_meta(file_name);
+            assert(meta.min_key < meta.max_key);
+            const vector<pair<int64_t, int64_t>>* values = db.scan(meta.min_key, meta.max_key, ifBtree);
+            assert(values->front().first == meta.min_key && values->back().first == meta.max_key);
+            delete values;
+            assert(meta.leaf_end == (meta.num_entries + constants::KEYS_PER_NODE - 1) / constants::KEYS_PER_NODE * constants::PAGE_SIZE);
+            assert(fs::file_size(db.lsmtree->sst_path / file_name) == meta.index_end + constants::PAGE_SIZE);
+            num_entries += meta.num_entries;
+        }
+        sorted_dirs.push_back(db.lsmtree->levels[i].sorted_dir);
+        run_units.push_back(db.lsmtree->levels[i].run_units);
+    }
+    assert(num_entries == num_keys);
+    check(db);
+    db.closeDB();
+
+    cout << "--- test case 2: Test reopening the DB restores the levels from the MANIFEST, not from the SST directory ---" << endl;
+    // A stray file in the SST directory is not an SST of the DB
+    ofstream((constants::DATA_FOLDER + db_name + "/sst/999999.bytes").c_str()) << "stray";
+    db.openDB(db_name);
+    assert(db.lsmtree->num_levels == sorted_dirs.size());
+    for (size_t i = 0; i < db.lsmtree->num_levels; ++i) {
+        assert(db.lsmtree->levels[i].sorted_dir == sorted_dirs[i] && db.lsmtree->levels[i].run_units == run_units[i]);
+    }
+    check(db);
+    db.closeDB();
+    fs::remove(constants::DATA_FOLDER + db_name + "/sst/999999.bytes");
+
+    cout << "--- test case 3: Test a crash leaves nothing that the MANIFEST does not list ---" << endl;
+    // The writes stay in the memtable and the WAL: a compaction in a forked child would wait forever on its reads ahead
+    Options options;
+    options.wal_sync_policy = sync_always;
+    crash_after(db_name, options, [&](Database& db) {
+        for (int64_t key = num_keys; key < num_keys + 500; ++key) {
+            db.put(key, -key);
+        }
+        // Left behind by an SST that was being written, and by one that was compacted away before the crash
+        ofstream(SSTBuilder::new_temp_path(db.lsmtree->sst_path).c_str()) << "torn";
+        ofstream((db.lsmtree->sst_path / db.lsmtree->new_SST_name()).c_str()) << "compacted";
+    });
+    db.openDB(db_name);
+    check(db);
+    for (int64_t key = num_keys; key < num_keys + 500; ++key) {
+        const int64_t* value = db.get(key, ifBtree);
+        assert(value != nullptr && *value == -key);
+        delete value;
+    }
+    db.closeDB();
+    db.openDB(db_name);
+    size_t num_SSTs = 0;
+    for (size_t i = 0; i < db.lsmtree->num_levels; ++i) {
+        num_SSTs += db.lsmtree->levels[i].sorted_dir.size();
+    }
+    size_t num_files = distance(fs::directory_iterator(constants::DATA_FOLDER + db_name + "/sst"), fs::directory_iterator());
+    assert(num_files == num_SSTs);
+    db.closeDB();
+    deleteSSTs(constants::DATA_FOLDER + db_name);
+
+    cout << "--- test case 4: Test the MANIFEST keeps the last complete version and stays small ---" << endl;
+    fs::path manifest_path = constants::DATA_FOLDER + db_name + "/MANIFEST";
+    vector<ManifestFile> files(1000);
+    {
+        Manifest manifest(manifest_path);
+        for (uint64_t version = 1; version <= 200; ++version) {
+            for (uint64_t i = 0; i < files.size(); ++i) {
+                files[i] = {i % 3, 1, version * files.size() + i};
+            }
+            manifest.append(version * files.size() + files.size(), 3, files);
+        }
+    }
+    assert(fs::file_size(manifest_path) <= constants::MANIFEST_MAX_SIZE);
+    ManifestRecordHeader header;
+    vector<ManifestFile> loaded;
+    {
+        Manifest manifest(manifest_path);
+        assert(manifest.load(header, loaded));
+        assert(header.version == 200 && header.num_levels == 3 && loaded.size() == files.size());
+        assert(loaded.back().file_number == files.back().file_number);
+        // A new version torn by a crash is ignored
+        manifest.append(0, 3, files);
+        manifest.append(0, 3, files);
+    }
+    fs::resize_file(manifest_path, fs::file_size(manifest_path) - 1);
+    {
+        Manifest manifest(manifest_path);
+        assert(manifest.load(header, loaded) && header.version == 201);
+        // Records synced out of the order they were built in: the older one is skipped
+        vector<char> older = manifest.record(1, 3, files);
+        vector<char> newer = manifest.record(2, 3, files);
+        manifest.write(newer);
+        manifest.write(older);
+    }
+    {
+        Manifest manifest(manifest_path);
+        assert(manifest.load(header, loaded) && header.version == 203 && header.next_file_number == 2);
+    }
+    deleteSSTs(constants::DATA_FOLDER + db_name);
+
+    cout << "--- test case 5: Test a DB of the older format (SSTs named after their level and keys, no MANIFEST) is not opened, nor wiped ---" << endl;
+    fs::create_directories(constants::DATA_FOLDER + db_name + "/sst");
+    fs::create_directories(constants::DATA_FOLDER + db_name + "/filter");
+    fs::path legacy_SST = constants::DATA_FOLDER + db_name + "/sst/1_1700000000_0_1023_16384.bytes";
+    fs::path legacy_filter = constants::DATA_FOLDER + db_name + "/filter/1_1700000000_0_1023_16384.bytes";
+    ofstream(legacy_SST.c_str()) << "legacy";
+    ofstream(legacy_filter.c_str()) << "legacy";
+    bool refused = false;
+    try {
+        db.openDB(db_name);
+    } catch (const runtime_error&) {
+        refused = true;
+    }
+    assert(refused && fs::exists(legacy_SST) && fs::exists(legacy_filter));
+}
+
 int main(int argc, char **argv) {
     // Testing DB with small memtable capacities
     string db_name = "smallDB";
@@ -463,6 +1889,90 @@ int main(int argc, char **argv) {
     test_scan_small(db_name, false);
     cout << "\nTest passed; Now deleting all SSTs & Bloom Filters...\n" << endl;
     deleteSSTs(constants::DATA_FOLDER + db_name);
+    cout << "\n===== Test Get(key) and Scan(Key1, Key2) during background flushes =====\n" << endl;
+    test_background_flush(db_name, true);
+    cout << "\nTest passed; Now deleting all SSTs & Bloom Filters...\n" << endl;
+    deleteSSTs(constants::DATA_FOLDER + db_name);
+    cout << "\n===== Test Put(key, value) and Get(key) with background compactions =====\n" << endl;
+    test_background_compaction(db_name, true);
+    cout << "\nTest passed; Now deleting all SSTs & Bloom Filters...\n" << endl;
+    deleteSSTs(constants::DATA_FOLDER + db_name);
+    cout << "\n===== Test recovery from the write-ahead log =====\n" << endl;
+    test_wal_recovery(db_name, true);
+    cout << "\nTest passed; Now deleting all SSTs & Bloom Filters...\n" << endl;
+    deleteSSTs(constants::DATA_FOLDER + db_name);
+    cout << "\n===== Test Write(batch) =====\n" << endl;
+    test_write_batch(db_name, true);
+    cout << "\nTest passed; Now deleting all SSTs & Bloom Filters...\n" << endl;
+    deleteSSTs(constants::DATA_FOLDER + db_name);
+    cout << "\n===== Test ingest_sorted() =====\n" << endl;
+    test_ingest_sorted(db_name, true);
+    cout << "\nTest passed; Now deleting all SSTs & Bloom Filters...\n" << endl;
+    deleteSSTs(constants::DATA_FOLDER + db_name);
+    cout << "\n===== Test memtable budget in bytes =====\n" << endl;
+    test_memtable_budget(db_name, true);
+    cout << "\nTest passed; Now deleting all SSTs & Bloom Filters...\n" << endl;
+    deleteSSTs(constants::DATA_FOLDER + db_name);
+    cout << "\n===== Test compactions split into parallel subcompactions =====\n" << endl;
+    test_subcompactions(db_name, true);
+    cout << "\nTest passed; Now deleting all SSTs & Bloom Filters...\n" << endl;
+    deleteSSTs(constants::DATA_FOLDER + db_name);
+    cout << "\n===== Test read-ahead of compaction inputs =====\n" << endl;
+    test_compaction_readahead(db_name, true);
+    cout << "\nTest passed; Now deleting all SSTs & Bloom Filters...\n" << endl;
+    deleteSSTs(constants::DATA_FOLDER + db_name);
+    cout << "\n===== Test k-way merge of scan results =====\n" << endl;
+    test_kway_merge(db_name, true);
+    cout << "\nTest passed; Now deleting all SSTs & Bloom Filters...\n" << endl;
+    deleteSSTs(constants::DATA_FOLDER + db_name);
+    cout << "\n===== Test partitioned levels =====\n" << endl;
+    test_partitioned_levels(db_name, true);
+    cout << "\nTest passed; Now deleting all SSTs & Bloom Filters...\n" << endl;
+    deleteSSTs(constants::DATA_FOLDER + db_name);
+    cout << "\n===== Test trivial moves on partitioned levels =====\n" << endl;
+    test_trivial_move(db_name, true);
+    cout << "\nTest passed; Now deleting all SSTs & Bloom Filters...\n" << endl;
+    deleteSSTs(constants::DATA_FOLDER + db_name);
+    cout << "\n===== Test size ratio, merge policy and Bloom Filter FPR options =====\n" << endl;
+    test_merge_policies(db_name, true);
+    cout << "\nTest passed; Now deleting all SSTs & Bloom Filters...\n" << endl;
+    deleteSSTs(constants::DATA_FOLDER + db_name);
+    cout << "\n===== Test append mode for increasing keys =====\n" << endl;
+    test_append_mode(db_name, true);
+    cout << "\nTest passed; Now deleting all SSTs & Bloom Filters...\n" << endl;
+    deleteSSTs(constants::DATA_FOLDER + db_name);
+    cout << "\n===== Test compactions of SSTs with many tombstones =====\n" << endl;
+    test_tombstone_compaction(db_name, true);
+    cout << "\nTest passed; Now deleting all SSTs & Bloom Filters...\n" << endl;
+    deleteSSTs(constants::DATA_FOLDER + db_name);
+    cout << "\n===== Test range deletes =====\n" << endl;
+    test_range_delete(db_name, true);
+    cout << "\nTest passed; Now deleting all SSTs & Bloom Filters...\n" << endl;
+    deleteSSTs(constants::DATA_FOLDER + db_name);
+    cout << "\n===== Test SSTs larger than 4GB =====\n" << endl;
+    test_large_SST(db_name, true);
+    cout << "\nTest passed; Now deleting all SSTs & Bloom Filters...\n" << endl;
+    deleteSSTs(constants::DATA_FOLDER + db_name);
+    cout << "\n===== Test SST footers and the MANIFEST =====\n" << endl;
+    test_manifest(db_name, true);
+    cout << "\nTest passed; Now deleting all SSTs & Bloom Filters...\n" << endl;
+    deleteSSTs(constants::DATA_FOLDER + db_name);
+    cout << "\n===== Test fence pointers =====\n" << endl;
+    test_fence_pointers(db_name, true);
+    cout << "\nTest passed; Now deleting all SSTs & Bloom Filters...\n" << endl;
+    deleteSSTs(constants::DATA_FOLDER + db_name);
+    cout << "\n===== Test learned index =====\n" << endl;
+    test_learned_index(db_name);
+    cout << "\nTest passed; Now deleting all SSTs & Bloom Filters...\n" << endl;
+    deleteSSTs(constants::DATA_FOLDER + db_name);
+    cout << "\n===== Test search kernels inside pages =====\n" << endl;
+    test_page_search();
+    cout << "\nTest passed; Now deleting all SSTs & Bloom Filters...\n" << endl;
+    deleteSSTs(constants::DATA_FOLDER + db_name);
+    cout << "\n===== Test concurrent Put(key, value) on skiplist memtable =====\n" << endl;
+    test_concurrent_skiplist(db_name, true);
+    cout << "\nTest passed; Now deleting all SSTs & Bloom Filters...\n" << endl;
+    deleteSSTs(constants::DATA_FOLDER + db_name);
 
     // Testing DB with big (~32MB) memtable capacities
     db_name = "bigDB";
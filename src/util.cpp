@@ -26,4 +26,12 @@ size_t murmur_hash(const int64_t& key, const uint32_t& seed) {
     // wolf:~$ uname -m => x86_64
     MurmurHash3_x86_32(&key, sizeof(int64_t), seed, &hash);
     return static_cast<size_t>(hash);
-}
\ No newline at end of file
+}
+void sync_directory(const fs::path& dir) {
+    int dir_fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    #ifdef ASSERT
+        assert(dir_fd != -1);
+    #endif
+    fsync(dir_fd);
+    close(dir_fd);
+}
@@ -0,0 +1,226 @@
+#include <iostream>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cassert>
+#include <chrono>
+#include <string>
+#include "wal.h"
+#include "MurmurHash3.h"
+using namespace std;
+
+WAL::WAL(const fs::path& wal_path, const SyncPolicy& sync_policy, const size_t& sync_interval_ms) :
+    wal_path(wal_path), sync_policy(sync_policy), sync_interval_ms(sync_interval_ms), num_syncs(0), fd(-1),
+    appended_seq(0), written_seq(0), writing(false), unsynced(false), stop_sync(false) {
+    // Keep numbering after the segments left by the previous run, they are replayed and deleted by openDB
+    uint64_t number = 0;
+    for (const fs::path& old_segment : find_segments(wal_path)) {
+        number = max(number, (uint64_t)stoull(old_segment.stem().string()));
+    }
+    open_segment(number + 1);
+    if (sync_policy == sync_interval) {
+        sync_thread = thread(&WAL::sync_worker, this);
+    }
+}
+
+WAL::~WAL() {
+    if (sync_thread.joinable()) {
+        {
+            unique_lock<mutex> lock(wal_mutex);
+            stop_sync = true;
+        }
+        sync_cv.notify_all();
+        sync_thread.join();
+    }
+    if (fd != -1) {
+        unique_lock<mutex> lock(wal_mutex);
+        write_pending(lock, sync_policy != sync_none);
+        close(fd);
+        fd = -1;
+    }
+}
+
+uint64_t WAL::checksum(const pair<int64_t, int64_t>* KVs, const size_t& count) {
+    uint64_t hash[2];
+    MurmurHash3_x64_128(KVs, count * constants::PAIR_SIZE, 443 + count, hash);
+    return hash[0];
+}
+
+fs::path WAL::segment_path(const uint64_t& number) {
+    return wal_path / (to_string(number) + ".log");
+}
+
+/* Create a new segment and make it the one being written */
+void WAL::open_segment(const uint64_t& number) {
+    fd = open(segment_path(number).c_str(), O_WRONLY | O_CREAT | O_APPEND, 0777);
+    #ifdef ASSERT
+        assert(fd != -1);
+    #endif
+    segments.push_back(number);
+    if (sync_policy != sync_none) {
+        // Make the new file itself durable, otherwise a crash could lose the whole segment
+        int dir_fd = open(wal_path.c_str(), O_RDONLY | O_DIRECTORY);
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+}
+
+uint64_t WAL::append(const int64_t& key, const int64_t& value) {
+    pair<int64_t, int64_t> KV(key, value);
+    return append(&KV, 1);
+}
+
+uint64_t WAL::append(const pair<int64_t, int64_t>* KVs, const size_t& count) {
+    return append({count, checksum(KVs, count)}, KVs, count);
+}
+
+uint64_t WAL::append_range_delete(const int64_t& key1, const int64_t& key2) {
+    pair<int64_t, int64_t> range(key1, key2);
+    return append({1 | constants::WAL_RANGE_DELETE, checksum(&range, 1)}, &range, 1);
+}
+
+uint64_t WAL::append(const WALRecordHeader& header, const pair<int64_t, int64_t>* KVs, const size_t& count) {
+    unique_lock<mutex> lock(wal_mutex);
+    pending.insert(pending.end(), (char*)&header, (char*)&header + sizeof(header));
+    pending.insert(pending.end(), (char*)KVs, (char*)(KVs + count));
+    return ++appended_seq;
+}
+
+void WAL::commit(const uint64_t& seq) {
+    unique_lock<mutex> lock(wal_mutex);
+    if (sync_policy == sync_always) {
+        // Group commit: whoever finds no leader writing becomes the leader for every record buffered so far
+        while (written_seq < seq) {
+            if (writing) {
+                written_cv.wait(lock);
+            } else {
+                write_pending(lock, true);
+            }
+        }
+    } else if (!writing && pending.size() >= constants::WAL_BUFFER_SIZE) {
+        // Without per-write syncs, the buffer only goes to the OS once it is large enough
+        write_pending(lock, false);
+    }
+}
+
+void WAL::sync() {
+    unique_lock<mutex> lock(wal_mutex);
+    written_cv.wait(lock, [this] { return !writing; });
+    write_pending(lock, true);
+}
+
+/* Write the buffered records to the current segment, and fdatasync it if asked to.
+   The file I/O is done with the lock released, so writers can keep appending (and form the next group) */
+void WAL::write_pending(unique_lock<mutex>& lock, const bool& sync) {
+    #ifdef ASSERT
+        assert(!writing);
+    #endif
+    if (pending.empty() && !(sync && unsynced)) return;
+    writing = true;
+    vector<char> batch;
+    batch.swap(pending);
+    uint64_t batch_seq = appended_seq;
+    lock.unlock();
+
+    if (!batch.empty()) {
+        ssize_t nbytes = write(fd, batch.data(), batch.size());
+        #ifdef ASSERT
+            assert(nbytes == (ssize_t)batch.size());
+        #endif
+    }
+    if (sync) {
+        fdatasync(fd);
+    }
+
+    lock.lock();
+    if (sync) ++num_syncs;
+    unsynced = !sync;
+    written_seq = batch_seq;
+    writing = false;
+    written_cv.notify_all();
+}
+
+void WAL::roll() {
+    unique_lock<mutex> lock(wal_mutex);
+    written_cv.wait(lock, [this] { return !writing; });
+    // The records of the old segment may be the only copy of its memtable until it is flushed
+    write_pending(lock, sync_policy != sync_none);
+    close(fd);
+    open_segment(segments.back() + 1);
+}
+
+void WAL::release_oldest() {
+    unique_lock<mutex> lock(wal_mutex);
+    #ifdef ASSERT
+        assert(segments.size() > 1);
+    #endif
+    fs::remove(segment_path(segments.front()));
+    segments.pop_front();
+}
+
+void WAL::release_all() {
+    unique_lock<mutex> lock(wal_mutex);
+    written_cv.wait(lock, [this] { return !writing; });
+    pending.clear();
+    written_seq = appended_seq;
+    unsynced = false;
+    close(fd);
+    fd = -1;
+    for (const uint64_t& number : segments) {
+        fs::remove(segment_path(number));
+    }
+    segments.clear();
+}
+
+/* Background thread for sync_interval: every sync_interval_ms, write and fdatasync what has been appended */
+void WAL::sync_worker() {
+    unique_lock<mutex> lock(wal_mutex);
+    while (!stop_sync) {
+        sync_cv.wait_for(lock, chrono::milliseconds(sync_interval_ms));
+        if (writing) continue;
+        write_pending(lock, true);
+    }
+}
+
+vector<fs::path> WAL::find_segments(const fs::path& wal_path) {
+    vector<fs::path> segment_paths;
+    for (auto& file : fs::directory_iterator(wal_path)) {
+        if (file.path().extension() == ".log") {
+            segment_paths.push_back(file.path());
+        }
+    }
+    // Sort by segment number, the names are not padded
+    sort(segment_paths.begin(), segment_paths.end(), [](const fs::path& a, const fs::path& b) {
+        return stoull(a.stem().string()) < stoull(b.stem().string());
+    });
+    return segment_paths;
+}
+
+size_t WAL::replay(const fs::path& segment_path,
+                   const function<void(const pair<int64_t, int64_t>*, const size_t&, const bool&)>& apply) {
+    // A segment holds at most a few memtables worth of records, so it is read in one go
+    vector<char> buffer(fs::file_size(segment_path));
+    int fd = open(segment_path.c_str(), O_RDONLY);
+    #ifdef ASSERT
+        assert(fd != -1);
+    #endif
+    ssize_t nbytes = pread(fd, buffer.data(), buffer.size(), 0);
+    close(fd);
+    if (nbytes < 0) return 0;
+
+    size_t num_records = 0;
+    size_t offset = 0;
+    while (offset + sizeof(WALRecordHeader) <= (size_t)nbytes) {
+        WALRecordHeader* header = (WALRecordHeader*)(buffer.data() + offset);
+        offset += sizeof(WALRecordHeader);
+        bool range_delete = header->count & constants::WAL_RANGE_DELETE;
+        size_t count = header->count & ~constants::WAL_RANGE_DELETE;
+        // A partial or corrupted record was being written when the database crashed, nothing after it was acknowledged
+        if (count > (nbytes - offset) / constants::PAIR_SIZE) break;
+        pair<int64_t, int64_t>* KVs = (pair<int64_t, int64_t>*)(buffer.data() + offset);
+        if (header->checksum != checksum(KVs, count)) break;
+        apply(KVs, count, range_delete);
+        offset += count * constants::PAIR_SIZE;
+        ++num_records;
+    }
+    return num_records;
+}